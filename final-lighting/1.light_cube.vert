@@ -5,6 +5,9 @@ uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
 
+// the lamps are in the depth pre-pass too (3.3.depth.vert)
+invariant gl_Position;
+
 void main()
 {
     gl_Position = projection * view * model * vec4(aPos, 1.0);
@@ -0,0 +1,14 @@
+#version 330 core
+// depth pre-pass for 3.3.shader.vert: position only, linked without a fragment shader
+layout (location = 0) in vec3 aPos;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+invariant gl_Position;
+
+void main()
+{
+    gl_Position = projection * view * model * vec4(aPos, 1.0);
+}
@@ -11,6 +11,9 @@ uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
 
+// the depth pre-pass (3.3.depth.vert) must produce bit-identical depth for GL_EQUAL
+invariant gl_Position;
+
 void main()
 {
     FragPos = vec3(model * vec4(aPos, 1.0)); // we need in world space so we multiply by model matrix
@@ -0,0 +1,17 @@
+#version 430 core
+// depth pre-pass for 4.3.pull.vert: positions and model matrices only, linked without a fragment shader
+layout (std430, binding = 0) readonly buffer Positions { vec4 positions[]; };
+layout (std430, binding = 3) readonly buffer Instances { mat4 models[]; };
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform int instanceOffset;
+
+invariant gl_Position;
+
+void main()
+{
+    vec3 aPos = positions[gl_VertexID].xyz;
+    mat4 model = models[instanceOffset + gl_InstanceID];
+    gl_Position = projection * view * model * vec4(aPos, 1.0);
+}
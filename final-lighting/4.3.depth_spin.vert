@@ -0,0 +1,34 @@
+#version 430 core
+// depth pre-pass for 4.3.spin.vert, linked without a fragment shader
+layout (std430, binding = 0) readonly buffer Positions { vec4 positions[]; };
+struct SpinInstance
+{
+    vec4 positionScale;
+    vec4 axisSpeed;
+    float phase;
+};
+layout (std430, binding = 6) readonly buffer SpinInstances { SpinInstance spins[]; };
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform int instanceOffset;
+uniform float time;
+
+invariant gl_Position;
+
+mat3 axisAngle(vec3 axis, float angle)
+{
+    float c = cos(angle), s = sin(angle);
+    vec3 t = (1.0 - c) * axis;
+    return mat3(t.x * axis + vec3(c, s * axis.z, -s * axis.y),
+                t.y * axis + vec3(-s * axis.z, c, s * axis.x),
+                t.z * axis + vec3(s * axis.y, -s * axis.x, c));
+}
+
+void main()
+{
+    SpinInstance spin = spins[instanceOffset + gl_InstanceID];
+    mat3 rotation = axisAngle(spin.axisSpeed.xyz, time * spin.axisSpeed.w + spin.phase);
+    vec3 worldPos = rotation * (positions[gl_VertexID].xyz * spin.positionScale.w) + spin.positionScale.xyz;
+    gl_Position = projection * view * vec4(worldPos, 1.0);
+}
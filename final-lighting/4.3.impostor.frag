@@ -0,0 +1,54 @@
+#version 430 core
+// impostor version of 3.3.shader.frag: same lights (lighting.glsl), but albedo/normal/specular come from the atlas
+// and the fragment is pushed back to the baked surface depth
+out vec4 FragColor;
+
+struct Impostor {
+    sampler2D albedo;
+    sampler2D normal;
+    sampler2D depth;
+    int framesPerSide;
+    vec3 center;
+    float radius;
+};
+
+in vec3 FragPos;
+in vec2 AtlasCoords;
+flat in mat3 NormalMatrix;
+flat in vec3 DepthAxis;
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform Impostor impostor;
+
+// set by main() before any light is calculated
+vec3 Albedo = vec3(0.0);
+float SpecularMask = 0.0;
+#define SURFACE_ALBEDO Albedo
+#define SURFACE_SPECULAR SpecularMask
+#include "lighting.glsl"
+
+void main()
+{
+    vec4 albedo = texture(impostor.albedo, AtlasCoords);
+    if (albedo.a < 0.5)
+        discard;
+    vec4 packedNormal = texture(impostor.normal, AtlasCoords);
+    Albedo = albedo.rgb;
+    SpecularMask = packedNormal.a;
+
+    // move the fragment from the quad onto the baked surface so impostors intersect correctly
+    vec3 surfacePos = FragPos + DepthAxis * texture(impostor.depth, AtlasCoords).r;
+    vec4 clip = projection * view * vec4(surfacePos, 1.0);
+    gl_FragDepth = clip.z / clip.w * 0.5 + 0.5;
+
+    vec3 norm = normalize(NormalMatrix * (packedNormal.xyz * 2.0 - 1.0));
+    vec3 viewDir = normalize(viewPos - surfacePos);
+
+    vec3 result = CalcDirLight(dirLight, norm, viewDir);
+    for(int i = 0; i < NR_POINT_LIGHTS; i++)
+        result += CalcPointLight(pointLights[i], norm, surfacePos, viewDir);
+    result += CalcSpotLight(spotLight, norm, surfacePos, viewDir);
+
+    FragColor = vec4(result, 1.0);
+}
@@ -0,0 +1,75 @@
+#version 430 core
+// One camera facing quad per far instance (glDrawArraysInstanced, 4 vertex strip, no attributes).
+// The quad is the atlas frame whose direction is closest to the camera, oriented like the baker did.
+layout (std430, binding = 3) readonly buffer Instances { mat4 models[]; };
+
+struct Impostor {
+    sampler2D albedo;
+    sampler2D normal;
+    sampler2D depth;
+    int framesPerSide;
+    vec3 center;
+    float radius;
+};
+
+out vec3 FragPos;
+out vec2 AtlasCoords;
+flat out mat3 NormalMatrix;
+flat out vec3 DepthAxis; // world space offset for depth = 1
+
+// viewPos, a uniform or in the Lighting block
+#include "lights.glsl"
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform int instanceOffset;
+uniform Impostor impostor;
+
+vec2 signNotZero(vec2 v)
+{
+    return vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+vec2 octahedralEncode(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 p = n.xz;
+    if (n.y < 0.0)
+        p = (1.0 - abs(p.yx)) * signNotZero(p);
+    return p;
+}
+
+vec3 octahedralDecode(vec2 p)
+{
+    vec3 n = vec3(p.x, 1.0 - abs(p.x) - abs(p.y), p.y);
+    if (n.y < 0.0)
+        n.xz = (1.0 - abs(n.zx)) * signNotZero(n.xz);
+    return normalize(n);
+}
+
+void main()
+{
+    mat4 model = models[instanceOffset + gl_InstanceID];
+    mat3 linear = mat3(model);
+    vec3 centerWorld = vec3(model * vec4(impostor.center, 1.0));
+
+    // nearest frame for the object space direction towards the camera
+    vec3 toCamera = normalize(inverse(linear) * (viewPos - centerWorld));
+    int n = impostor.framesPerSide;
+    ivec2 frame = clamp(ivec2((octahedralEncode(toCamera) * 0.5 + 0.5) * float(n)), ivec2(0), ivec2(n - 1));
+    vec3 direction = octahedralDecode((vec2(frame) + 0.5) / float(n) * 2.0 - 1.0);
+
+    // same basis as glm::lookAt in ImpostorAtlas::bake
+    vec3 up = abs(direction.y) > 0.99 ? vec3(0.0, 0.0, 1.0) : vec3(0.0, 1.0, 0.0);
+    vec3 right = normalize(cross(up, direction));
+    up = cross(direction, right);
+
+    vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 2.0 - 1.0;
+    vec3 objectPos = impostor.center + (right * corner.x + up * corner.y) * impostor.radius;
+    FragPos = vec3(model * vec4(objectPos, 1.0));
+    AtlasCoords = (vec2(frame) + corner * 0.5 + 0.5) / float(n);
+    NormalMatrix = transpose(inverse(linear));
+    DepthAxis = linear * (direction * impostor.radius);
+
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
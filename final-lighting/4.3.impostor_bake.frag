@@ -0,0 +1,25 @@
+#version 430 core
+layout (location = 0) out vec4 Albedo;      // rgb = diffuse map, a = coverage
+layout (location = 1) out vec4 NormalOut;   // object space normal packed to [0,1], a = specular map
+layout (location = 2) out float DepthOut;   // offset towards the viewer, in units of the radius
+
+struct Material {
+    sampler2D diffuse;
+    sampler2D specular;
+};
+
+in vec3 ObjectPos;
+in vec3 Normal;
+in vec2 TexCoords;
+
+uniform Material material;
+uniform vec3 boundsCenter;
+uniform float boundsRadius;
+uniform vec3 viewDirection; // from the object towards the camera of this frame
+
+void main()
+{
+    Albedo = vec4(texture(material.diffuse, TexCoords).rgb, 1.0);
+    NormalOut = vec4(normalize(Normal) * 0.5 + 0.5, texture(material.specular, TexCoords).r);
+    DepthOut = dot(ObjectPos - boundsCenter, viewDirection) / boundsRadius;
+}
@@ -0,0 +1,20 @@
+#version 430 core
+// renders one atlas frame of a MeshPool mesh, same pulling layout as 4.3.pull.vert
+layout (std430, binding = 0) readonly buffer Positions { vec4 positions[]; };
+layout (std430, binding = 1) readonly buffer Normals { vec4 normals[]; };
+layout (std430, binding = 2) readonly buffer TexCoordsBuffer { vec2 texCoords[]; };
+
+out vec3 ObjectPos;
+out vec3 Normal;
+out vec2 TexCoords;
+
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+    ObjectPos = positions[gl_VertexID].xyz;
+    Normal = normals[gl_VertexID].xyz;
+    TexCoords = texCoords[gl_VertexID];
+    gl_Position = projection * view * vec4(ObjectPos, 1.0);
+}
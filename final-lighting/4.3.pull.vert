@@ -0,0 +1,33 @@
+#version 430 core
+// vertex pulling version of 3.3.shader.vert, no vertex attributes at all.
+// Attributes come from the MeshPool SSBOs, model matrices from the instance SSBO.
+layout (std430, binding = 0) readonly buffer Positions { vec4 positions[]; };
+layout (std430, binding = 1) readonly buffer Normals { vec4 normals[]; };
+layout (std430, binding = 2) readonly buffer TexCoordsBuffer { vec2 texCoords[]; };
+layout (std430, binding = 3) readonly buffer Instances { mat4 models[]; };
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec2 TexCoords;
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform int instanceOffset; // first model matrix of this draw
+
+// must match 4.3.depth_pull.vert for the GL_EQUAL pass after the depth pre-pass
+invariant gl_Position;
+
+void main()
+{
+    // glDrawElementsBaseVertex already added the mesh's base vertex to gl_VertexID
+    vec3 aPos = positions[gl_VertexID].xyz;
+    vec3 aNormal = normals[gl_VertexID].xyz;
+    mat4 model = models[instanceOffset + gl_InstanceID];
+
+    FragPos = vec3(model * vec4(aPos, 1.0));
+    Normal = mat3(transpose(inverse(model))) * aNormal;
+
+    gl_Position = projection * view * model * vec4(aPos, 1.0);
+
+    TexCoords = texCoords[gl_VertexID];
+}
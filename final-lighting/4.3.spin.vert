@@ -0,0 +1,51 @@
+#version 430 core
+// GPU animated version of 4.3.pull.vert: instead of a model matrix every instance has a position, a
+// scale and a spin (unit axis, radians per second, phase). The rotation is rebuilt from the time uniform,
+// so spinning objects cost no cpu work and no uploads per frame.
+layout (std430, binding = 0) readonly buffer Positions { vec4 positions[]; };
+layout (std430, binding = 1) readonly buffer Normals { vec4 normals[]; };
+layout (std430, binding = 2) readonly buffer TexCoordsBuffer { vec2 texCoords[]; };
+struct SpinInstance
+{
+    vec4 positionScale; // xyz position, w uniform scale
+    vec4 axisSpeed;     // xyz unit axis, w radians per second
+    float phase;        // radians at time 0
+};
+layout (std430, binding = 6) readonly buffer SpinInstances { SpinInstance spins[]; };
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec2 TexCoords;
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform int instanceOffset;
+uniform float time; // seconds
+
+// must match 4.3.depth_spin.vert for the GL_EQUAL pass after the depth pre-pass
+invariant gl_Position;
+
+// rotation of angle around the unit vector axis (Rodrigues)
+mat3 axisAngle(vec3 axis, float angle)
+{
+    float c = cos(angle), s = sin(angle);
+    vec3 t = (1.0 - c) * axis;
+    return mat3(t.x * axis + vec3(c, s * axis.z, -s * axis.y),
+                t.y * axis + vec3(-s * axis.z, c, s * axis.x),
+                t.z * axis + vec3(s * axis.y, -s * axis.x, c));
+}
+
+void main()
+{
+    SpinInstance spin = spins[instanceOffset + gl_InstanceID];
+    mat3 rotation = axisAngle(spin.axisSpeed.xyz, time * spin.axisSpeed.w + spin.phase);
+    vec3 aPos = positions[gl_VertexID].xyz;
+
+    // rotation and uniform scale only, the rotation is the normal matrix
+    FragPos = rotation * (aPos * spin.positionScale.w) + spin.positionScale.xyz;
+    Normal = rotation * normals[gl_VertexID].xyz;
+
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+
+    TexCoords = texCoords[gl_VertexID];
+}
@@ -0,0 +1,117 @@
+#ifndef ALLOCATION_COUNTER_H
+#define ALLOCATION_COUNTER_H
+
+#include <atomic>
+#include <cstddef>
+
+// Counts the heap allocations that go through operator new (std containers, std::string, new), in total and
+// per thread: take threadAllocations() before and after a stretch of code to see whether it allocated.
+// malloc from C code (the GL driver, GLFW, stb_image) is not seen. The replacement operators are compiled
+// into the one file that defines ALLOCATION_COUNTER_IMPLEMENTATION before including this header.
+inline std::atomic<unsigned long long> allocationCounterTotal{0};
+inline thread_local unsigned long long allocationCounterThread = 0;
+
+// allocations of the calling thread since it started
+// ------------------------------------------------------------------------
+inline unsigned long long threadAllocations()
+{
+    return allocationCounterThread;
+}
+// allocations of all threads since the program started
+// ------------------------------------------------------------------------
+inline unsigned long long totalAllocations()
+{
+    return allocationCounterTotal.load(std::memory_order_relaxed);
+}
+
+#ifdef ALLOCATION_COUNTER_IMPLEMENTATION
+#include <cstdlib>
+#include <new>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+// alignment 0: plain operator new; the align_val_t operators pass theirs and free with countedFree(, true)
+// ------------------------------------------------------------------------
+static void *countedAllocation(std::size_t size, std::size_t alignment)
+{
+    allocationCounterThread++;
+    allocationCounterTotal.fetch_add(1, std::memory_order_relaxed);
+    if (size == 0)
+        size = 1;
+#ifdef _WIN32
+    // the MSVC runtime has no aligned_alloc, _aligned_malloc memory has to go back through _aligned_free
+    void *memory = alignment ? _aligned_malloc(size, alignment) : std::malloc(size);
+#else
+    // aligned_alloc wants the size in multiples of the alignment
+    void *memory = alignment > alignof(std::max_align_t) ? std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment) : std::malloc(size);
+#endif
+    if (!memory)
+        throw std::bad_alloc();
+    return memory;
+}
+// ------------------------------------------------------------------------
+static void countedFree(void *memory, bool aligned)
+{
+#ifdef _WIN32
+    if (aligned)
+    {
+        _aligned_free(memory);
+        return;
+    }
+#else
+    (void)aligned; // aligned_alloc memory is released with free
+#endif
+    std::free(memory);
+}
+
+void *operator new(std::size_t size)
+{
+    return countedAllocation(size, 0);
+}
+void *operator new[](std::size_t size)
+{
+    return countedAllocation(size, 0);
+}
+void *operator new(std::size_t size, std::align_val_t alignment)
+{
+    return countedAllocation(size, (std::size_t)alignment);
+}
+void *operator new[](std::size_t size, std::align_val_t alignment)
+{
+    return countedAllocation(size, (std::size_t)alignment);
+}
+void operator delete(void *memory) noexcept
+{
+    countedFree(memory, false);
+}
+void operator delete[](void *memory) noexcept
+{
+    countedFree(memory, false);
+}
+void operator delete(void *memory, std::size_t) noexcept
+{
+    countedFree(memory, false);
+}
+void operator delete[](void *memory, std::size_t) noexcept
+{
+    countedFree(memory, false);
+}
+void operator delete(void *memory, std::align_val_t) noexcept
+{
+    countedFree(memory, true);
+}
+void operator delete[](void *memory, std::align_val_t) noexcept
+{
+    countedFree(memory, true);
+}
+void operator delete(void *memory, std::size_t, std::align_val_t) noexcept
+{
+    countedFree(memory, true);
+}
+void operator delete[](void *memory, std::size_t, std::align_val_t) noexcept
+{
+    countedFree(memory, true);
+}
+#endif
+#endif
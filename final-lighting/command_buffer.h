@@ -0,0 +1,146 @@
+#ifndef COMMAND_BUFFER_H
+#define COMMAND_BUFFER_H
+
+#include <glad/glad.h>
+#include <glm.hpp>
+
+#include <algorithm>
+#include <vector>
+
+#include "shader_s.h"
+#include "mesh_pool.h"
+#include "job_system.h"
+
+// passes in submission order, the pass is the top of the sort key
+enum RenderPass
+{
+    RENDER_PASS_DEPTH = 0,   // depth only (pre-pass / occluders), color writes off
+    RENDER_PASS_QUERY = 1,   // occlusion query proxies, color and depth writes off
+    RENDER_PASS_OPAQUE = 2,  // front to back, GL_EQUAL without depth writes when everything went through the depth pass
+    RENDER_PASS_CUTOUT = 3,  // opaque but writes its own depth (impostors), never in the depth pass
+    RENDER_PASS_BLENDED = 4  // back to front, blending on, depth writes off
+};
+
+const unsigned int RENDER_TEXTURE_UNITS = 5;
+
+// One draw with everything it binds. Zero means "don't care" for the VAO and the textures (GL_TEXTURE_2D
+// on unit = slot), negative means the uniform is not set.
+struct DrawPacket
+{
+    // what the packet is sorted by, set by CommandBuffer::add(), RenderQueue::sort() builds the key from it
+    unsigned int pass = RENDER_PASS_OPAQUE;
+    unsigned int material = 0; // texture name the packet is grouped by, 0 for none
+    unsigned int mesh = 0;     // tells draws from the same VAO apart (pool mesh id), 0 when the VAO holds one mesh
+    unsigned int depth = 0;    // view distance quantized to 24 bits over [0, maxDepth]
+    const Shader *shader = nullptr;
+    unsigned int VAO = 0;
+    unsigned int textures[RENDER_TEXTURE_UNITS] = {0, 0, 0, 0, 0};
+    GLenum mode = GL_TRIANGLES;
+    bool indexed = false;
+    unsigned int first = 0; // first vertex, or first index when indexed
+    unsigned int count = 0;
+    int baseVertex = 0;
+    unsigned int instanceCount = 1;
+    int instanceOffset = -1; // "instanceOffset" uniform (pulled instances)
+    int model = -1;          // index into CommandBuffer::models for the "model" uniform
+    unsigned int query = 0;     // wrapped in an ANY_SAMPLES_PASSED_CONSERVATIVE query (query pass)
+    unsigned int condition = 0; // drawn under glBeginConditionalRender on this query
+    int queryObject = -1;       // recorded without GL: the object whose query becomes condition at replay
+};
+
+// a mesh of the pool drawn with pulled attributes, instances start at instanceOffset in the instance SSBO
+// ------------------------------------------------------------------------
+inline DrawPacket poolPacket(const Shader &shader, const MeshPool &pool, unsigned int mesh, unsigned int instanceOffset, unsigned int instanceCount)
+{
+    const MeshRange &range = pool.meshes[mesh];
+    DrawPacket packet;
+    packet.shader = &shader;
+    packet.VAO = pool.VAO;
+    packet.indexed = true;
+    packet.first = range.firstIndex;
+    packet.count = range.indexCount;
+    packet.baseVertex = (int)range.baseVertex;
+    packet.instanceCount = instanceCount;
+    packet.instanceOffset = (int)instanceOffset;
+    return packet;
+}
+
+// Draw packets and their model matrices, recorded without touching GL: programs, VAOs and textures are
+// only handles here, so any thread can record a buffer and the render thread merges them into its
+// RenderQueue, which sorts and replays them. Buffers keep their capacity over clear().
+// add() only stores what the packet is sorted by (pass, material, mesh, quantized depth), the 64 bit key is
+// built by RenderQueue::sort() once the whole frame is known.
+class CommandBuffer
+{
+public:
+    std::vector<DrawPacket> packets;
+    std::vector<glm::mat4> models;
+    float maxDepth = 100.0f;
+
+    // material: texture name to group by (0 for none), mesh: pool mesh id or 0 when the packet's VAO holds one mesh
+    // ------------------------------------------------------------------------
+    void add(unsigned int pass, unsigned int material, unsigned int mesh, float depth, const DrawPacket &packet)
+    {
+        packets.push_back(packet);
+        DrawPacket &added = packets.back();
+        added.pass = pass;
+        added.material = material;
+        added.mesh = mesh;
+        added.depth = (unsigned int)(std::min(std::max(depth / maxDepth, 0.0f), 1.0f) * 16777215.0f);
+    }
+    // ------------------------------------------------------------------------
+    int addModel(const glm::mat4 &model)
+    {
+        models.push_back(model);
+        return (int)models.size() - 1;
+    }
+    // ------------------------------------------------------------------------
+    void clear()
+    {
+        packets.clear();
+        models.clear();
+    }
+    // room for the biggest frame up front, so no frame grows the buffer
+    // ------------------------------------------------------------------------
+    void reserve(size_t packetCount, size_t modelCount)
+    {
+        packets.reserve(packetCount);
+        models.reserve(modelCount);
+    }
+    // appends another buffer, its model indices are moved past ours
+    // ------------------------------------------------------------------------
+    void append(const CommandBuffer &buffer)
+    {
+        int modelBase = (int)models.size();
+        models.insert(models.end(), buffer.models.begin(), buffer.models.end());
+        size_t first = packets.size();
+        packets.insert(packets.end(), buffer.packets.begin(), buffer.packets.end());
+        for (size_t i = first; i < packets.size(); i++)
+        {
+            if (packets[i].model >= 0)
+                packets[i].model += modelBase;
+        }
+    }
+};
+
+// Records count items into buffers.size() buffers in parallel on the job system's workers: buffer i gets
+// the i-th contiguous chunk, filled with record(buffer, first, last) by whichever worker picks the chunk up
+// (the calling thread works along until all are done). Appending the buffers in order gives the same
+// packets as recording everything into one buffer.
+// ------------------------------------------------------------------------
+template <typename RecordFunction>
+void recordParallel(JobSystem &jobs, std::vector<CommandBuffer> &buffers, unsigned int count, const RecordFunction &record)
+{
+    unsigned int chunks = (unsigned int)buffers.size();
+    jobs.parallelFor(chunks, [&](unsigned int firstChunk, unsigned int lastChunk)
+                     {
+                         for (unsigned int chunk = firstChunk; chunk < lastChunk; chunk++)
+                         {
+                             buffers[chunk].clear();
+                             record(buffers[chunk], (unsigned int)((unsigned long long)count * chunk / chunks),
+                                    (unsigned int)((unsigned long long)count * (chunk + 1) / chunks));
+                         }
+                     },
+                     1);
+}
+#endif
@@ -0,0 +1,20 @@
+#ifndef COMPUTE_SHADER_H
+#define COMPUTE_SHADER_H
+
+#include <glad/glad.h>
+
+#include "shader_s.h"
+
+// Shader (shader_s.h) with a single compute stage, needs a 4.3 context: the same loader and preprocessor,
+// the same non-blocking build (ready()/wait()) and the hashed, shadowed uniform setters
+class ComputeShader : public Shader
+{
+public:
+    // constructor generates the shader on the fly
+    // ------------------------------------------------------------------------
+    explicit ComputeShader(const char* computePath, const ShaderDefines& defines = ShaderDefines(), bool compileNow = true)
+        : Shader(GL_COMPUTE_SHADER, "COMPUTE", computePath, defines, compileNow)
+    {
+    }
+};
+#endif
@@ -0,0 +1,366 @@
+#ifndef ECS_H
+#define ECS_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+// Archetype entity-component system. Every distinct set of component types is an archetype; its entities
+// live in fixed size chunks where each component type has its own 64 byte aligned array, so a query walks
+// contiguous arrays chunk by chunk instead of chasing pointers. Entities are dense inside an archetype
+// (every chunk full except the last), destroy() moves the last entity into the hole. Components must be
+// trivially copyable, they are moved between archetypes with memcpy.
+const unsigned int ECS_CHUNK_SIZE = 16384;
+const unsigned int ECS_MAX_COMPONENTS = 32; // bits of an archetype mask
+static_assert(ECS_MAX_COMPONENTS <= sizeof(unsigned int) * 8, "archetype masks are unsigned int");
+
+// index into the entity table plus the generation of that slot, so handles of destroyed entities go stale
+struct Entity
+{
+    unsigned int index = 0;
+    unsigned int generation = 0;
+};
+
+// Hands out ECS_CHUNK_SIZE blocks aligned to a cache line. Blocks are carved from slabs of SLAB_CHUNKS
+// and recycled through a free list, nothing goes back to the heap before the pool dies.
+class ChunkPool
+{
+public:
+    static const unsigned int SLAB_CHUNKS = 16;
+
+    ChunkPool() = default;
+    ChunkPool(const ChunkPool &) = delete;
+    ChunkPool &operator=(const ChunkPool &) = delete;
+    // ------------------------------------------------------------------------
+    ~ChunkPool()
+    {
+        for (unsigned char *slab : slabs)
+            ::operator delete(slab, std::align_val_t(64));
+    }
+    // ------------------------------------------------------------------------
+    unsigned char *allocate()
+    {
+        if (freeChunks.empty())
+        {
+            unsigned char *slab = (unsigned char *)::operator new((size_t)ECS_CHUNK_SIZE * SLAB_CHUNKS, std::align_val_t(64));
+            slabs.push_back(slab);
+            for (unsigned int i = SLAB_CHUNKS; i > 0; i--)
+                freeChunks.push_back(slab + (size_t)(i - 1) * ECS_CHUNK_SIZE);
+        }
+        unsigned char *chunk = freeChunks.back();
+        freeChunks.pop_back();
+        return chunk;
+    }
+    // ------------------------------------------------------------------------
+    void release(unsigned char *chunk)
+    {
+        freeChunks.push_back(chunk);
+    }
+    // ------------------------------------------------------------------------
+    unsigned int allocatedChunks() const
+    {
+        return (unsigned int)(slabs.size() * SLAB_CHUNKS - freeChunks.size());
+    }
+
+private:
+    std::vector<unsigned char *> slabs;
+    std::vector<unsigned char *> freeChunks;
+};
+
+// size of every component type, by the id componentType<T>() gave it
+// ------------------------------------------------------------------------
+inline unsigned int *componentSizes()
+{
+    static unsigned int sizes[ECS_MAX_COMPONENTS];
+    return sizes;
+}
+// ------------------------------------------------------------------------
+inline std::atomic<unsigned int> &componentTypeCount()
+{
+    static std::atomic<unsigned int> count{0};
+    return count;
+}
+
+// ------------------------------------------------------------------------
+template <typename T>
+unsigned int componentType()
+{
+    static_assert(std::is_trivially_copyable<T>::value, "components are moved with memcpy");
+    static_assert(alignof(T) <= 64, "component arrays are aligned to 64 bytes");
+    static const unsigned int id = []()
+    {
+        unsigned int type = componentTypeCount()++;
+        // masks are 32 bit and sizes[]/offsets[] have ECS_MAX_COMPONENTS entries, one more type would corrupt
+        // both; checked in release builds too
+        if (type >= ECS_MAX_COMPONENTS)
+        {
+            std::cout << "ERROR::ECS::TOO_MANY_COMPONENT_TYPES: more than " << ECS_MAX_COMPONENTS << std::endl;
+            std::abort();
+        }
+        componentSizes()[type] = sizeof(T);
+        return type;
+    }();
+    return id;
+}
+
+// ------------------------------------------------------------------------
+template <typename... Components>
+unsigned int componentMask()
+{
+    unsigned int mask = 0;
+    ((mask |= 1u << componentType<Components>()), ...);
+    return mask;
+}
+
+// one set of component types and the chunks holding its entities
+struct Archetype
+{
+    unsigned int mask = 0;
+    std::vector<unsigned int> types;
+    unsigned int offsets[ECS_MAX_COMPONENTS] = {}; // byte offset of each type's array in a chunk, entities at 0
+    unsigned int capacity = 0;                     // entities per chunk
+    unsigned int count = 0;
+    std::vector<unsigned char *> chunks;
+};
+
+class World
+{
+public:
+    World() = default;
+    World(const World &) = delete;
+    World &operator=(const World &) = delete;
+    // ------------------------------------------------------------------------
+    ~World()
+    {
+        for (Archetype &archetype : archetypes)
+        {
+            for (unsigned char *chunk : archetype.chunks)
+                pool.release(chunk);
+        }
+    }
+    // ------------------------------------------------------------------------
+    template <typename... Components>
+    Entity create(const Components &...components)
+    {
+        unsigned int archetype = findArchetype(componentMask<Components...>());
+        Entity entity;
+        if (freeIndices.empty())
+        {
+            entity.index = (unsigned int)records.size();
+            records.push_back(EntityRecord());
+        }
+        else
+        {
+            entity.index = freeIndices.back();
+            freeIndices.pop_back();
+        }
+        entity.generation = records[entity.index].generation;
+        unsigned int row = pushRow(archetype, entity);
+        ((*(Components *)componentAt(archetypes[archetype], row, componentType<Components>()) = components), ...);
+        records[entity.index].archetype = archetype;
+        records[entity.index].row = row;
+        return entity;
+    }
+    // ------------------------------------------------------------------------
+    void destroy(Entity entity)
+    {
+        if (!alive(entity))
+            return;
+        EntityRecord &record = records[entity.index];
+        removeRow(record.archetype, record.row);
+        record.archetype = NO_ARCHETYPE;
+        record.generation++;
+        freeIndices.push_back(entity.index);
+    }
+    // ------------------------------------------------------------------------
+    bool alive(Entity entity) const
+    {
+        return entity.index < records.size() && records[entity.index].generation == entity.generation && records[entity.index].archetype != NO_ARCHETYPE;
+    }
+    // ------------------------------------------------------------------------
+    template <typename T>
+    bool has(Entity entity) const
+    {
+        return alive(entity) && (archetypes[records[entity.index].archetype].mask & (1u << componentType<T>())) != 0;
+    }
+    // the entity must have T; the reference is valid until the next structural change
+    // ------------------------------------------------------------------------
+    template <typename T>
+    T &get(Entity entity)
+    {
+        const EntityRecord &record = records[entity.index];
+        return *(T *)componentAt(archetypes[record.archetype], record.row, componentType<T>());
+    }
+    // adds T (or overwrites it), which moves the entity to the archetype with T
+    // ------------------------------------------------------------------------
+    template <typename T>
+    void add(Entity entity, const T &component)
+    {
+        if (has<T>(entity))
+        {
+            get<T>(entity) = component;
+            return;
+        }
+        unsigned int archetype = moveEntity(entity, archetypes[records[entity.index].archetype].mask | (1u << componentType<T>()));
+        *(T *)componentAt(archetypes[archetype], records[entity.index].row, componentType<T>()) = component;
+    }
+    // ------------------------------------------------------------------------
+    template <typename T>
+    void remove(Entity entity)
+    {
+        if (has<T>(entity))
+            moveEntity(entity, archetypes[records[entity.index].archetype].mask & ~(1u << componentType<T>()));
+    }
+    // fn(count, entities, Components *...) once per chunk of every archetype with all of Components,
+    // the arrays are contiguous. No creating/destroying/adding/removing inside.
+    // ------------------------------------------------------------------------
+    template <typename... Components, typename Function>
+    void eachChunk(Function fn)
+    {
+        unsigned int mask = componentMask<Components...>();
+        for (Archetype &archetype : archetypes)
+        {
+            if ((archetype.mask & mask) != mask)
+                continue;
+            for (unsigned int chunk = 0; chunk < archetype.chunks.size(); chunk++)
+            {
+                unsigned char *data = archetype.chunks[chunk];
+                unsigned int count = std::min(archetype.capacity, archetype.count - chunk * archetype.capacity);
+                fn(count, (const Entity *)data, (Components *)(data + archetype.offsets[componentType<Components>()])...);
+            }
+        }
+    }
+    // fn(entity, Components &...) for every entity with all of Components
+    // ------------------------------------------------------------------------
+    template <typename... Components, typename Function>
+    void each(Function fn)
+    {
+        eachChunk<Components...>([&](unsigned int count, const Entity *entities, Components *...arrays)
+                                 {
+                                     for (unsigned int i = 0; i < count; i++)
+                                         fn(entities[i], arrays[i]...);
+                                 });
+    }
+    // ------------------------------------------------------------------------
+    unsigned int entityCount() const
+    {
+        return (unsigned int)(records.size() - freeIndices.size());
+    }
+    // ------------------------------------------------------------------------
+    unsigned int archetypeCount() const
+    {
+        return (unsigned int)archetypes.size();
+    }
+    // ------------------------------------------------------------------------
+    unsigned int chunkCount() const
+    {
+        return pool.allocatedChunks();
+    }
+
+private:
+    static const unsigned int NO_ARCHETYPE = ~0u;
+
+    struct EntityRecord
+    {
+        unsigned int archetype = NO_ARCHETYPE;
+        unsigned int row = 0;
+        unsigned int generation = 0;
+    };
+
+    std::vector<EntityRecord> records;
+    std::vector<unsigned int> freeIndices;
+    std::vector<Archetype> archetypes;
+    std::unordered_map<unsigned int, unsigned int> archetypeByMask;
+    ChunkPool pool;
+
+    // ------------------------------------------------------------------------
+    unsigned int findArchetype(unsigned int mask)
+    {
+        auto found = archetypeByMask.find(mask);
+        if (found != archetypeByMask.end())
+            return found->second;
+        Archetype archetype;
+        archetype.mask = mask;
+        unsigned int rowSize = sizeof(Entity);
+        for (unsigned int type = 0; type < ECS_MAX_COMPONENTS; type++)
+        {
+            if (mask & (1u << type))
+            {
+                archetype.types.push_back(type);
+                rowSize += componentSizes()[type];
+            }
+        }
+        // every array may waste up to 63 bytes of padding to start on a cache line
+        archetype.capacity = (ECS_CHUNK_SIZE - 64 * (unsigned int)archetype.types.size()) / rowSize;
+        unsigned int offset = archetype.capacity * sizeof(Entity);
+        for (unsigned int type : archetype.types)
+        {
+            offset = (offset + 63) & ~63u;
+            archetype.offsets[type] = offset;
+            offset += archetype.capacity * componentSizes()[type];
+        }
+        archetypes.push_back(archetype);
+        archetypeByMask[mask] = (unsigned int)archetypes.size() - 1;
+        return (unsigned int)archetypes.size() - 1;
+    }
+    // ------------------------------------------------------------------------
+    unsigned char *componentAt(Archetype &archetype, unsigned int row, unsigned int type)
+    {
+        return archetype.chunks[row / archetype.capacity] + archetype.offsets[type] + (size_t)(row % archetype.capacity) * componentSizes()[type];
+    }
+    // a new last row holding entity, components uninitialized
+    // ------------------------------------------------------------------------
+    unsigned int pushRow(unsigned int index, Entity entity)
+    {
+        Archetype &archetype = archetypes[index];
+        unsigned int row = archetype.count++;
+        if (row / archetype.capacity == archetype.chunks.size())
+            archetype.chunks.push_back(pool.allocate());
+        ((Entity *)archetype.chunks[row / archetype.capacity])[row % archetype.capacity] = entity;
+        return row;
+    }
+    // fills row with the last row of the archetype (whose record follows it), chunks that became empty go back to the pool
+    // ------------------------------------------------------------------------
+    void removeRow(unsigned int index, unsigned int row)
+    {
+        Archetype &archetype = archetypes[index];
+        unsigned int last = --archetype.count;
+        if (row != last)
+        {
+            for (unsigned int type : archetype.types)
+                memcpy(componentAt(archetype, row, type), componentAt(archetype, last, type), componentSizes()[type]);
+            Entity moved = ((Entity *)archetype.chunks[last / archetype.capacity])[last % archetype.capacity];
+            ((Entity *)archetype.chunks[row / archetype.capacity])[row % archetype.capacity] = moved;
+            records[moved.index].row = row;
+        }
+        if (archetype.count % archetype.capacity == 0 && archetype.chunks.size() > archetype.count / archetype.capacity)
+        {
+            pool.release(archetype.chunks.back());
+            archetype.chunks.pop_back();
+        }
+    }
+    // into the archetype of mask, keeping the components both have; returns the new archetype
+    // ------------------------------------------------------------------------
+    unsigned int moveEntity(Entity entity, unsigned int mask)
+    {
+        unsigned int target = findArchetype(mask);
+        EntityRecord record = records[entity.index];
+        unsigned int row = pushRow(target, entity);
+        for (unsigned int type : archetypes[record.archetype].types)
+        {
+            if (mask & (1u << type))
+                memcpy(componentAt(archetypes[target], row, type), componentAt(archetypes[record.archetype], record.row, type), componentSizes()[type]);
+        }
+        removeRow(record.archetype, record.row);
+        records[entity.index].archetype = target;
+        records[entity.index].row = row;
+        return target;
+    }
+};
+#endif
@@ -0,0 +1,94 @@
+#ifndef FRAME_ARENA_H
+#define FRAME_ARENA_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+// Linear allocator for scratch data that lives for one frame: allocate() bumps an offset into one block and
+// reset() drops everything at once, nothing is freed or destructed on its own (trivially destructible types
+// only). A frame that needs more than the block gets extra blocks from the heap; the next reset() swaps them
+// for one block with room for that frame, so a scene that stopped growing never reaches the heap again.
+class FrameArena
+{
+public:
+    size_t used = 0;      // bytes handed out since the last reset(), alignment included
+    size_t highWater = 0; // most bytes a frame needed so far
+
+    // ------------------------------------------------------------------------
+    explicit FrameArena(size_t capacity = 64 * 1024)
+        : block(new unsigned char[capacity]), blockSize(capacity)
+    {
+    }
+    // ------------------------------------------------------------------------
+    ~FrameArena()
+    {
+        releaseOverflow();
+        delete[] block;
+    }
+    FrameArena(const FrameArena &) = delete;
+    FrameArena &operator=(const FrameArena &) = delete;
+
+    // count uninitialized Ts, valid until the next reset()
+    // ------------------------------------------------------------------------
+    template <typename T>
+    T *allocate(size_t count)
+    {
+        static_assert(std::is_trivially_destructible<T>::value, "the arena never runs destructors");
+        return (T *)allocate(count * sizeof(T), alignof(T));
+    }
+    // ------------------------------------------------------------------------
+    void *allocate(size_t size, size_t alignment)
+    {
+        uintptr_t start = ((uintptr_t)block + offset + alignment - 1) & ~(uintptr_t)(alignment - 1);
+        size_t end = start - (uintptr_t)block + size;
+        if (end <= blockSize)
+        {
+            used += end - offset;
+            offset = end;
+            return (void *)start;
+        }
+        // out of room: a heap block of its own until the next reset()
+        unsigned char *extra = new unsigned char[size + alignment];
+        overflow.push_back(extra);
+        used += size + alignment;
+        return (void *)(((uintptr_t)extra + alignment - 1) & ~(uintptr_t)(alignment - 1));
+    }
+    // forgets everything allocated since the last reset()
+    // ------------------------------------------------------------------------
+    void reset()
+    {
+        highWater = std::max(highWater, used);
+        if (!overflow.empty())
+        {
+            releaseOverflow();
+            delete[] block;
+            blockSize = highWater + highWater / 2;
+            block = new unsigned char[blockSize];
+        }
+        offset = 0;
+        used = 0;
+    }
+    // ------------------------------------------------------------------------
+    size_t capacity() const
+    {
+        return blockSize;
+    }
+
+private:
+    unsigned char *block;
+    size_t blockSize;
+    size_t offset = 0;
+    std::vector<unsigned char *> overflow;
+
+    // ------------------------------------------------------------------------
+    void releaseOverflow()
+    {
+        for (unsigned char *extra : overflow)
+            delete[] extra;
+        overflow.clear();
+    }
+};
+#endif
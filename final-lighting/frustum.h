@@ -0,0 +1,45 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm.hpp>
+
+// view frustum as 6 planes (xyz = inward normal, w = distance), extracted from projection * view
+// (Gribb/Hartmann). A point p is inside a plane when dot(plane.xyz, p) + plane.w >= 0.
+struct Frustum
+{
+    glm::vec4 planes[6];
+
+    Frustum() {}
+    explicit Frustum(const glm::mat4 &viewProjection)
+    {
+        // rows of the (column-major) matrix
+        glm::vec4 row0(viewProjection[0][0], viewProjection[1][0], viewProjection[2][0], viewProjection[3][0]);
+        glm::vec4 row1(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1], viewProjection[3][1]);
+        glm::vec4 row2(viewProjection[0][2], viewProjection[1][2], viewProjection[2][2], viewProjection[3][2]);
+        glm::vec4 row3(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+        planes[0] = row3 + row0; // left
+        planes[1] = row3 - row0; // right
+        planes[2] = row3 + row1; // bottom
+        planes[3] = row3 - row1; // top
+        planes[4] = row3 + row2; // near
+        planes[5] = row3 - row2; // far
+        for (int i = 0; i < 6; i++)
+            planes[i] = planes[i] / glm::length(glm::vec3(planes[i]));
+    }
+    // false only if the box is completely outside one of the planes (can keep a few invisible boxes)
+    // ------------------------------------------------------------------------
+    bool intersects(const glm::vec3 &boundsMin, const glm::vec3 &boundsMax) const
+    {
+        for (int i = 0; i < 6; i++)
+        {
+            // the box corner furthest along the plane normal
+            glm::vec3 p(planes[i].x >= 0.0f ? boundsMax.x : boundsMin.x,
+                        planes[i].y >= 0.0f ? boundsMax.y : boundsMin.y,
+                        planes[i].z >= 0.0f ? boundsMax.z : boundsMin.z);
+            if (glm::dot(glm::vec3(planes[i]), p) + planes[i].w < 0.0f)
+                return false;
+        }
+        return true;
+    }
+};
+#endif
@@ -0,0 +1,311 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <glad/glad.h>
+
+#include <cstring>
+
+// ------------------------------------------------------------------------
+inline bool hasGLExtension(const char *name)
+{
+    int count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (int i = 0; i < count; i++)
+    {
+        const char *extension = (const char *)glGetStringi(GL_EXTENSIONS, i);
+        if (extension && strcmp(extension, name) == 0)
+            return true;
+    }
+    return false;
+}
+
+// Shadow copy of the GL state the renderer touches every frame: program, VAO, buffer bindings (generic and
+// indexed), 2D textures per unit, samplers, depth/blend/color state and the viewport. A call that would set
+// what is already set is dropped; issued/filtered count both. Everything starts unknown, so the first call
+// always goes through. Code that talks to GL directly must call invalidate() afterwards, objects must be
+// deleted through deleteBuffers()/deleteVertexArrays()/... so a recycled name is not mistaken for a bound one.
+// The element array binding belongs to the VAO and is always passed through.
+class GLStateCache
+{
+public:
+    static const unsigned int TEXTURE_UNITS = 16;
+    static const unsigned int BUFFER_INDICES = 8; // indexed SSBO/UBO binding points that are tracked
+    unsigned long long issued = 0;
+    unsigned long long filtered = 0;
+
+    // ------------------------------------------------------------------------
+    void invalidate()
+    {
+        program = vertexArray = UNKNOWN;
+        for (unsigned int i = 0; i < BUFFER_TARGETS; i++)
+            buffers[i] = UNKNOWN;
+        for (unsigned int i = 0; i < BUFFER_INDICES; i++)
+            storageBuffers[i] = uniformBuffers[i] = UNKNOWN;
+        for (unsigned int i = 0; i < TEXTURE_UNITS; i++)
+            textures[i] = samplers[i] = UNKNOWN;
+        activeUnit = UNKNOWN;
+        for (unsigned int i = 0; i < CAPABILITIES; i++)
+            capabilities[i] = -1;
+        depthFunction = blendSource = blendDestination = UNKNOWN;
+        depthWrite = colorWrite = -1;
+        viewportRect[0] = viewportRect[1] = viewportRect[2] = viewportRect[3] = -1;
+    }
+    // ------------------------------------------------------------------------
+    void resetCounters()
+    {
+        issued = filtered = 0;
+    }
+    // ------------------------------------------------------------------------
+    void useProgram(GLuint id)
+    {
+        if (skip(program == id))
+            return;
+        program = id;
+        glUseProgram(id);
+    }
+    // ------------------------------------------------------------------------
+    void bindVertexArray(GLuint id)
+    {
+        if (skip(vertexArray == id))
+            return;
+        vertexArray = id;
+        glBindVertexArray(id);
+    }
+    // ------------------------------------------------------------------------
+    void bindBuffer(GLenum target, GLuint id)
+    {
+        int slot = bufferSlot(target);
+        if (skip(slot >= 0 && buffers[slot] == id))
+            return;
+        if (slot >= 0)
+            buffers[slot] = id;
+        glBindBuffer(target, id);
+    }
+    // also sets the generic binding of target, like GL does
+    // ------------------------------------------------------------------------
+    void bindBufferBase(GLenum target, GLuint index, GLuint id)
+    {
+        unsigned int *indexed = target == GL_SHADER_STORAGE_BUFFER ? storageBuffers : target == GL_UNIFORM_BUFFER ? uniformBuffers : nullptr;
+        bool tracked = indexed && index < BUFFER_INDICES;
+        if (skip(tracked && indexed[index] == id && buffers[bufferSlot(target)] == id))
+            return;
+        if (tracked)
+            indexed[index] = id;
+        int slot = bufferSlot(target);
+        if (slot >= 0)
+            buffers[slot] = id;
+        glBindBufferBase(target, index, id);
+    }
+    // only GL_TEXTURE_2D is tracked per unit, other targets are passed through
+    // ------------------------------------------------------------------------
+    void bindTexture(GLuint unit, GLenum target, GLuint id)
+    {
+        bool tracked = target == GL_TEXTURE_2D && unit < TEXTURE_UNITS;
+        if (skip(tracked && textures[unit] == id))
+            return;
+        if (activeUnit != unit)
+        {
+            glActiveTexture(GL_TEXTURE0 + unit);
+            activeUnit = unit;
+            issued++;
+        }
+        if (tracked)
+            textures[unit] = id;
+        glBindTexture(target, id);
+    }
+    // ------------------------------------------------------------------------
+    void bindSampler(GLuint unit, GLuint id)
+    {
+        if (skip(unit < TEXTURE_UNITS && samplers[unit] == id))
+            return;
+        if (unit < TEXTURE_UNITS)
+            samplers[unit] = id;
+        glBindSampler(unit, id);
+    }
+    // glEnable/glDisable, GL_DEPTH_TEST, GL_BLEND, GL_CULL_FACE, GL_SCISSOR_TEST and GL_STENCIL_TEST are tracked
+    // ------------------------------------------------------------------------
+    void setEnabled(GLenum capability, bool enabled)
+    {
+        int slot = capabilitySlot(capability);
+        if (skip(slot >= 0 && capabilities[slot] == (enabled ? 1 : 0)))
+            return;
+        if (slot >= 0)
+            capabilities[slot] = enabled ? 1 : 0;
+        if (enabled)
+            glEnable(capability);
+        else
+            glDisable(capability);
+    }
+    // ------------------------------------------------------------------------
+    void depthFunc(GLenum function)
+    {
+        if (skip(depthFunction == function))
+            return;
+        depthFunction = function;
+        glDepthFunc(function);
+    }
+    // ------------------------------------------------------------------------
+    void depthMask(bool write)
+    {
+        if (skip(depthWrite == (write ? 1 : 0)))
+            return;
+        depthWrite = write ? 1 : 0;
+        glDepthMask(write ? GL_TRUE : GL_FALSE);
+    }
+    // all four channels at once, that is all this renderer needs
+    // ------------------------------------------------------------------------
+    void colorMask(bool write)
+    {
+        if (skip(colorWrite == (write ? 1 : 0)))
+            return;
+        colorWrite = write ? 1 : 0;
+        GLboolean mask = write ? GL_TRUE : GL_FALSE;
+        glColorMask(mask, mask, mask, mask);
+    }
+    // ------------------------------------------------------------------------
+    void blendFunc(GLenum source, GLenum destination)
+    {
+        if (skip(blendSource == source && blendDestination == destination))
+            return;
+        blendSource = source;
+        blendDestination = destination;
+        glBlendFunc(source, destination);
+    }
+    // ------------------------------------------------------------------------
+    void viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+    {
+        if (skip(viewportRect[0] == x && viewportRect[1] == y && viewportRect[2] == width && viewportRect[3] == height))
+            return;
+        viewportRect[0] = x;
+        viewportRect[1] = y;
+        viewportRect[2] = width;
+        viewportRect[3] = height;
+        glViewport(x, y, width, height);
+    }
+    // deleting unbinds the object everywhere in GL, the cache forgets it the same way
+    // ------------------------------------------------------------------------
+    void deleteBuffers(GLsizei count, const GLuint *ids)
+    {
+        for (GLsizei n = 0; n < count; n++)
+        {
+            for (unsigned int i = 0; i < BUFFER_TARGETS; i++)
+                forget(buffers[i], ids[n]);
+            for (unsigned int i = 0; i < BUFFER_INDICES; i++)
+            {
+                forget(storageBuffers[i], ids[n]);
+                forget(uniformBuffers[i], ids[n]);
+            }
+        }
+        glDeleteBuffers(count, ids);
+    }
+    // ------------------------------------------------------------------------
+    void deleteVertexArrays(GLsizei count, const GLuint *ids)
+    {
+        for (GLsizei n = 0; n < count; n++)
+            forget(vertexArray, ids[n]);
+        glDeleteVertexArrays(count, ids);
+    }
+    // ------------------------------------------------------------------------
+    void deleteTextures(GLsizei count, const GLuint *ids)
+    {
+        for (GLsizei n = 0; n < count; n++)
+        {
+            for (unsigned int i = 0; i < TEXTURE_UNITS; i++)
+                forget(textures[i], ids[n]);
+        }
+        glDeleteTextures(count, ids);
+    }
+    // ------------------------------------------------------------------------
+    void deleteSamplers(GLsizei count, const GLuint *ids)
+    {
+        for (GLsizei n = 0; n < count; n++)
+        {
+            for (unsigned int i = 0; i < TEXTURE_UNITS; i++)
+                forget(samplers[i], ids[n]);
+        }
+        glDeleteSamplers(count, ids);
+    }
+    // a deleted program stays current until another one is used, so only a later name reuse matters
+    // ------------------------------------------------------------------------
+    void deleteProgram(GLuint id)
+    {
+        forget(program, id);
+        glDeleteProgram(id);
+    }
+
+private:
+    static const unsigned int UNKNOWN = 0xFFFFFFFFu;
+    static const unsigned int BUFFER_TARGETS = 6;
+    static const unsigned int CAPABILITIES = 5;
+
+    unsigned int program = UNKNOWN;
+    unsigned int vertexArray = UNKNOWN;
+    unsigned int buffers[BUFFER_TARGETS] = {UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN};
+    unsigned int storageBuffers[BUFFER_INDICES] = {UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN};
+    unsigned int uniformBuffers[BUFFER_INDICES] = {UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN};
+    unsigned int textures[TEXTURE_UNITS] = {UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN,
+                                            UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN};
+    unsigned int samplers[TEXTURE_UNITS] = {UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN,
+                                            UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN};
+    unsigned int activeUnit = UNKNOWN;
+    int capabilities[CAPABILITIES] = {-1, -1, -1, -1, -1}; // -1 unknown, 0 disabled, 1 enabled
+    unsigned int depthFunction = UNKNOWN;
+    unsigned int blendSource = UNKNOWN;
+    unsigned int blendDestination = UNKNOWN;
+    int depthWrite = -1;
+    int colorWrite = -1;
+    GLint viewportRect[4] = {-1, -1, -1, -1};
+
+    // counts the call and returns true when it can be dropped
+    // ------------------------------------------------------------------------
+    bool skip(bool redundant)
+    {
+        if (redundant)
+            filtered++;
+        else
+            issued++;
+        return redundant;
+    }
+    // ------------------------------------------------------------------------
+    static void forget(unsigned int &binding, GLuint id)
+    {
+        if (binding == id)
+            binding = 0;
+    }
+    // ------------------------------------------------------------------------
+    static int bufferSlot(GLenum target)
+    {
+        switch (target)
+        {
+        case GL_ARRAY_BUFFER: return 0;
+        case GL_SHADER_STORAGE_BUFFER: return 1;
+        case GL_UNIFORM_BUFFER: return 2;
+        case GL_DRAW_INDIRECT_BUFFER: return 3;
+        case GL_DISPATCH_INDIRECT_BUFFER: return 4;
+        case GL_COPY_WRITE_BUFFER: return 5;
+        default: return -1;
+        }
+    }
+    // ------------------------------------------------------------------------
+    static int capabilitySlot(GLenum capability)
+    {
+        switch (capability)
+        {
+        case GL_DEPTH_TEST: return 0;
+        case GL_BLEND: return 1;
+        case GL_CULL_FACE: return 2;
+        case GL_SCISSOR_TEST: return 3;
+        case GL_STENCIL_TEST: return 4;
+        default: return -1;
+        }
+    }
+};
+
+// the one cache of the (single) GL context
+// ------------------------------------------------------------------------
+inline GLStateCache &glState()
+{
+    static GLStateCache cache;
+    return cache;
+}
+#endif
@@ -0,0 +1,199 @@
+#ifndef GLSL_LAYOUT_H
+#define GLSL_LAYOUT_H
+
+#include <glad/glad.h>
+#include <glm.hpp>
+
+#include <cstddef>
+#include <initializer_list>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// std140/std430 layout rules at compile time, to check C++ mirrors of GLSL block structs: describe the GLSL
+// struct as GlslStruct<layout, member types...> and static_assert that the offsetof()s and sizeof() of the
+// mirror are the ones GLSL uses, then whole structs can be memcpy'd into a mapped buffer.
+//   scalars: size = alignment = 4    vec2: 8 / 8    vec3: 12 / 16 (a float may follow at +12)    vec4, mat4: 16
+//   arrays (GlslArray<T, N>): element stride = size rounded up to the alignment, std140 rounds both up to 16
+//   structs: alignment of the biggest member, std140 rounds it up to 16; size rounded up to the alignment
+// checkUniformBlock()/checkStorageBlock() compare the same offsets with what the linked program reports.
+enum class GlslLayout
+{
+    Std140,
+    Std430
+};
+
+// ------------------------------------------------------------------------
+constexpr size_t glslRoundUp(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+template <GlslLayout Layout, typename T>
+struct GlslTraits;
+template <GlslLayout Layout>
+struct GlslTraits<Layout, float>
+{
+    static constexpr size_t size = 4, alignment = 4;
+};
+template <GlslLayout Layout>
+struct GlslTraits<Layout, int>
+{
+    static constexpr size_t size = 4, alignment = 4;
+};
+template <GlslLayout Layout>
+struct GlslTraits<Layout, unsigned int>
+{
+    static constexpr size_t size = 4, alignment = 4;
+};
+template <GlslLayout Layout>
+struct GlslTraits<Layout, glm::vec2>
+{
+    static constexpr size_t size = 8, alignment = 8;
+};
+template <GlslLayout Layout>
+struct GlslTraits<Layout, glm::vec3>
+{
+    static constexpr size_t size = 12, alignment = 16;
+};
+template <GlslLayout Layout>
+struct GlslTraits<Layout, glm::vec4>
+{
+    static constexpr size_t size = 16, alignment = 16;
+};
+template <GlslLayout Layout>
+struct GlslTraits<Layout, glm::mat4>
+{
+    static constexpr size_t size = 64, alignment = 16; // column major, an array of 4 vec4
+};
+
+template <typename Element, size_t Count>
+struct GlslArray
+{
+};
+template <GlslLayout Layout, typename Element, size_t Count>
+struct GlslTraits<Layout, GlslArray<Element, Count>>
+{
+    static constexpr size_t alignment = Layout == GlslLayout::Std140 ? glslRoundUp(GlslTraits<Layout, Element>::alignment, 16) : GlslTraits<Layout, Element>::alignment;
+    static constexpr size_t stride = glslRoundUp(GlslTraits<Layout, Element>::size, alignment);
+    static constexpr size_t size = stride * Count;
+};
+
+template <GlslLayout Layout, typename... Members>
+struct GlslStruct
+{
+    static constexpr size_t count = sizeof...(Members);
+    static constexpr size_t sizes[] = {GlslTraits<Layout, Members>::size...};
+    static constexpr size_t alignments[] = {GlslTraits<Layout, Members>::alignment...};
+
+    // ------------------------------------------------------------------------
+    static constexpr size_t offset(size_t member)
+    {
+        size_t at = 0;
+        for (size_t i = 0; i < member; i++)
+            at = glslRoundUp(at, alignments[i]) + sizes[i];
+        return glslRoundUp(at, alignments[member]);
+    }
+    // ------------------------------------------------------------------------
+    static constexpr size_t baseAlignment()
+    {
+        size_t biggest = 4;
+        for (size_t i = 0; i < count; i++)
+            biggest = alignments[i] > biggest ? alignments[i] : biggest;
+        return Layout == GlslLayout::Std140 ? glslRoundUp(biggest, 16) : biggest;
+    }
+    static constexpr size_t alignment = baseAlignment();
+    static constexpr size_t size = glslRoundUp(offset(count - 1) + sizes[count - 1], alignment);
+
+    // offsetof() of every member of the C++ mirror in declaration order (padding left out) and its sizeof()
+    // ------------------------------------------------------------------------
+    static constexpr bool matches(std::initializer_list<size_t> memberOffsets, size_t mirrorSize)
+    {
+        if (memberOffsets.size() != count || mirrorSize != size)
+            return false;
+        size_t i = 0;
+        for (size_t at : memberOffsets)
+        {
+            if (at != offset(i++))
+                return false;
+        }
+        return true;
+    }
+};
+template <GlslLayout Layout, GlslLayout StructLayout, typename... Members>
+struct GlslTraits<Layout, GlslStruct<StructLayout, Members...>>
+{
+    static constexpr size_t size = GlslStruct<StructLayout, Members...>::size;
+    static constexpr size_t alignment = GlslStruct<StructLayout, Members...>::alignment;
+};
+
+// a member of a block as the program names it ("pointLights[2].position", "spins[0].phase") and its C++ offset
+struct BlockMember
+{
+    std::string name;
+    size_t offset;
+};
+
+// the linked program's offsets of the uniform block's members against the C++ ones, reports every mismatch.
+// Every member of a std140 block is active, so a name GL does not know is a mismatch as well
+// ------------------------------------------------------------------------
+inline bool checkUniformBlock(GLuint program, const char *blockName, size_t mirrorSize, const std::vector<BlockMember> &members)
+{
+    GLuint block = glGetUniformBlockIndex(program, blockName);
+    if (block == GL_INVALID_INDEX)
+    {
+        std::cout << "ERROR::GLSL_LAYOUT::NO_UNIFORM_BLOCK: " << blockName << " (program " << program << ")" << std::endl;
+        return false;
+    }
+    bool matching = true;
+    GLint dataSize = 0;
+    glGetActiveUniformBlockiv(program, block, GL_UNIFORM_BLOCK_DATA_SIZE, &dataSize);
+    if ((size_t)dataSize > mirrorSize)
+    {
+        std::cout << "ERROR::GLSL_LAYOUT::BLOCK_SIZE: " << blockName << " is " << dataSize << " bytes, the C++ mirror " << mirrorSize << std::endl;
+        matching = false;
+    }
+    for (const BlockMember &member : members)
+    {
+        const char *name = member.name.c_str();
+        GLuint index = GL_INVALID_INDEX;
+        glGetUniformIndices(program, 1, &name, &index);
+        GLint offset = -1;
+        if (index != GL_INVALID_INDEX)
+            glGetActiveUniformsiv(program, 1, &index, GL_UNIFORM_OFFSET, &offset);
+        if (offset != (GLint)member.offset)
+        {
+            std::cout << "ERROR::GLSL_LAYOUT::MEMBER_OFFSET: " << blockName << "." << member.name << " at " << offset << ", the C++ mirror at " << member.offset << std::endl;
+            matching = false;
+        }
+    }
+    return matching;
+}
+// the same for a shader storage block whose last member is an array of structs (GL 4.3 program interface
+// queries): member offsets inside element 0 and the array stride against the mirror of one element
+// ------------------------------------------------------------------------
+inline bool checkStorageBlock(GLuint program, const char *blockName, size_t elementSize, const std::vector<BlockMember> &members)
+{
+    if (glGetProgramResourceIndex(program, GL_SHADER_STORAGE_BLOCK, blockName) == GL_INVALID_INDEX)
+    {
+        std::cout << "ERROR::GLSL_LAYOUT::NO_STORAGE_BLOCK: " << blockName << " (program " << program << ")" << std::endl;
+        return false;
+    }
+    bool matching = true;
+    for (const BlockMember &member : members)
+    {
+        GLuint index = glGetProgramResourceIndex(program, GL_BUFFER_VARIABLE, member.name.c_str());
+        const GLenum properties[2] = {GL_OFFSET, GL_TOP_LEVEL_ARRAY_STRIDE};
+        GLint values[2] = {-1, -1};
+        if (index != GL_INVALID_INDEX)
+            glGetProgramResourceiv(program, GL_BUFFER_VARIABLE, index, 2, properties, 2, NULL, values);
+        if (values[0] != (GLint)member.offset || values[1] != (GLint)elementSize)
+        {
+            std::cout << "ERROR::GLSL_LAYOUT::MEMBER_OFFSET: " << blockName << "." << member.name << " at " << values[0] << " stride " << values[1]
+                      << ", the C++ mirror at " << member.offset << " stride " << elementSize << std::endl;
+            matching = false;
+        }
+    }
+    return matching;
+}
+#endif
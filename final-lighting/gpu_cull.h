@@ -0,0 +1,122 @@
+#ifndef GPU_CULL_H
+#define GPU_CULL_H
+
+#include <glad/glad.h>
+#include <glm.hpp>
+
+#include <cstddef>
+#include <vector>
+
+#include "compute_shader.h"
+#include "frustum.h"
+#include "gl_state.h"
+#include "mesh_pool.h"
+
+// layout of one glDrawElementsIndirect command
+struct DrawElementsIndirectCommand
+{
+    unsigned int count;
+    unsigned int instanceCount;
+    unsigned int firstIndex;
+    int baseVertex;
+    unsigned int baseInstance;
+};
+
+// Frustum culling on the GPU for one mesh with many instances. 4.3.cull.comp tests every instance,
+// compacts the visible model matrices into the output buffer with an atomic counter that is the
+// instanceCount of the indirect command, then glDrawElementsIndirect draws them. Nothing is read back,
+// the cpu cost per frame is a tiny buffer write, one dispatch and one draw no matter the instance count.
+class GpuCuller
+{
+public:
+    static const unsigned int INPUT_BINDING = 4;   // must match 4.3.cull.comp
+    static const unsigned int COMMAND_BINDING = 5;
+    static const unsigned int WORKGROUP_SIZE = 64;
+    // hashed names of the frustum planes in 4.3.cull.comp, one per element
+    static constexpr UniformId PLANE_UNIFORMS[6] = {"planes[0]"_u, "planes[1]"_u, "planes[2]"_u, "planes[3]"_u, "planes[4]"_u, "planes[5]"_u};
+
+    unsigned int inputSSBO = 0;
+    unsigned int outputSSBO = 0;
+    unsigned int commandBuffer = 0;
+    unsigned int instanceCount = 0;
+    unsigned int capacity = 0; // instances the input and output buffers hold
+
+    // buffers for up to capacity instances of mesh
+    // ------------------------------------------------------------------------
+    void init(const MeshRange &mesh, unsigned int instanceCapacity)
+    {
+        glGenBuffers(1, &inputSSBO);
+        glGenBuffers(1, &outputSSBO);
+        allocate(instanceCapacity);
+
+        DrawElementsIndirectCommand command = {mesh.indexCount, 0, mesh.firstIndex, (int)mesh.baseVertex, 0};
+        glGenBuffers(1, &commandBuffer);
+        glState().bindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(command), &command, GL_DYNAMIC_DRAW);
+        glState().bindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    }
+    // the instances only change when they move, static ones are uploaded once; more than capacity regrows both
+    // buffers (their old contents are gone, the output is rewritten by every cull anyway)
+    // ------------------------------------------------------------------------
+    void upload(const std::vector<glm::mat4> &models)
+    {
+        if (models.size() > capacity)
+            allocate((unsigned int)models.size());
+        instanceCount = (unsigned int)models.size();
+        glState().bindBuffer(GL_SHADER_STORAGE_BUFFER, inputSSBO);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, models.size() * sizeof(glm::mat4), models.data());
+        glState().bindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+    // resets the counter and runs the culling pass, boundsMin/Max are the mesh's local bounds
+    // ------------------------------------------------------------------------
+    void cull(const ComputeShader &cullShader, const Frustum &frustum, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax, unsigned int outputBinding)
+    {
+        unsigned int zero = 0;
+        glState().bindBuffer(GL_SHADER_STORAGE_BUFFER, commandBuffer);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, offsetof(DrawElementsIndirectCommand, instanceCount), sizeof(zero), &zero);
+        glState().bindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+        cullShader.use();
+        for (int i = 0; i < 6; i++)
+            cullShader.setVec4(PLANE_UNIFORMS[i], frustum.planes[i]);
+        cullShader.setVec3("boundsMin"_u, boundsMin);
+        cullShader.setVec3("boundsMax"_u, boundsMax);
+        cullShader.setUint("totalInstances"_u, instanceCount);
+        glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, INPUT_BINDING, inputSSBO);
+        glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, outputBinding, outputSSBO);
+        glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, COMMAND_BINDING, commandBuffer);
+        glDispatchCompute((instanceCount + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1, 1);
+        // the draw reads the matrices from an SSBO and the count from the indirect buffer
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+    }
+    // draws the survivors with whatever program is bound, the pool must be bound (MeshPool::bind)
+    // and the program must read its matrices from outputBinding with instanceOffset 0
+    // ------------------------------------------------------------------------
+    void draw(unsigned int outputBinding) const
+    {
+        glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, outputBinding, outputSSBO);
+        glState().bindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+        glDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void *)0);
+        glState().bindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    }
+    // ------------------------------------------------------------------------
+    void release()
+    {
+        glState().deleteBuffers(1, &inputSSBO);
+        glState().deleteBuffers(1, &outputSSBO);
+        glState().deleteBuffers(1, &commandBuffer);
+    }
+
+private:
+    // ------------------------------------------------------------------------
+    void allocate(unsigned int instanceCapacity)
+    {
+        capacity = instanceCapacity;
+        glState().bindBuffer(GL_SHADER_STORAGE_BUFFER, inputSSBO);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, capacity * sizeof(glm::mat4), NULL, GL_STATIC_DRAW);
+        glState().bindBuffer(GL_SHADER_STORAGE_BUFFER, outputSSBO);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, capacity * sizeof(glm::mat4), NULL, GL_DYNAMIC_COPY);
+        glState().bindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+};
+#endif
@@ -0,0 +1,164 @@
+#ifndef IMPOSTOR_H
+#define IMPOSTOR_H
+
+#include <glad/glad.h>
+#include <glm.hpp>
+#include <gtc/matrix_transform.hpp>
+
+#include <cmath>
+#include <iostream>
+
+#include "shader_s.h"
+#include "mesh_pool.h"
+#include "gl_state.h"
+
+// octahedral mapping of a unit direction to [-1,1]^2 (y is the pole), must match impostor.vert
+// ------------------------------------------------------------------------
+inline glm::vec3 octahedralDecode(glm::vec2 p)
+{
+    glm::vec3 n(p.x, 1.0f - std::fabs(p.x) - std::fabs(p.y), p.y);
+    if (n.y < 0.0f)
+    {
+        float x = (1.0f - std::fabs(n.z)) * (n.x >= 0.0f ? 1.0f : -1.0f);
+        float z = (1.0f - std::fabs(n.x)) * (n.z >= 0.0f ? 1.0f : -1.0f);
+        n.x = x;
+        n.z = z;
+    }
+    return glm::normalize(n);
+}
+
+// Impostor atlas for one mesh type: the mesh is rendered from framesPerSide^2 directions spread over the
+// sphere with an octahedral layout, each frame an orthographic view that just fits the bounding sphere.
+// Three textures: albedo (rgb + coverage), object-space normal (a = specular), depth along the view
+// direction in units of the radius. Far instances are then drawn as one lit quad with impostor.vert/.frag.
+class ImpostorAtlas
+{
+public:
+    unsigned int albedoTexture = 0;
+    unsigned int normalTexture = 0;
+    unsigned int depthTexture = 0;
+    int framesPerSide = 8;
+    int frameSize = 128;
+    unsigned int mesh = 0;
+    unsigned int meshIndexCount = 0; // for the vertex savings readout
+    glm::vec3 center = glm::vec3(0.0f);
+    float radius = 1.0f;
+
+    // renders the atlas with bakeShader (impostor_bake.vert/.frag), the mesh's textures must be bound
+    // on units 0 (diffuse) and 1 (specular) and the pool must be uploaded
+    // ------------------------------------------------------------------------
+    void bake(const Shader &bakeShader, const MeshPool &pool, unsigned int meshId, const glm::vec3 &boundsCenter, float boundsRadius)
+    {
+        mesh = meshId;
+        meshIndexCount = pool.meshes[meshId].indexCount;
+        center = boundsCenter;
+        radius = boundsRadius;
+        int size = framesPerSide * frameSize;
+
+        albedoTexture = createTexture(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, size);
+        normalTexture = createTexture(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, size);
+        depthTexture = createTexture(GL_R16F, GL_RED, GL_FLOAT, size);
+
+        unsigned int FBO, depthRBO;
+        glGenFramebuffers(1, &FBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, albedoTexture, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, normalTexture, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, depthTexture, 0);
+        glGenRenderbuffers(1, &depthRBO);
+        glBindRenderbuffer(GL_RENDERBUFFER, depthRBO);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, size, size);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthRBO);
+        unsigned int attachments[3] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2};
+        glDrawBuffers(3, attachments);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::IMPOSTOR::FRAMEBUFFER_NOT_COMPLETE" << std::endl;
+
+        int viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        bakeShader.use();
+        bakeShader.setMat4("projection", glm::ortho(-radius, radius, -radius, radius, 0.0f, 4.0f * radius));
+        bakeShader.setVec3("boundsCenter", center);
+        bakeShader.setFloat("boundsRadius", radius);
+        pool.bind();
+        for (int y = 0; y < framesPerSide; y++)
+        {
+            for (int x = 0; x < framesPerSide; x++)
+            {
+                glm::vec3 direction = frameDirection(x, y);
+                glm::vec3 up = std::fabs(direction.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+                bakeShader.setMat4("view", glm::lookAt(center + direction * (2.0f * radius), center, up));
+                bakeShader.setVec3("viewDirection", direction);
+                glState().viewport(x * frameSize, y * frameSize, frameSize, frameSize);
+                pool.draw(meshId);
+            }
+        }
+
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glState().viewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+        glDeleteRenderbuffers(1, &depthRBO);
+        glDeleteFramebuffers(1, &FBO);
+    }
+    // binds the three textures to units firstUnit.. and sets the atlas uniforms of impostorShader
+    // ------------------------------------------------------------------------
+    void bind(const Shader &impostorShader, int firstUnit) const
+    {
+        glState().bindTexture(firstUnit, GL_TEXTURE_2D, albedoTexture);
+        glState().bindTexture(firstUnit + 1, GL_TEXTURE_2D, normalTexture);
+        glState().bindTexture(firstUnit + 2, GL_TEXTURE_2D, depthTexture);
+        setUniforms(impostorShader, firstUnit);
+    }
+    // only the uniforms, for callers that bind the textures themselves; impostorShader must be in use
+    // ------------------------------------------------------------------------
+    void setUniforms(const Shader &impostorShader, int firstUnit) const
+    {
+        impostorShader.setInt("impostor.albedo"_u, firstUnit);
+        impostorShader.setInt("impostor.normal"_u, firstUnit + 1);
+        impostorShader.setInt("impostor.depth"_u, firstUnit + 2);
+        impostorShader.setInt("impostor.framesPerSide"_u, framesPerSide);
+        impostorShader.setVec3("impostor.center"_u, center);
+        impostorShader.setFloat("impostor.radius"_u, radius);
+    }
+    // one quad (triangle strip) per instance
+    // ------------------------------------------------------------------------
+    void draw(unsigned int instanceCount) const
+    {
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, instanceCount);
+    }
+    // ------------------------------------------------------------------------
+    void release()
+    {
+        glState().deleteTextures(1, &albedoTexture);
+        glState().deleteTextures(1, &normalTexture);
+        glState().deleteTextures(1, &depthTexture);
+        albedoTexture = normalTexture = depthTexture = 0;
+    }
+    // view direction (object space, pointing at the camera) of frame x,y
+    // ------------------------------------------------------------------------
+    glm::vec3 frameDirection(int x, int y) const
+    {
+        glm::vec2 p(((float)x + 0.5f) / framesPerSide * 2.0f - 1.0f, ((float)y + 0.5f) / framesPerSide * 2.0f - 1.0f);
+        return octahedralDecode(p);
+    }
+
+private:
+    // ------------------------------------------------------------------------
+    unsigned int createTexture(GLenum internalFormat, GLenum format, GLenum type, int size)
+    {
+        unsigned int texture;
+        glGenTextures(1, &texture);
+        // last unit, units 0/1 hold the material textures the bake samples
+        glState().bindTexture(GLStateCache::TEXTURE_UNITS - 1, GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, size, size, 0, format, type, NULL);
+        // frames sit next to each other, linear filtering would bleed across frame borders at a distance
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        return texture;
+    }
+};
+#endif
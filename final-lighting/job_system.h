@@ -0,0 +1,383 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// One unit of work. The callable is copied into the job itself, so creating a job never allocates; it has
+// to be small and trivially destructible (lambdas capturing references, pointers and numbers).
+// unfinished counts the job plus its children that are not done yet, dependencies counts the jobs it
+// still waits for (plus one until run() was called); continuations are started when the job is done.
+struct alignas(64) Job
+{
+    static const unsigned int PAYLOAD_SIZE = 128;
+    static const unsigned int MAX_CONTINUATIONS = 4;
+
+    void (*function)(Job &job) = nullptr;
+    Job *parent = nullptr;
+    std::atomic<int> unfinished{0};
+    std::atomic<int> dependencies{0};
+    unsigned int continuationCount = 0;
+    Job *continuations[MAX_CONTINUATIONS];
+    alignas(16) unsigned char payload[PAYLOAD_SIZE];
+};
+
+// Chase-Lev work-stealing deque (Le et al., "Correct and Efficient Work-Stealing for Weak Memory Models").
+// The owning worker pushes and pops at the bottom, the other workers steal from the top. Fixed capacity,
+// push() fails when it is full.
+class WorkStealingDeque
+{
+public:
+    static const long CAPACITY = 4096;
+
+    // owner only
+    // ------------------------------------------------------------------------
+    bool push(Job *job)
+    {
+        long b = bottom.load(std::memory_order_relaxed);
+        long t = top.load(std::memory_order_acquire);
+        if (b - t >= CAPACITY)
+            return false;
+        jobs[b & (CAPACITY - 1)].store(job, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return true;
+    }
+    // owner only, newest first
+    // ------------------------------------------------------------------------
+    Job *pop()
+    {
+        long b = bottom.load(std::memory_order_relaxed) - 1;
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        long t = top.load(std::memory_order_relaxed);
+        if (t > b)
+        {
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        Job *job = jobs[b & (CAPACITY - 1)].load(std::memory_order_relaxed);
+        if (t == b)
+        {
+            // last job, race the thieves for it
+            if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                job = nullptr;
+            bottom.store(b + 1, std::memory_order_relaxed);
+        }
+        return job;
+    }
+    // any thread, oldest first
+    // ------------------------------------------------------------------------
+    Job *steal()
+    {
+        long t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        long b = bottom.load(std::memory_order_acquire);
+        if (t >= b)
+            return nullptr;
+        Job *job = jobs[t & (CAPACITY - 1)].load(std::memory_order_relaxed);
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            return nullptr;
+        return job;
+    }
+
+private:
+    alignas(64) std::atomic<long> top{0};
+    alignas(64) std::atomic<long> bottom{0};
+    alignas(64) std::atomic<Job *> jobs[CAPACITY];
+};
+
+// Work-stealing job system: one deque per worker, worker 0 is the thread that created the system (it only
+// works while it is inside wait()/parallelFor()), the others are threads that sleep when there is nothing
+// to do. Jobs come from a per-worker ring of JOB_POOL_SIZE, so a frame must not have more than that many
+// jobs alive per worker. Only the creating thread and the workers may create and run jobs.
+//
+//   Job *a = jobs.createJob([&]() { ... });
+//   Job *b = jobs.createParallelFor(count, [&](unsigned int first, unsigned int last) { ... });
+//   jobs.addDependency(a, b); // b starts when a is done
+//   jobs.run(a); jobs.run(b);
+//   jobs.wait(b);
+class JobSystem
+{
+public:
+    static const unsigned int JOB_POOL_SIZE = 4096;
+
+    // ------------------------------------------------------------------------
+    explicit JobSystem(unsigned int count = std::max(1u, std::thread::hardware_concurrency()))
+        : workers(std::max(1u, count))
+    {
+        for (unsigned int i = 0; i < workers.size(); i++)
+            workers[i].pool.reset(new Job[JOB_POOL_SIZE]);
+        for (unsigned int i = 1; i < workers.size(); i++)
+            threads.emplace_back(&JobSystem::workerLoop, this, i);
+        lastSample = std::chrono::high_resolution_clock::now();
+    }
+    // ------------------------------------------------------------------------
+    ~JobSystem()
+    {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            quit = true;
+        }
+        wakeup.notify_all();
+        for (std::thread &thread : threads)
+            thread.join();
+    }
+    // ------------------------------------------------------------------------
+    unsigned int workerCount() const
+    {
+        return (unsigned int)workers.size();
+    }
+    // a job running function(), a child of parent (which is not done before its children are)
+    // ------------------------------------------------------------------------
+    template <typename Function>
+    Job *createJob(const Function &function, Job *parent = nullptr)
+    {
+        static_assert(sizeof(Function) <= Job::PAYLOAD_SIZE, "job function does not fit into the payload");
+        static_assert(std::is_trivially_destructible<Function>::value, "job functions are never destroyed");
+        Job *job = allocate(parent);
+        new (job->payload) Function(function);
+        job->function = [](Job &job) { (*reinterpret_cast<Function *>(job.payload))(); };
+        return job;
+    }
+    // a job that calls function(first, last) over [0, count) in chunks: every job keeps the first half of
+    // its range and hands the second half to a new job until the range is down to the grain, so idle
+    // workers steal big pieces first. The grain is count / (4 * workers), at least minimumGrain.
+    // ------------------------------------------------------------------------
+    template <typename Function>
+    Job *createParallelFor(unsigned int count, const Function &function, unsigned int minimumGrain = 64)
+    {
+        unsigned int perWorker = (count + 4 * workerCount() - 1) / (4 * workerCount());
+        unsigned int grain = std::max(std::max(minimumGrain, perWorker), 1u);
+        return createJob(
+            [this, count, grain, function]()
+            {
+                Job *root = currentJob();
+                split(root, &function, 0, count, grain);
+            });
+    }
+    // after starts once before is done, call before running either of them (MAX_CONTINUATIONS per job)
+    // ------------------------------------------------------------------------
+    void addDependency(Job *before, Job *after)
+    {
+        after->dependencies.fetch_add(1, std::memory_order_relaxed);
+        before->continuations[before->continuationCount++] = after;
+    }
+    // the job is queued once everything it depends on is done
+    // ------------------------------------------------------------------------
+    void run(Job *job)
+    {
+        if (job->dependencies.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            push(job);
+    }
+    // works on other jobs until job and its children are done
+    // ------------------------------------------------------------------------
+    void wait(const Job *job)
+    {
+        unsigned int worker = workerIndex();
+        while (job->unfinished.load(std::memory_order_acquire) > 0)
+        {
+            Job *next = findJob(worker);
+            if (next)
+                execute(next, worker);
+            else
+                std::this_thread::yield();
+        }
+    }
+    // blocking parallel for, small counts run inline on the calling thread
+    // ------------------------------------------------------------------------
+    template <typename Function>
+    void parallelFor(unsigned int count, const Function &function, unsigned int minimumGrain = 64)
+    {
+        if (count <= minimumGrain || workerCount() == 1)
+        {
+            if (count > 0)
+                function(0u, count);
+            return;
+        }
+        Job *job = createParallelFor(count, function, minimumGrain);
+        run(job);
+        wait(job);
+    }
+    // busy fraction of every worker and the jobs executed / stolen since the last call
+    // ------------------------------------------------------------------------
+    void sampleStats(std::vector<float> &utilization, unsigned long long &executed, unsigned long long &stolen)
+    {
+        auto now = std::chrono::high_resolution_clock::now();
+        double elapsed = std::chrono::duration<double, std::nano>(now - lastSample).count();
+        lastSample = now;
+        utilization.resize(workers.size());
+        executed = stolen = 0;
+        for (unsigned int i = 0; i < workers.size(); i++)
+        {
+            unsigned long long busy = workers[i].busyNs.exchange(0, std::memory_order_relaxed);
+            utilization[i] = elapsed > 0.0 ? (float)(busy / elapsed) : 0.0f;
+            executed += workers[i].executed.exchange(0, std::memory_order_relaxed);
+            stolen += workers[i].stolen.exchange(0, std::memory_order_relaxed);
+        }
+    }
+
+private:
+    struct alignas(64) Worker
+    {
+        WorkStealingDeque deque;
+        std::unique_ptr<Job[]> pool;
+        unsigned int nextJob = 0;
+        std::atomic<unsigned long long> busyNs{0};
+        std::atomic<unsigned long long> executed{0};
+        std::atomic<unsigned long long> stolen{0};
+        unsigned int nextVictim = 0;
+    };
+    std::vector<Worker> workers;
+    std::vector<std::thread> threads;
+    std::atomic<int> queuedJobs{0};
+    std::atomic<int> sleepingWorkers{0};
+    std::mutex sleepMutex;
+    std::condition_variable wakeup;
+    bool quit = false;
+    std::chrono::high_resolution_clock::time_point lastSample;
+
+    // the worker and job of the calling thread, worker threads of another system count as outsiders (0)
+    // ------------------------------------------------------------------------
+    static JobSystem *&currentSystem()
+    {
+        static thread_local JobSystem *system = nullptr;
+        return system;
+    }
+    static unsigned int &currentWorker()
+    {
+        static thread_local unsigned int worker = 0;
+        return worker;
+    }
+    static Job *&currentJob()
+    {
+        static thread_local Job *job = nullptr;
+        return job;
+    }
+    // ------------------------------------------------------------------------
+    unsigned int workerIndex() const
+    {
+        return currentSystem() == this ? currentWorker() : 0;
+    }
+    // ------------------------------------------------------------------------
+    Job *allocate(Job *parent)
+    {
+        Worker &worker = workers[workerIndex()];
+        Job *job = &worker.pool[worker.nextJob++ & (JOB_POOL_SIZE - 1)];
+        job->function = nullptr;
+        job->parent = parent;
+        job->unfinished.store(1, std::memory_order_relaxed);
+        job->dependencies.store(1, std::memory_order_relaxed);
+        job->continuationCount = 0;
+        if (parent)
+            parent->unfinished.fetch_add(1, std::memory_order_relaxed);
+        return job;
+    }
+    // ------------------------------------------------------------------------
+    template <typename Function>
+    void split(Job *root, const Function *function, unsigned int first, unsigned int last, unsigned int grain)
+    {
+        while (last - first > grain)
+        {
+            unsigned int middle = first + (last - first) / 2;
+            Job *half = createJob(
+                [this, root, function, middle, last, grain]()
+                { split(root, function, middle, last, grain); },
+                root);
+            run(half);
+            last = middle;
+        }
+        (*function)(first, last);
+    }
+    // ------------------------------------------------------------------------
+    void push(Job *job)
+    {
+        unsigned int worker = workerIndex();
+        if (!workers[worker].deque.push(job))
+        {
+            // deque full, do it right here
+            execute(job, worker);
+            return;
+        }
+        queuedJobs.fetch_add(1, std::memory_order_seq_cst);
+        if (sleepingWorkers.load(std::memory_order_seq_cst) > 0)
+        {
+            // taking the lock makes sure a worker between its check and its wait sees the new job
+            std::lock_guard<std::mutex> lock(sleepMutex);
+        }
+        wakeup.notify_one();
+    }
+    // own deque first, then steal round robin
+    // ------------------------------------------------------------------------
+    Job *findJob(unsigned int worker)
+    {
+        Job *job = workers[worker].deque.pop();
+        if (!job)
+        {
+            unsigned int count = (unsigned int)workers.size();
+            for (unsigned int attempt = 1; attempt < count && !job; attempt++)
+            {
+                unsigned int victim = (worker + workers[worker].nextVictim++ % (count - 1) + 1) % count;
+                job = workers[victim].deque.steal();
+            }
+            if (job)
+                workers[worker].stolen.fetch_add(1, std::memory_order_relaxed);
+        }
+        if (job)
+            queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+        return job;
+    }
+    // ------------------------------------------------------------------------
+    void execute(Job *job, unsigned int worker)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        Job *previous = currentJob();
+        currentJob() = job;
+        job->function(*job);
+        currentJob() = previous;
+        finish(job);
+        workers[worker].busyNs.fetch_add((unsigned long long)std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start).count(),
+                                         std::memory_order_relaxed);
+        workers[worker].executed.fetch_add(1, std::memory_order_relaxed);
+    }
+    // ------------------------------------------------------------------------
+    void finish(Job *job)
+    {
+        if (job->unfinished.fetch_sub(1, std::memory_order_acq_rel) != 1)
+            return;
+        for (unsigned int i = 0; i < job->continuationCount; i++)
+            run(job->continuations[i]);
+        if (job->parent)
+            finish(job->parent);
+    }
+    // ------------------------------------------------------------------------
+    void workerLoop(unsigned int index)
+    {
+        currentSystem() = this;
+        currentWorker() = index;
+        while (true)
+        {
+            Job *job = findJob(index);
+            if (job)
+            {
+                execute(job, index);
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            sleepingWorkers.fetch_add(1, std::memory_order_seq_cst);
+            wakeup.wait(lock, [this]() { return quit || queuedJobs.load(std::memory_order_seq_cst) > 0; });
+            sleepingWorkers.fetch_sub(1, std::memory_order_relaxed);
+            if (quit)
+                return;
+        }
+    }
+};
+#endif
@@ -0,0 +1,74 @@
+// The Calc*Light functions of the lit fragment shaders, pulled in with #include "lighting.glsl" (Shader
+// resolves it), light types and uniforms come from lights.glsl. Before the include, the shader defines the surface:
+//   SURFACE_ALBEDO    vec3 color at the fragment
+//   SURFACE_SPECULAR  specular strength at the fragment (vec3 or float)
+// MATERIAL_MAPS names the struct with the diffuse/specular samplers for SURFACE_*. Permutations (defines the
+// program is built with):
+//   NR_POINT_LIGHTS   size of the pointLights array (4 when not defined)
+//   LIGHTS_IN_BLOCK   lights and shininess come from the std140 Lighting block (LightingBlock in main.cpp)
+
+#include "lights.glsl"
+
+// calculates the color when using a directional light.
+vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
+{
+    vec3 lightDir = normalize(-light.direction);
+    // diffuse shading
+    float diff = max(dot(normal, lightDir), 0.0);
+    // specular shading
+    vec3 reflectDir = reflect(-lightDir, normal);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
+    // combine results
+    vec3 ambient = light.ambient * SURFACE_ALBEDO;
+    vec3 diffuse = light.diffuse * diff * SURFACE_ALBEDO;
+    vec3 specular = light.specular * spec * SURFACE_SPECULAR;
+    return (ambient + diffuse + specular);
+}
+
+// calculates the color when using a point light.
+vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
+{
+    vec3 lightDir = normalize(light.position - fragPos);
+    // diffuse shading
+    float diff = max(dot(normal, lightDir), 0.0);
+    // specular shading
+    vec3 reflectDir = reflect(-lightDir, normal);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
+    // attenuation
+    float distance = length(light.position - fragPos);
+    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+    // combine results
+    vec3 ambient = light.ambient * SURFACE_ALBEDO;
+    vec3 diffuse = light.diffuse * diff * SURFACE_ALBEDO;
+    vec3 specular = light.specular * spec * SURFACE_SPECULAR;
+    ambient *= attenuation;
+    diffuse *= attenuation;
+    specular *= attenuation;
+    return (ambient + diffuse + specular);
+}
+
+// calculates the color when using a spot light.
+vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
+{
+    vec3 lightDir = normalize(light.position - fragPos);
+    // diffuse shading
+    float diff = max(dot(normal, lightDir), 0.0);
+    // specular shading
+    vec3 reflectDir = reflect(-lightDir, normal);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
+    // attenuation
+    float distance = length(light.position - fragPos);
+    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+    // spotlight intensity
+    float theta = dot(lightDir, normalize(-light.direction));
+    float epsilon = light.cutOff - light.outerCutOff;
+    float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
+    // combine results
+    vec3 ambient = light.ambient * SURFACE_ALBEDO;
+    vec3 diffuse = light.diffuse * diff * SURFACE_ALBEDO;
+    vec3 specular = light.specular * spec * SURFACE_SPECULAR;
+    ambient *= attenuation * intensity;
+    diffuse *= attenuation * intensity;
+    specular *= attenuation * intensity;
+    return (ambient + diffuse + specular);
+}
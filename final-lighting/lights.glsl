@@ -0,0 +1,77 @@
+// Light types and their uniforms, shared by every stage that reads them (a uniform block has to be declared
+// the same way in each stage of a program). lighting.glsl includes it for the fragment shaders; the
+// permutations are described there.
+
+#ifndef NR_POINT_LIGHTS
+#define NR_POINT_LIGHTS 4
+#endif
+
+struct DirLight {
+    vec3 direction;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+struct PointLight {
+    vec3 position;
+
+    float constant;
+    float linear;
+    float quadratic;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+struct SpotLight {
+    vec3 position;
+    vec3 direction;
+    float cutOff;
+    float outerCutOff;
+
+    float constant;
+    float linear;
+    float quadratic;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+#ifdef LIGHTS_IN_BLOCK
+// the samplers of Material stay plain uniforms, opaque types cannot live in a uniform block
+struct MaterialMaps {
+    sampler2D diffuse;
+    sampler2D specular;
+};
+
+struct Material {
+    float shininess;
+};
+
+layout (std140) uniform Lighting {
+    vec3 viewPos;
+    Material material;
+    DirLight dirLight;
+    PointLight pointLights[NR_POINT_LIGHTS];
+    SpotLight spotLight;
+};
+uniform MaterialMaps materialMaps;
+#define MATERIAL_MAPS materialMaps
+#else
+struct Material {
+    sampler2D diffuse;
+    sampler2D specular;
+    float shininess;
+};
+
+uniform vec3 viewPos;
+uniform DirLight dirLight;
+uniform PointLight pointLights[NR_POINT_LIGHTS];
+uniform SpotLight spotLight;
+uniform Material material;
+#define MATERIAL_MAPS material
+#endif
@@ -1,6 +1,7 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include "shader_s.h"
+#include "shader_cache.h"
 #include <iostream>
 #include <glm.hpp>
 #include <gtc/matrix_transform.hpp>
@@ -9,13 +10,59 @@
 #include "stb_image.h"
 #include <vector>
 #include "camera.h"
+#include "mesh_pool.h"
+#include "mesh_lod.h"
+#include "mesh_cache.h"
+#include "static_batch.h"
+#include "impostor.h"
+#include "pipeline_stats.h"
+#include "scene_bvh.h"
+#include "compute_shader.h"
+#include "gpu_cull.h"
+#include "occlusion_culler.h"
+#include "occlusion_queries.h"
+#include "render_queue.h"
+#include "gl_state.h"
+#include "spsc_queue.h"
+#include "job_system.h"
+#include "transform_store.h"
+#include "ecs.h"
+#include "scene_graph.h"
+#include "frame_arena.h"
+#include "glsl_layout.h"
+#define ALLOCATION_COUNTER_IMPLEMENTATION
+#include "allocation_counter.h"
+
+#include <atomic>
+#include <cstring>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 
 //--------------------------------------------------------------------------------------------------
 // Callback functions
+struct FrameState;
 void framebuffer_size_callback(GLFWwindow *window, int width, int height);
 void mouse_callback(GLFWwindow *window, double xpos, double ypos);
 void scroll_callback(GLFWwindow *window, double xoffset, double yoffset);
 void processInput(GLFWwindow *window);
+bool keyPressed(GLFWwindow *window, int key);
+struct PointLight;
+struct SpotLight;
+void setLightingUniforms(const Shader &shader, const std::vector<PointLight> &pointLights, const SpotLight &spotLight, const Camera &viewer);
+struct LightingBlock;
+void fillLightingBlock(LightingBlock &block, const std::vector<PointLight> &pointLights, const SpotLight &spotLight, const Camera &viewer);
+std::vector<BlockMember> lightingBlockMembers();
+void runVertexPathBenchmark(const Shader &vaoShader, const Shader &pullShader, unsigned int VAO, const MeshPool &meshPool, unsigned int instanceSSBO, const FrameState &frame);
+void runCullingBenchmark();
+void runOcclusionBenchmark(OcclusionCuller &culler, unsigned int cubeOccluder);
+void runGpuCullingBenchmark(const Shader &pullShader, const ComputeShader &cullShader, const MeshPool &meshPool, unsigned int cubeMesh, const FrameState &frame);
+void runRecordingBenchmark(const Shader &shader, unsigned int VAO, unsigned int texture1, unsigned int texture2);
+void runJobBenchmark();
+void runSpinBenchmark(const Shader &pullShader, const Shader &spinShader, const MeshPool &meshPool, unsigned int instanceSSBO, const FrameState &frame);
+void runTransformBenchmark();
+void runEcsBenchmark();
+void buildSphere(unsigned int stacks, unsigned int slices, std::vector<float> &vertices, std::vector<unsigned int> &indices);
 
 //--------------------------------------------------------------------------------------------------
 // window Settings
@@ -32,13 +79,436 @@ bool firstMouse = true;
 float deltaTime = 0.0f; // time between current frame and last frame
 float lastFrame = 0.0f;
 
+// Vertex Pulling Settings (P toggles, B benchmarks against the VAO path)
+const unsigned int INSTANCE_BINDING = 3; // must match 4.3.pull.vert
+const unsigned int BENCH_INSTANCES = 10000;
+const unsigned int BENCH_FRAMES = 30;
+bool pullingSupported = false;
+bool vertexPulling = false;
+bool benchmarkRequested = false;
+
+// Lights
+const unsigned int NR_POINT_LIGHTS = 4; // size of the pointLights array in the fragment shaders
+// hashed names of the pointLights[i] members, one row per array element
+struct PointLightUniforms
+{
+    UniformId position, ambient, diffuse, specular, constant, linear, quadratic;
+};
+constexpr PointLightUniforms POINT_LIGHT_UNIFORMS[] = {
+    {"pointLights[0].position"_u, "pointLights[0].ambient"_u, "pointLights[0].diffuse"_u, "pointLights[0].specular"_u, "pointLights[0].constant"_u, "pointLights[0].linear"_u, "pointLights[0].quadratic"_u},
+    {"pointLights[1].position"_u, "pointLights[1].ambient"_u, "pointLights[1].diffuse"_u, "pointLights[1].specular"_u, "pointLights[1].constant"_u, "pointLights[1].linear"_u, "pointLights[1].quadratic"_u},
+    {"pointLights[2].position"_u, "pointLights[2].ambient"_u, "pointLights[2].diffuse"_u, "pointLights[2].specular"_u, "pointLights[2].constant"_u, "pointLights[2].linear"_u, "pointLights[2].quadratic"_u},
+    {"pointLights[3].position"_u, "pointLights[3].ambient"_u, "pointLights[3].diffuse"_u, "pointLights[3].specular"_u, "pointLights[3].constant"_u, "pointLights[3].linear"_u, "pointLights[3].quadratic"_u},
+};
+static_assert(sizeof(POINT_LIGHT_UNIFORMS) / sizeof(POINT_LIGHT_UNIFORMS[0]) == NR_POINT_LIGHTS, "one row of names per point light");
+// U: the same lights as one std140 uniform block (LIGHTS_IN_BLOCK in lighting.glsl), filled by memcpy'ing a LightingBlock
+// into a mapped buffer once per frame instead of ~40 glUniform calls per program. The mirrors spell out the
+// std140 padding, the static_asserts check it against glsl_layout.h and checkUniformBlock() against the linker
+const unsigned int LIGHTING_BINDING = 0; // uniform buffer binding of the Lighting block
+struct MaterialStd140
+{
+    float shininess;
+    float padding[3];
+};
+struct DirLightStd140
+{
+    glm::vec3 direction;
+    float padding0;
+    glm::vec3 ambient;
+    float padding1;
+    glm::vec3 diffuse;
+    float padding2;
+    glm::vec3 specular;
+    float padding3;
+};
+struct PointLightStd140
+{
+    glm::vec3 position;
+    float constant; // fills the vec3's last 4 bytes
+    float linear;
+    float quadratic;
+    float padding0[2];
+    glm::vec3 ambient;
+    float padding1;
+    glm::vec3 diffuse;
+    float padding2;
+    glm::vec3 specular;
+    float padding3;
+};
+struct SpotLightStd140
+{
+    glm::vec3 position;
+    float padding0;
+    glm::vec3 direction;
+    float cutOff;
+    float outerCutOff;
+    float constant;
+    float linear;
+    float quadratic;
+    glm::vec3 ambient;
+    float padding1;
+    glm::vec3 diffuse;
+    float padding2;
+    glm::vec3 specular;
+    float padding3;
+};
+struct LightingBlock
+{
+    glm::vec3 viewPos;
+    float padding;
+    MaterialStd140 material;
+    DirLightStd140 dirLight;
+    PointLightStd140 pointLights[NR_POINT_LIGHTS];
+    SpotLightStd140 spotLight;
+};
+using MaterialGlsl = GlslStruct<GlslLayout::Std140, float>;
+using DirLightGlsl = GlslStruct<GlslLayout::Std140, glm::vec3, glm::vec3, glm::vec3, glm::vec3>;
+using PointLightGlsl = GlslStruct<GlslLayout::Std140, glm::vec3, float, float, float, glm::vec3, glm::vec3, glm::vec3>;
+using SpotLightGlsl = GlslStruct<GlslLayout::Std140, glm::vec3, glm::vec3, float, float, float, float, float, glm::vec3, glm::vec3, glm::vec3>;
+using LightingBlockGlsl = GlslStruct<GlslLayout::Std140, glm::vec3, MaterialGlsl, DirLightGlsl, GlslArray<PointLightGlsl, NR_POINT_LIGHTS>, SpotLightGlsl>;
+static_assert(MaterialGlsl::matches({offsetof(MaterialStd140, shininess)}, sizeof(MaterialStd140)), "MaterialStd140 does not match Material");
+static_assert(DirLightGlsl::matches({offsetof(DirLightStd140, direction), offsetof(DirLightStd140, ambient), offsetof(DirLightStd140, diffuse), offsetof(DirLightStd140, specular)},
+                                    sizeof(DirLightStd140)),
+              "DirLightStd140 does not match DirLight");
+static_assert(PointLightGlsl::matches({offsetof(PointLightStd140, position), offsetof(PointLightStd140, constant), offsetof(PointLightStd140, linear), offsetof(PointLightStd140, quadratic),
+                                       offsetof(PointLightStd140, ambient), offsetof(PointLightStd140, diffuse), offsetof(PointLightStd140, specular)},
+                                      sizeof(PointLightStd140)),
+              "PointLightStd140 does not match PointLight");
+static_assert(SpotLightGlsl::matches({offsetof(SpotLightStd140, position), offsetof(SpotLightStd140, direction), offsetof(SpotLightStd140, cutOff), offsetof(SpotLightStd140, outerCutOff),
+                                      offsetof(SpotLightStd140, constant), offsetof(SpotLightStd140, linear), offsetof(SpotLightStd140, quadratic), offsetof(SpotLightStd140, ambient),
+                                      offsetof(SpotLightStd140, diffuse), offsetof(SpotLightStd140, specular)},
+                                     sizeof(SpotLightStd140)),
+              "SpotLightStd140 does not match SpotLight");
+static_assert(LightingBlockGlsl::matches({offsetof(LightingBlock, viewPos), offsetof(LightingBlock, material), offsetof(LightingBlock, dirLight), offsetof(LightingBlock, pointLights),
+                                          offsetof(LightingBlock, spotLight)},
+                                         sizeof(LightingBlock)),
+              "LightingBlock does not match the Lighting block");
+// the programs that shade with the lights, once with plain uniforms and once with the Lighting block
+struct LitPrograms
+{
+    const Shader *vao, *pull, *spin, *impostor;
+};
+bool lightingBlock = false;
+bool lightingLayoutMatches = false; // every block program's Lighting block agrees with LightingBlock, U needs it
+
+// Static Batching Settings
+const unsigned int LAMP_MATERIAL = 0;
+const float STATIC_CHUNK_SIZE = 8.0f; // world units per culling chunk
+
+// LOD Settings (L toggles), a row of dense spheres going into the distance
+const unsigned int NR_LOD_SPHERES = 24;
+const unsigned int NR_LOD_LEVELS = 5;
+const float LOD_PIXEL_ERROR = 1.0f; // allowed screen-space error in pixels
+const float LOD_HYSTERESIS = 0.25f;
+const unsigned int INSTANCE_CAPACITY = 10 + NR_LOD_SPHERES;
+// imported model for the LOD row (OBJ or glTF), a binary .meshcache is written next to it on first load
+const char *MODEL_PATH = "models/torus_knot.obj";
+bool lodEnabled = true;
+
+// Impostor Settings (I toggles, [ and ] move the cut-over), row objects further away than
+// impostorDistance are drawn as octahedral impostor quads instead of meshes
+const float IMPOSTOR_DISTANCE_STEP = 5.0f;
+float impostorDistance = 25.0f;
+bool impostorsEnabled = true;
+
+// Frustum Culling Settings (C toggles, V benchmarks the BVH on a million boxes)
+const unsigned int CULL_BENCH_OBJECTS = 1000000;
+const unsigned int CULL_BENCH_FRAMES = 20;
+const glm::vec3 CUBE_MIN(-0.5f), CUBE_MAX(0.5f); // box of the cube mesh
+bool cullingEnabled = true;
+bool cullBenchmarkRequested = false;
+// G compares CPU culling + upload against the compute shader pass with indirect draws
+const unsigned int GPU_CULL_INSTANCES = 200000;
+bool gpuCullBenchmarkRequested = false;
+
+// GPU Animation Settings (M toggles, K benchmarks a million spinning cubes): the cubes spin in 4.3.spin.vert
+// from static per-instance parameters instead of matrices rebuilt and uploaded every frame
+const unsigned int SPIN_BINDING = 6; // must match 4.3.spin.vert
+const unsigned int SPIN_BENCH_INSTANCES = 1000000;
+const unsigned int SPIN_BENCH_FRAMES = 3;
+// std430 layout of SpinInstance in 4.3.spin.vert
+struct SpinInstance
+{
+    glm::vec4 positionScale; // xyz position, w uniform scale
+    glm::vec4 axisSpeed;     // xyz unit axis, w radians per second
+    float phase;             // radians at time 0
+    float padding[3];
+};
+static_assert(GlslStruct<GlslLayout::Std430, glm::vec4, glm::vec4, float>::matches({offsetof(SpinInstance, positionScale), offsetof(SpinInstance, axisSpeed), offsetof(SpinInstance, phase)}, sizeof(SpinInstance)),
+              "SpinInstance does not match std430 SpinInstance in 4.3.spin.vert");
+bool gpuAnimation = false;
+bool spinLayoutMatches = false; // every program with the SpinInstances block agrees with SpinInstance, M and K need it
+bool spinBenchmarkRequested = false;
+
+// Occlusion Culling Settings (O toggles, H benchmarks a dense cube field), the cubes are the occluders
+const unsigned int OCCLUSION_FIELD_SIDE = 32; // H: 32^3 cubes
+bool occlusionEnabled = true;
+bool occlusionBenchmarkRequested = false;
+// Q: hardware occlusion queries + conditional rendering for the row objects (the expensive ones)
+bool queryOcclusionEnabled = false;
+// Z: depth pre-pass, opaque meshes are laid down depth-only first and shaded with GL_EQUAL afterwards
+bool depthPrepass = false;
+// R: parallel command recording benchmark, 100k objects culled and recorded into per-thread CommandBuffers
+const unsigned int RECORD_BENCH_OBJECTS = 100000;
+const unsigned int RECORD_BENCH_FRAMES = 10;
+bool recordBenchmarkRequested = false;
+// J: job system scaling benchmark, transforms + culling of 100k objects and point lights binned into screen tiles
+const unsigned int JOB_BENCH_OBJECTS = 100000;
+const unsigned int JOB_BENCH_LIGHTS = 1024;
+const unsigned int JOB_BENCH_FRAMES = 20;
+const unsigned int LIGHT_TILE_SIZE = 64;     // pixels
+const unsigned int MAX_LIGHTS_PER_TILE = 128;
+bool jobBenchmarkRequested = false;
+// T: world matrices per second, glm per object vs the SoA kernel of transform_store.h
+const unsigned int TRANSFORM_BENCH_OBJECTS = 100000;
+const unsigned int TRANSFORM_BENCH_FRAMES = 20;
+bool transformBenchmarkRequested = false;
+// E: entity queries of the ECS vs the same objects behind pointers
+const unsigned int ECS_BENCH_ENTITIES = 300000;
+const unsigned int ECS_BENCH_FRAMES = 20;
+bool ecsBenchmarkRequested = false;
+
+// Heap allocations (allocation_counter.h): past the warm-up a frame, simulation and submission, must not allocate;
+// per-frame scratch goes into a FrameArena instead
+const unsigned int ALLOCATION_WARMUP_FRAMES = 60;
+// --check-allocations: hidden window, this many frames after the warm-up, exit code 1 if any of them allocated
+const unsigned int ALLOCATION_CHECK_FRAMES = 120;
+const unsigned int PACKET_CAPACITY = 256; // draw packets of the biggest frame (every feature on), reserved up front
+const unsigned int MODEL_CAPACITY = 64;
+// the parts of the scene whose packets are recorded in parallel, one command buffer each
+enum SceneGroup
+{
+    SCENE_GROUP_CUBES,
+    SCENE_GROUP_ROW,
+    SCENE_GROUP_LAMPS,
+    SCENE_GROUP_COUNT
+};
+
+// render thread: the main thread polls events and simulates frame N+1 while the render thread, which owns
+// the GL context, submits frame N. Commands go through a lock-free SPSC queue, frame data through
+// FRAMES_IN_FLIGHT FrameStates that the main thread only reuses once framesRendered has passed them.
+// Neither thread spins: an empty queue or a busy frame slot is waited for on a condition variable, on a
+// software rasterizer the cores a spinning thread burns are the ones the driver renders with
+enum RenderCommandType
+{
+    RENDER_FRAME,              // submit and swap frames[frame]
+    RENDER_RESIZE,             // new framebuffer size
+    RENDER_VERTEX_BENCHMARK,   // B, with the view of frames[frame]
+    RENDER_GPU_CULL_BENCHMARK, // G, with the view of frames[frame]
+    RENDER_SPIN_BENCHMARK,     // K, with the view of frames[frame]
+    RENDER_QUIT
+};
+struct RenderCommand
+{
+    RenderCommandType type;
+    unsigned int frame;
+    int width, height;
+};
+const unsigned int FRAMES_IN_FLIGHT = 2;
+SpscQueue<RenderCommand, 64> renderCommands;
+std::atomic<unsigned int> framesRendered{0};
+std::mutex renderSignalMutex;
+std::condition_variable renderCommandPushed;  // main thread -> render thread
+std::condition_variable renderThreadProgress; // render thread -> main thread: a command popped or a frame done
+
+// the queue and the counter stay lock-free, the mutex only orders a notify after the waiter's check of its
+// condition, so no wakeup is lost
+// ------------------------------------------------------------------------
+void notifyRenderSignal(std::condition_variable &signal)
+{
+    {
+        std::lock_guard<std::mutex> lock(renderSignalMutex);
+    }
+    signal.notify_one();
+}
+// ------------------------------------------------------------------------
+void pushRenderCommand(const RenderCommand &command)
+{
+    if (!renderCommands.push(command))
+    {
+        std::unique_lock<std::mutex> lock(renderSignalMutex);
+        renderThreadProgress.wait(lock, [&]() { return renderCommands.push(command); });
+    }
+    notifyRenderSignal(renderCommandPushed);
+}
+
+// Scene entities (ecs.h): the cubes are Transform + Spin + MeshRenderer, the row objects Transform +
+// MeshRenderer + SceneNode, the lamps Transform + PointLight + SceneNode, the flashlight SpotLight + SceneNode
+struct Transform
+{
+    glm::vec3 position = glm::vec3(0.0f);
+    glm::quat rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+    glm::vec3 scale = glm::vec3(1.0f);
+};
+struct Spin
+{
+    glm::vec3 axis; // unit length
+    float degreesPerSecond;
+    float phase = 0.0f; // degrees at time 0
+};
+struct MeshRenderer
+{
+    unsigned int object; // id in the scene BVH and the visibility lists: cubes 0-9, row objects 10+
+};
+struct SceneNode
+{
+    unsigned int node; // in the transform hierarchy (scene_graph.h), which owns the world matrix
+};
+struct PointLight
+{
+    glm::vec3 position; // from the scene node when the frame is handed to the render thread
+    glm::vec3 ambient, diffuse, specular;
+    float constant, linear, quadratic;
+};
+struct SpotLight
+{
+    glm::vec3 position, direction; // from the scene node, the light shines down its -Z
+    glm::vec3 ambient, diffuse, specular;
+    float constant, linear, quadratic;
+    float cutOff, outerCutOff; // cosines
+};
+
+// everything the render thread needs from one simulated frame: camera, settings, the instance matrices,
+// the recorded draw packets and the numbers for the per-second report
+struct FrameState
+{
+    float time = 0.0f;
+    Camera camera;
+    glm::mat4 view, projection;
+    bool vertexPulling, queryOcclusionEnabled, depthPrepass, cullingEnabled, occlusionEnabled, gpuAnimation, lightingBlock;
+    std::vector<PointLight> pointLights;
+    SpotLight spotLight;
+    unsigned int transformsRecomputed = 0, transformNodes = 0;
+
+    std::vector<glm::mat4> instanceModels; // cubes, then the LOD groups, then the impostors
+    unsigned int impostorCount = 0;
+    std::vector<char> objectVisible, sphereImpostor;
+    std::vector<glm::vec3> objectMin, objectMax;
+    CommandBuffer commands; // every packet except the query boxes, which need the render thread's query state
+
+    unsigned int lodTriangles = 0, fullTriangles = 0, nodesTested = 0;
+    unsigned int occludersUsed = 0, trianglesRasterized = 0, objectsTested = 0, objectsOccluded = 0, occlusionThreads = 0;
+    double rasterMs = 0.0, testMs = 0.0, simulationMs = 0.0, waitMs = 0.0;
+    std::vector<float> workerUtilization; // job system, sampled once a second
+    unsigned long long jobsExecuted = 0, jobsStolen = 0;
+    unsigned long long simulationAllocations = 0; // heap allocations of the main thread while simulating it
+    size_t arenaUsed = 0, arenaCapacity = 0;
+};
+
+// GL objects and programs main() sets up once and both threads use: the simulation puts them into draw
+// packets as handles, the render thread binds them
+struct SceneResources
+{
+    GLFWwindow *window = NULL;
+    const Shader *ourCube = NULL, *ourLight = NULL, *ourDepth = NULL;
+    const Shader *ourCubePull = NULL, *ourDepthPull = NULL, *ourSpin = NULL, *ourDepthSpin = NULL; // 4.3 only
+    ComputeShader *cullCompute = NULL;
+    LitPrograms uniformLit = {}, blockLit = {};
+    unsigned int VAO = 0, lightVAO = 0, texture1 = 0, texture2 = 0;
+    unsigned int lightingUBO = 0, instanceSSBO = 0, spinSSBO = 0;
+    const MeshPool *meshPool = NULL;
+    unsigned int cubeMesh = 0;
+    const ImpostorAtlas *rowImpostor = NULL;
+};
+
+// Render thread - owns the GL context while run() pops commands: a RENDER_FRAME builds the render queue
+// from the frame's packets, submits it and swaps. Keeps what lives from frame to frame on this side: the
+// row's occlusion queries, the scene's gpu queries and the numbers of the per-second report
+struct FrameRenderer : SceneResources
+{
+    unsigned long long steadyAllocations = 0; // after the warm-up, for --check-allocations
+
+    void init(const SceneResources &resources);
+    void run(FrameState *frames);
+    void release();
+
+private:
+    OcclusionQueries rowQueries; // one per row object
+    PipelineStatsQuery sceneStats;
+    GpuTimer sceneTimer; // everything the render queue submits, to compare with and without the depth pre-pass
+    RenderQueue renderQueue;
+    LightingBlock lightingData = {}; // staging copy of the Lighting block, padding stays zero
+    float lastLodReport = 0.0f;
+    unsigned int reportFrames = 0; // frames the gl state counters were summed over
+    unsigned long long simulationAllocations = 0, submissionAllocations = 0; // since the last report
+    double submitMs = 0.0; // cpu time of the render queue submissions since the last report
+    unsigned int submitFrames = 0;
+    double renderMs = 0.0; // cpu time of the last frame's packet building and submit
+
+    void renderFrame(const FrameState &frame);
+    void printReport(const FrameState &frame);
+    void buildQueue(const FrameState &frame);
+    void setFrameUniforms(const FrameState &frame, const LitPrograms &lit);
+};
+
+// Simulation - step() turns the scene into one FrameState on the main thread: transforms, frustum and
+// occlusion culling, LOD selection and the draw packets, recorded without GL. Owns the scene and
+// everything that carries over from frame to frame; main() sets it up in place
+struct Simulation : SceneResources
+{
+    World scene;
+    TransformHierarchy sceneGraph;
+    unsigned int cameraNode = 0;
+    glm::mat4 cameraView = glm::mat4(1.0f);
+    TransformStore cubeTransforms; // position/rotation/scale of the cubes, SoA, composed into their world matrices every frame
+    std::vector<glm::vec3> objectMin, objectMax; // world boxes, cubes 0-9 and row objects 10+
+    std::vector<glm::vec3> spinMin, spinMax, spinOccluderMin, spinOccluderMax; // boxes of the cubes spinning on the gpu
+    std::vector<glm::mat4> spinOccluderModels;
+    SceneBvh sceneBvh;
+    JobSystem jobSystem; // worker 0 is the main thread
+    OcclusionCuller occlusionCuller;
+    unsigned int cubeOccluder = 0;
+    FrameArena frameArena; // scratch of the frame being simulated, reset at the start of every step
+    StaticBatcher staticBatcher;
+    LodChain rowLods;
+    float rowScale = 1.0f;
+    std::vector<glm::vec3> spherePositions;
+    std::vector<glm::mat4> sphereModels; // the row never moves
+
+    void init(const SceneResources &resources);
+    void step(FrameState &frame, float time);
+
+private:
+    bool cubesSpinOnGpu = false; // the BVH holds the swept boxes
+    std::vector<unsigned int> visibleObjects;
+    std::vector<char> objectVisible;
+    std::vector<unsigned int> sphereLevel, sphereInstance;
+    // LOD selection of the frame being simulated, the packets are recorded from it
+    unsigned int visibleCubes = 0;
+    unsigned int levelFirst[NR_LOD_LEVELS] = {0}, levelCount[NR_LOD_LEVELS] = {0};
+    unsigned int impostorFirst = 0;
+    std::vector<StaticRun> lampRuns;
+    std::vector<CommandBuffer> sceneCommands; // recorded in parallel, appended to the frame's buffer
+    std::vector<float> workerUtilization; // job system, sampled once a second
+    unsigned long long jobsExecuted = 0, jobsStolen = 0;
+    float lastJobSample = 0.0f;
+
+    void updateTransforms(FrameState &frame);
+    void cull(FrameState &frame);
+    void selectLods(FrameState &frame);
+    void recordPackets(FrameState &frame);
+    void recordCubes(const FrameState &frame, CommandBuffer &commands);
+    void recordRow(const FrameState &frame, CommandBuffer &commands);
+    void recordLamps(const FrameState &frame, CommandBuffer &commands);
+};
+
 //--------------------------------------------------------------------------------------------------
-int main()
+int main(int argc, char **argv)
 {
+    bool checkAllocations = false;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--check-allocations") == 0)
+            checkAllocations = true;
+    }
+
     //--------------------------------------------------------------------------------------------------
     // Initialize GLFW
+    // ask for 4.3 (SSBOs for vertex pulling), fall back to 3.3 and the plain VAO path
     glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    if (checkAllocations)
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
@@ -46,6 +516,12 @@ int main()
     // Create a GLFW window
     GLFWwindow *window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Arnav's World", NULL, NULL);
     if (window == NULL)
+    {
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Arnav's World", NULL, NULL);
+    }
+    if (window == NULL)
     {
         std::cout << "Failed to create GLFW window" << std::endl;
         glfwTerminate();
@@ -65,13 +541,55 @@ int main()
         return -1;
     }
 
-    glEnable(GL_DEPTH_TEST); // Enable depth testing for 3D rendering
+    glState().setEnabled(GL_DEPTH_TEST, true); // Enable depth testing for 3D rendering
+    pullingSupported = GLAD_GL_VERSION_4_3;
 
     //--------------------------------------------------------------------------------------------------
     // building and compiling our shaders
-    Shader ourCube("3.3.shader.vert", "3.3.shader.frag");
-    Shader ourLight("1.light_cube.vert", "1.light_cube.frag");
-
+    // every program comes from the cache, which only starts the compiles: they run while the meshes load and
+    // the textures decode, the programs are waited for where they are first used (after the textures).
+    // The lit programs are permutations of sources that include lighting.glsl: lights as plain uniforms, and
+    // again with the lights in a uniform block (U)
+    auto shadersStart = std::chrono::high_resolution_clock::now();
+    ShaderCache shaderCache;
+    shaderCache.init(window);
+    const ShaderDefines uniformLights = {{"NR_POINT_LIGHTS", std::to_string(NR_POINT_LIGHTS)}};
+    const ShaderDefines blockLights = {{"NR_POINT_LIGHTS", std::to_string(NR_POINT_LIGHTS)}, {"LIGHTS_IN_BLOCK", ""}};
+    const Shader &ourCube = shaderCache.get("3.3.shader.vert", "3.3.shader.frag", uniformLights);
+    const Shader &ourLight = shaderCache.get("1.light_cube.vert", "1.light_cube.frag");
+    // depth pre-pass programs, vertex stage only
+    const Shader &ourDepth = shaderCache.get("3.3.depth.vert");
+    const Shader *ourDepthPull = NULL;
+    // same fragment shader, attributes pulled from SSBOs (only built on a 4.3 context)
+    const Shader *ourCubePull = NULL;
+    // impostors: baker writes the atlas, the other draws the far row as quads
+    const Shader *impostorBake = NULL;
+    const Shader *ourImpostor = NULL;
+    // cubes animated in the vertex shader (M)
+    const Shader *ourSpin = NULL;
+    const Shader *ourDepthSpin = NULL;
+    const Shader &ourCubeBlock = shaderCache.get("3.3.shader.vert", "3.3.shader.frag", blockLights);
+    const Shader *ourCubePullBlock = NULL;
+    const Shader *ourSpinBlock = NULL;
+    const Shader *ourImpostorBlock = NULL;
+    ComputeShader *cullCompute = NULL;
+    if (pullingSupported)
+    {
+        ourCubePull = &shaderCache.get("4.3.pull.vert", "3.3.shader.frag", uniformLights);
+        impostorBake = &shaderCache.get("4.3.impostor_bake.vert", "4.3.impostor_bake.frag");
+        ourImpostor = &shaderCache.get("4.3.impostor.vert", "4.3.impostor.frag", uniformLights);
+        cullCompute = new ComputeShader("4.3.cull.comp");
+        ourDepthPull = &shaderCache.get("4.3.depth_pull.vert");
+        ourSpin = &shaderCache.get("4.3.spin.vert", "3.3.shader.frag", uniformLights);
+        ourDepthSpin = &shaderCache.get("4.3.depth_spin.vert");
+        ourCubePullBlock = &shaderCache.get("4.3.pull.vert", "3.3.shader.frag", blockLights);
+        ourSpinBlock = &shaderCache.get("4.3.spin.vert", "3.3.shader.frag", blockLights);
+        ourImpostorBlock = &shaderCache.get("4.3.impostor.vert", "4.3.impostor.frag", blockLights);
+    }
+    else
+    {
+        std::cout << "OpenGL 4.3 not available, vertex pulling disabled" << std::endl;
+    }
     //--------------------------------------------------------------------------------------------------
     // Vertex data for a cube
     float my_vertices[] = {
@@ -143,9 +661,9 @@ int main()
     glGenVertexArrays(1, &VAO);
     glGenBuffers(1, &VBO);
 
-    glBindVertexArray(VAO); // lets bind vao first then vbo
+    glState().bindVertexArray(VAO); // lets bind vao first then vbo
 
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glState().bindBuffer(GL_ARRAY_BUFFER, VBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(my_vertices), my_vertices, GL_STATIC_DRAW);
 
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *)0); // Position attribute
@@ -157,25 +675,187 @@ int main()
     glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *)(6 * sizeof(float))); // Texture attribute
     glEnableVertexAttribArray(2);                                                                    // ACTIVATE texture
 
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+    glState().bindBuffer(GL_ARRAY_BUFFER, 0);
+    glState().bindVertexArray(0);
 
     //--------------------------------------------------------------------------------------------------
     // Light VAO (Same VBO Data) - Light Source 1
     unsigned int lightVAO;
     glGenVertexArrays(1, &lightVAO);
-    glBindVertexArray(lightVAO);
+    glState().bindVertexArray(lightVAO);
 
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glState().bindBuffer(GL_ARRAY_BUFFER, VBO);
 
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *)0);
     glEnableVertexAttribArray(0);
 
+    //--------------------------------------------------------------------------------------------------
+    // Vertex pulling - the same cube goes into the mesh pool, model matrices go into an instance SSBO
+    // so the cube loop below becomes a single instanced draw
+    MeshPool meshPool;
+    unsigned int cubeMesh = meshPool.addMesh(my_vertices, 36, 8, 0, 3, 6);
+    std::vector<glm::mat4> instanceModels(INSTANCE_CAPACITY);
+    unsigned int instanceSSBO = 0;
+    unsigned int spinSSBO = 0; // static spin parameters of the cubes (M)
+
+    // LOD spheres - 9k triangles each, simplified into NR_LOD_LEVELS levels that share the sphere's vertices
+    std::vector<float> sphereVertices;
+    std::vector<unsigned int> sphereIndices;
+    buildSphere(48, 96, sphereVertices, sphereIndices);
+    unsigned int sphereMesh = meshPool.addMesh(sphereVertices.data(), (unsigned int)sphereVertices.size() / 8, 8, 0, 3, 6,
+                                               sphereIndices.data(), (unsigned int)sphereIndices.size());
+    LodChain sphereLods = generateLods(meshPool, sphereMesh, NR_LOD_LEVELS);
+    // a real model takes the spheres' place when it loads, scaled down to fit the same unit box
+    LodChain modelLods;
+    glm::vec3 modelMin, modelMax;
+    bool modelLoaded = loadMesh(MODEL_PATH, meshPool, modelLods, modelMin, modelMax, NR_LOD_LEVELS);
+    const LodChain &rowLods = modelLoaded ? modelLods : sphereLods;
+    glm::vec3 modelSize = modelMax - modelMin;
+    float rowScale = modelLoaded ? 1.0f / std::max(modelSize.x, std::max(modelSize.y, modelSize.z)) : 1.0f;
+    glm::vec3 rowCenter = modelLoaded ? (modelMin + modelMax) * 0.5f : glm::vec3(0.0f);
+    for (unsigned int i = 0; i < rowLods.levels.size(); i++)
+        std::cout << "LOD " << i << ": " << rowLods.levels[i].triangleCount << " triangles, error " << rowLods.levels[i].error << std::endl;
+    // the simulation owns the scene and everything it carries from frame to frame, set up in place below
+    Simulation simulation;
+    simulation.rowLods = rowLods;
+    simulation.rowScale = rowScale;
+    std::vector<glm::vec3> &spherePositions = simulation.spherePositions;
+    spherePositions.resize(NR_LOD_SPHERES);
+    for (unsigned int i = 0; i < NR_LOD_SPHERES; i++)
+        spherePositions[i] = glm::vec3((i % 2) ? 3.5f : -3.5f, -1.5f, -2.0f - 3.5f * i);
+
+    //--------------------------------------------------------------------------------------------------
+    // Scene entities - the arrays above only seed the world, systems query it from here on. Everything
+    // but the spinning cubes hangs in the transform hierarchy: the flashlight under the camera, the row
+    // and the lamps under one static group each, so after the first update only the camera's subtree
+    // is recomputed, and only on frames where the camera moved
+    World &scene = simulation.scene;
+    TransformHierarchy &sceneGraph = simulation.sceneGraph;
+    const glm::vec3 cubeAxis = glm::normalize(glm::vec3(1.0f, 0.3f, 0.5f));
+    for (unsigned int i = 0; i < 10; i++)
+        scene.create(Transform{cubePositions[i]}, Spin{cubeAxis, 100.0f}, MeshRenderer{i});
+    glm::mat4 &cameraView = simulation.cameraView;
+    unsigned int &cameraNode = simulation.cameraNode;
+    cameraView = camera.GetViewMatrix();
+    cameraNode = sceneGraph.add(glm::inverse(cameraView));
+    SpotLight flashlight{glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(1.0f), glm::vec3(1.0f), 1.0f, 0.09f, 0.032f,
+                         glm::cos(glm::radians(12.5f)), glm::cos(glm::radians(15.0f))};
+    scene.create(flashlight, SceneNode{sceneGraph.add(glm::mat4(1.0f), cameraNode)});
+    unsigned int rowNode = sceneGraph.add(glm::mat4(1.0f));
+    for (unsigned int i = 0; i < NR_LOD_SPHERES; i++)
+    {
+        Transform transform{spherePositions[i], glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(rowScale)};
+        glm::mat4 local = glm::scale(glm::translate(glm::mat4(1.0f), transform.position), transform.scale);
+        scene.create(transform, MeshRenderer{10 + i}, SceneNode{sceneGraph.add(local, rowNode)});
+    }
+    unsigned int lampNode = sceneGraph.add(glm::mat4(1.0f));
+    for (unsigned int i = 0; i < 4; i++)
+    {
+        Transform transform{pointLightPositions[i], glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(0.2f)};
+        glm::mat4 local = glm::scale(glm::translate(glm::mat4(1.0f), transform.position), transform.scale);
+        PointLight light{glm::vec3(0.0f), glm::vec3(0.05f), glm::vec3(0.8f), glm::vec3(1.0f), 1.0f, 0.09f, 0.032f};
+        scene.create(transform, light, SceneNode{sceneGraph.add(local, lampNode)});
+    }
+    sceneGraph.update();
+    std::cout << "scene: " << scene.entityCount() << " entities, " << scene.archetypeCount() << " archetypes, " << scene.chunkCount() << " chunk(s), "
+              << sceneGraph.size() << " hierarchy nodes" << std::endl;
+    // the row never moves, its model matrices are fixed (the mesh is centered before the transform)
+    std::vector<glm::mat4> &sphereModels = simulation.sphereModels;
+    sphereModels.resize(NR_LOD_SPHERES);
+    scene.each<MeshRenderer, SceneNode>([&](Entity, const MeshRenderer &renderer, const SceneNode &node)
+                                        { sphereModels[renderer.object - 10] = glm::translate(sceneGraph.world(node.node), -rowCenter); });
+    ImpostorAtlas rowImpostor;
+
+    if (pullingSupported)
+    {
+        meshPool.upload();
+        glGenBuffers(1, &instanceSSBO);
+        glState().bindBuffer(GL_SHADER_STORAGE_BUFFER, instanceSSBO);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, instanceModels.size() * sizeof(glm::mat4), NULL, GL_DYNAMIC_DRAW);
+        // written once, the vertex shader animates the cubes from it
+        std::vector<SpinInstance> spins(10);
+        scene.each<Transform, Spin, MeshRenderer>([&](Entity, const Transform &transform, const Spin &spin, const MeshRenderer &renderer)
+                                                  {
+                                                      SpinInstance &instance = spins[renderer.object];
+                                                      instance.positionScale = glm::vec4(transform.position, transform.scale.x);
+                                                      instance.axisSpeed = glm::vec4(spin.axis, glm::radians(spin.degreesPerSecond));
+                                                      instance.phase = glm::radians(spin.phase);
+                                                  });
+        glGenBuffers(1, &spinSSBO);
+        glState().bindBuffer(GL_SHADER_STORAGE_BUFFER, spinSSBO);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, spins.size() * sizeof(SpinInstance), spins.data(), GL_STATIC_DRAW);
+        glState().bindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+
+    //--------------------------------------------------------------------------------------------------
+    // Static batching - the light bulbs never move, so they are baked into world space once and
+    // drawn from one buffer with model = identity instead of 4 draws with their own model matrix
+    StaticBatcher &staticBatcher = simulation.staticBatcher;
+    scene.each<PointLight, SceneNode>([&](Entity, const PointLight &, const SceneNode &node)
+                                      { staticBatcher.add(my_vertices, 36, sceneGraph.world(node.node), LAMP_MATERIAL); });
+    staticBatcher.build(STATIC_CHUNK_SIZE);
+    std::cout << "static batching: " << staticBatcher.objectCount << " objects -> " << staticBatcher.batches.size()
+              << " batch(es), " << staticBatcher.chunkCount() << " chunk(s)" << std::endl;
+
+    //--------------------------------------------------------------------------------------------------
+    // Frustum culling - every cube (ids 0-9) and row object (10+) has a world-space box in the scene BVH,
+    // the cubes spin so theirs are refitted every frame
+    glm::vec3 rowMin = modelLoaded ? modelMin : glm::vec3(-0.5f);
+    glm::vec3 rowMax = modelLoaded ? modelMax : glm::vec3(0.5f);
+    std::vector<glm::vec3> &objectMin = simulation.objectMin, &objectMax = simulation.objectMax;
+    objectMin.resize(10 + NR_LOD_SPHERES);
+    objectMax.resize(10 + NR_LOD_SPHERES);
+    for (unsigned int i = 0; i < 10; i++)
+        transformBounds(glm::translate(glm::mat4(1.0f), cubePositions[i]), CUBE_MIN, CUBE_MAX, objectMin[i], objectMax[i]);
+    // position/rotation/scale of the cubes, SoA, composed into their world matrices every frame
+    TransformStore &cubeTransforms = simulation.cubeTransforms;
+    for (unsigned int i = 0; i < 10; i++)
+        cubeTransforms.add(cubePositions[i]);
+    // with the spin on the gpu (M) the cpu never sees a cube's rotation: culling uses the box around the
+    // sphere the cube sweeps, occlusion the box inside the sphere it always covers (half size 0.5 / sqrt(3))
+    std::vector<glm::vec3> &spinMin = simulation.spinMin, &spinMax = simulation.spinMax;
+    std::vector<glm::vec3> &spinOccluderMin = simulation.spinOccluderMin, &spinOccluderMax = simulation.spinOccluderMax;
+    std::vector<glm::mat4> &spinOccluderModels = simulation.spinOccluderModels;
+    for (std::vector<glm::vec3> *boxes : {&spinMin, &spinMax, &spinOccluderMin, &spinOccluderMax})
+        boxes->resize(10);
+    spinOccluderModels.resize(10);
+    scene.each<Transform, Spin, MeshRenderer>([&](Entity, const Transform &transform, const Spin &, const MeshRenderer &renderer)
+                                              {
+                                                  unsigned int i = renderer.object;
+                                                  float scale = transform.scale.x;
+                                                  spinMin[i] = transform.position - glm::vec3(0.8660254f * scale);
+                                                  spinMax[i] = transform.position + glm::vec3(0.8660254f * scale);
+                                                  spinOccluderMin[i] = transform.position - glm::vec3(0.2886751f * scale);
+                                                  spinOccluderMax[i] = transform.position + glm::vec3(0.2886751f * scale);
+                                                  spinOccluderModels[i] = glm::scale(glm::translate(glm::mat4(1.0f), transform.position), glm::vec3(0.5773503f * scale));
+                                              });
+    for (unsigned int i = 0; i < NR_LOD_SPHERES; i++)
+        transformBounds(sphereModels[i], rowMin, rowMax, objectMin[10 + i], objectMax[10 + i]);
+    simulation.sceneBvh.build(objectMin, objectMax);
+
+    // Job system - worker 0 is this (main) thread, the simulation's parallel loops and the occlusion tiles run on it
+    JobSystem &jobSystem = simulation.jobSystem;
+
+    // Occlusion culling - the cube mesh is the only occluder shape, the knots are too holey
+    OcclusionCuller &occlusionCuller = simulation.occlusionCuller;
+    occlusionCuller.jobs = &jobSystem;
+    occlusionCuller.threadCount = jobSystem.workerCount();
+    // scratch of the frame being simulated (occluder vertices, triangles and tile bins), reset at the start of every frame
+    occlusionCuller.arena = &simulation.frameArena;
+    std::vector<glm::vec3> cubeOccluderPositions;
+    std::vector<unsigned int> cubeOccluderIndices;
+    for (unsigned int i = 0; i < 36; i++)
+    {
+        cubeOccluderPositions.push_back(glm::vec3(my_vertices[i * 8], my_vertices[i * 8 + 1], my_vertices[i * 8 + 2]));
+        cubeOccluderIndices.push_back(i);
+    }
+    simulation.cubeOccluder = occlusionCuller.addOccluderMesh(cubeOccluderPositions, cubeOccluderIndices);
+
     //--------------------------------------------------------------------------------------------------
     // ----------------------Adding texture
     unsigned int texture1;
     glGenTextures(1, &texture1);
-    glBindTexture(GL_TEXTURE_2D, texture1);
+    glState().bindTexture(0, GL_TEXTURE_2D, texture1);
 
     // set the texture wrapping parameters
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
@@ -201,14 +881,10 @@ int main()
     }
     stbi_image_free(data);
 
-    // Activate shader before setting uniforms-> IMP!!!!!!!
-    ourCube.use();
-    glUniform1i(glGetUniformLocation(ourCube.ID, "material.diffuse"), 0); // setting uniforms
-
     // ---------------------- Adding Specular Texture
     unsigned int texture2;
     glGenTextures(1, &texture2);
-    glBindTexture(GL_TEXTURE_2D, texture2); // All upcoming GL_TEXTURE_2D operations now have effect on this texture object
+    glState().bindTexture(0, GL_TEXTURE_2D, texture2); // All upcoming GL_TEXTURE_2D operations now have effect on this texture object
 
     // set the texture wrapping parameters
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
@@ -232,12 +908,177 @@ int main()
     }
     stbi_image_free(data);
 
+    //--------------------------------------------------------------------------------------------------
+    // The programs have been compiling since they were asked for; whatever is not ready yet is waited for here
+    unsigned int readyBeforeWait = shaderCache.readyCount();
+    auto shaderWaitStart = std::chrono::high_resolution_clock::now();
+    shaderCache.wait();
+    if (cullCompute)
+        cullCompute->wait();
+    auto shadersEnd = std::chrono::high_resolution_clock::now();
+    std::cout << "shader cache: " << shaderCache.compiled << " program(s), " << shaderCache.mode() << ": " << readyBeforeWait
+              << " ready after the textures were decoded, waited " << std::chrono::duration<double, std::milli>(shadersEnd - shaderWaitStart).count()
+              << " ms for the rest (" << std::chrono::duration<double, std::milli>(shadersEnd - shadersStart).count() << " ms since the first compile)" << std::endl;
+    const LitPrograms uniformLit = {&ourCube, ourCubePull, ourSpin, ourImpostor};
+    const LitPrograms blockLit = {&ourCubeBlock, ourCubePullBlock, ourSpinBlock, ourImpostorBlock};
+
+    // the Lighting block of every block program reads LIGHTING_BINDING, once the linker agrees with LightingBlock
+    // on every offset; the spin SSBO is checked against SpinInstance the same way, in every program that reads it,
+    // and cube animation on the gpu stays off when one of them disagrees
+    unsigned int lightingUBO;
+    glGenBuffers(1, &lightingUBO);
+    glState().bindBuffer(GL_UNIFORM_BUFFER, lightingUBO);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(LightingBlock), NULL, GL_DYNAMIC_DRAW);
+    {
+        std::vector<BlockMember> members = lightingBlockMembers();
+        lightingLayoutMatches = true;
+        for (const Shader *program : {blockLit.vao, blockLit.pull, blockLit.spin, blockLit.impostor})
+        {
+            if (!program)
+                continue;
+            if (checkUniformBlock(program->ID, "Lighting", sizeof(LightingBlock), members))
+                glUniformBlockBinding(program->ID, glGetUniformBlockIndex(program->ID, "Lighting"), LIGHTING_BINDING);
+            else
+                lightingLayoutMatches = false;
+        }
+        if (!lightingLayoutMatches)
+            std::cout << "Lighting does not match LightingBlock, lights stay plain uniforms" << std::endl;
+        if (pullingSupported)
+        {
+            std::vector<BlockMember> spinMembers = {{"spins[0].positionScale", offsetof(SpinInstance, positionScale)},
+                                                    {"spins[0].axisSpeed", offsetof(SpinInstance, axisSpeed)},
+                                                    {"spins[0].phase", offsetof(SpinInstance, phase)}};
+            spinLayoutMatches = true;
+            for (const Shader *program : {ourSpin, ourSpinBlock, ourDepthSpin})
+                spinLayoutMatches = checkStorageBlock(program->ID, "SpinInstances", sizeof(SpinInstance), spinMembers) && spinLayoutMatches;
+            if (!spinLayoutMatches)
+                std::cout << "SpinInstances does not match SpinInstance, cube animation on the gpu disabled" << std::endl;
+        }
+    }
+
     // Activate shader before setting uniforms-> IMP!!!!!!!
-    ourCube.use();
-    glUniform1i(glGetUniformLocation(ourCube.ID, "material.specular"), 1); // setting uniforms
+    // every program that samples the crate maps reads the diffuse map from unit 0 and the specular map from unit 1
+    for (const Shader *program : {uniformLit.vao, uniformLit.pull, uniformLit.spin})
+    {
+        if (!program)
+            continue;
+        program->use();
+        program->setInt("material.diffuse", 0);
+        program->setInt("material.specular", 1);
+    }
+    for (const Shader *program : {blockLit.vao, blockLit.pull, blockLit.spin})
+    {
+        if (!program)
+            continue;
+        program->use();
+        program->setInt("materialMaps.diffuse", 0);
+        program->setInt("materialMaps.specular", 1);
+    }
+
+    //--------------------------------------------------------------------------------------------------
+    // Impostor atlas for the row model, baked once with the crate textures on units 0 and 1
+    if (pullingSupported)
+    {
+        glState().bindTexture(0, GL_TEXTURE_2D, texture1);
+        glState().bindTexture(1, GL_TEXTURE_2D, texture2);
+        impostorBake->use();
+        impostorBake->setInt("material.diffuse", 0);
+        impostorBake->setInt("material.specular", 1);
+        float rowRadius = modelLoaded ? glm::length(modelSize) * 0.5f : 0.5f;
+        rowImpostor.bake(*impostorBake, meshPool, rowLods.levels[0].mesh, rowCenter, rowRadius);
+        std::cout << "impostor atlas: " << rowImpostor.framesPerSide * rowImpostor.framesPerSide << " views of "
+                  << rowImpostor.frameSize << "px, cut-over at " << impostorDistance << " units" << std::endl;
+    }
+
+    //--------------------------------------------------------------------------------------------------
+    // Every hashed uniform the frame loop sets, set once now with placeholder values: a name a program does
+    // not have is reported at startup instead of the first time the program is drawn
+    {
+        std::vector<PointLight> placeholderLights(NR_POINT_LIGHTS);
+        SpotLight placeholderSpotLight = {};
+        std::vector<const Shader *> litPrograms = {&ourCube}, vaoPrograms = {&ourCube, &ourLight, &ourDepth, &ourCubeBlock}, poolPrograms;
+        if (pullingSupported)
+        {
+            litPrograms.insert(litPrograms.end(), {ourCubePull, ourSpin, ourImpostor});
+            poolPrograms = {ourCubePull, ourDepthPull, ourSpin, ourDepthSpin, ourImpostor, ourCubePullBlock, ourSpinBlock, ourImpostorBlock};
+        }
+        for (const Shader *program : litPrograms)
+        {
+            program->use();
+            setLightingUniforms(*program, placeholderLights, placeholderSpotLight, camera);
+        }
+        for (const Shader *program : vaoPrograms)
+        {
+            program->use();
+            program->setMat4("view"_u, glm::mat4(1.0f));
+            program->setMat4("projection"_u, glm::mat4(1.0f));
+            program->setMat4("model"_u, glm::mat4(1.0f));
+        }
+        for (const Shader *program : poolPrograms)
+        {
+            program->use();
+            program->setMat4("view"_u, glm::mat4(1.0f));
+            program->setMat4("projection"_u, glm::mat4(1.0f));
+            program->setInt("instanceOffset"_u, 0);
+            if (program == ourSpin || program == ourDepthSpin || program == ourSpinBlock)
+                program->setFloat("time"_u, 0.0f);
+        }
+        // from here on the frame's programs only upload when the render queue draws with them
+        for (const std::vector<const Shader *> *programs : {&vaoPrograms, &poolPrograms})
+        {
+            for (const Shader *program : *programs)
+                program->deferUploads(true);
+        }
+        if (pullingSupported)
+        {
+            for (const Shader *program : {ourImpostor, ourImpostorBlock})
+            {
+                program->use();
+                rowImpostor.setUniforms(*program, 2);
+            }
+        }
+    }
 
     //--------------------------------------------------------------------------------------------------
-    // Render loop
+    // Render thread - owns the GL context from here on. It pops commands, builds and submits the frame's
+    // packets from a FrameState and swaps; the main thread only touches GL again after join()
+    SceneResources resources;
+    resources.window = window;
+    resources.ourCube = &ourCube;
+    resources.ourLight = &ourLight;
+    resources.ourDepth = &ourDepth;
+    resources.ourCubePull = ourCubePull;
+    resources.ourDepthPull = ourDepthPull;
+    resources.ourSpin = ourSpin;
+    resources.ourDepthSpin = ourDepthSpin;
+    resources.cullCompute = cullCompute;
+    resources.uniformLit = uniformLit;
+    resources.blockLit = blockLit;
+    resources.VAO = VAO;
+    resources.lightVAO = lightVAO;
+    resources.texture1 = texture1;
+    resources.texture2 = texture2;
+    resources.lightingUBO = lightingUBO;
+    resources.instanceSSBO = instanceSSBO;
+    resources.spinSSBO = spinSSBO;
+    resources.meshPool = &meshPool;
+    resources.cubeMesh = cubeMesh;
+    resources.rowImpostor = &rowImpostor;
+    simulation.init(resources);
+    FrameRenderer renderer;
+    renderer.init(resources);
+    FrameState frames[FRAMES_IN_FLIGHT];
+    for (FrameState &frame : frames)
+    {
+        frame.instanceModels.resize(INSTANCE_CAPACITY);
+        frame.commands.reserve(PACKET_CAPACITY, MODEL_CAPACITY);
+    }
+    glfwMakeContextCurrent(NULL);
+    std::thread renderThread(&FrameRenderer::run, &renderer, frames);
+
+    //--------------------------------------------------------------------------------------------------
+    // Main loop - events, input and simulation of frame N+1 while the render thread submits frame N
+    unsigned int framesSimulated = 0;
     while (!glfwWindowShouldClose(window))
     {
         //--------------------------------------------------------------------------------------------------
@@ -248,149 +1089,817 @@ int main()
 
         //--------------------------------------------------------------------------------------------------
         // Input handling
-        float timeValue = sin(glfwGetTime());
-        float rBackground = sin(timeValue * 0.10);
-        float gBackground = 0.50f;
-        float bBackground = cos(timeValue * 0.10);
+        glfwPollEvents();
         processInput(window);
-        glClearColor(0.23f * sin(glfwGetTime()), 0.55f * cos(glfwGetTime()), 0.36f * sin(glfwGetTime()), 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        ;
-
-        //--------------------------------------------------------------------------------------------------
-        // Setting properties through uniforms
-
-        // texture activate
-        // bind textures on corresponding texture units
-        glActiveTexture(GL_TEXTURE0); // activate texture unit --> GL_TEXTURE0 to GL_TEXTURE15 16 Textures
-        glBindTexture(GL_TEXTURE_2D, texture1);
-
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, texture2);
-
-        // be sure to activate shader when setting uniforms/drawing objects
-        ourCube.use();
-        ourCube.setVec3("viewPos", camera.Position);
-        ourCube.setFloat("material.shininess", 32.0f);
-
-        /*
-           Here we set all the uniforms for the 5/6 types of lights we have. We have to set them manually and index
-           the proper PointLight struct in the array to set each uniform variable. This can be done more code-friendly
-           by defining light types as classes and set their values in there, or by using a more efficient uniform approach
-           by using 'Uniform buffer objects', but that is something we'll discuss in the 'Advanced GLSL' tutorial.
-        */
-        // directional light
-        ourCube.setVec3("dirLight.direction", -0.2f, -1.0f, -0.3f);
-        ourCube.setVec3("dirLight.ambient", 0.05f, 0.05f, 0.05f);
-        ourCube.setVec3("dirLight.diffuse", 0.4f, 0.4f, 0.4f);
-        ourCube.setVec3("dirLight.specular", 0.5f, 0.5f, 0.5f);
-        // point light 1
-        ourCube.setVec3("pointLights[0].position", pointLightPositions[0]);
-        ourCube.setVec3("pointLights[0].ambient", 0.05f, 0.05f, 0.05f);
-        ourCube.setVec3("pointLights[0].diffuse", 0.8f, 0.8f, 0.8f);
-        ourCube.setVec3("pointLights[0].specular", 1.0f, 1.0f, 1.0f);
-        ourCube.setFloat("pointLights[0].constant", 1.0f);
-        ourCube.setFloat("pointLights[0].linear", 0.09f);
-        ourCube.setFloat("pointLights[0].quadratic", 0.032f);
-        // point light 2
-        ourCube.setVec3("pointLights[1].position", pointLightPositions[1]);
-        ourCube.setVec3("pointLights[1].ambient", 0.05f, 0.05f, 0.05f);
-        ourCube.setVec3("pointLights[1].diffuse", 0.8f, 0.8f, 0.8f);
-        ourCube.setVec3("pointLights[1].specular", 1.0f, 1.0f, 1.0f);
-        ourCube.setFloat("pointLights[1].constant", 1.0f);
-        ourCube.setFloat("pointLights[1].linear", 0.09f);
-        ourCube.setFloat("pointLights[1].quadratic", 0.032f);
-        // point light 3
-        ourCube.setVec3("pointLights[2].position", pointLightPositions[2]);
-        ourCube.setVec3("pointLights[2].ambient", 0.05f, 0.05f, 0.05f);
-        ourCube.setVec3("pointLights[2].diffuse", 0.8f, 0.8f, 0.8f);
-        ourCube.setVec3("pointLights[2].specular", 1.0f, 1.0f, 1.0f);
-        ourCube.setFloat("pointLights[2].constant", 1.0f);
-        ourCube.setFloat("pointLights[2].linear", 0.09f);
-        ourCube.setFloat("pointLights[2].quadratic", 0.032f);
-        // point light 4
-        ourCube.setVec3("pointLights[3].position", pointLightPositions[3]);
-        ourCube.setVec3("pointLights[3].ambient", 0.05f, 0.05f, 0.05f);
-        ourCube.setVec3("pointLights[3].diffuse", 0.8f, 0.8f, 0.8f);
-        ourCube.setVec3("pointLights[3].specular", 1.0f, 1.0f, 1.0f);
-        ourCube.setFloat("pointLights[3].constant", 1.0f);
-        ourCube.setFloat("pointLights[3].linear", 0.09f);
-        ourCube.setFloat("pointLights[3].quadratic", 0.032f);
-        // spotLight
-        ourCube.setVec3("spotLight.position", camera.Position);
-        ourCube.setVec3("spotLight.direction", camera.Front);
-        ourCube.setVec3("spotLight.ambient", 0.0f, 0.0f, 0.0f);
-        ourCube.setVec3("spotLight.diffuse", 1.0f, 1.0f, 1.0f);
-        ourCube.setVec3("spotLight.specular", 1.0f, 1.0f, 1.0f);
-        ourCube.setFloat("spotLight.constant", 1.0f);
-        ourCube.setFloat("spotLight.linear", 0.09f);
-        ourCube.setFloat("spotLight.quadratic", 0.032f);
-        ourCube.setFloat("spotLight.cutOff", glm::cos(glm::radians(12.5f)));
-        ourCube.setFloat("spotLight.outerCutOff", glm::cos(glm::radians(15.0f)));
 
-        //--------------------------------------------------------------------------------------------------
-        // 3D Cube Object
+        // wait until the render thread is done with the frame that used this slot last time
+        auto waitStart = std::chrono::high_resolution_clock::now();
+        {
+            std::unique_lock<std::mutex> lock(renderSignalMutex);
+            renderThreadProgress.wait(lock, [&]() { return framesSimulated - framesRendered.load(std::memory_order_acquire) < FRAMES_IN_FLIGHT; });
+        }
+        auto simulationStart = std::chrono::high_resolution_clock::now();
+        unsigned long long allocationsBefore = threadAllocations();
+        FrameState &frame = frames[framesSimulated % FRAMES_IN_FLIGHT];
+        simulation.step(frame, currentFrame);
+        auto simulationEnd = std::chrono::high_resolution_clock::now();
+        frame.simulationMs = std::chrono::duration<double, std::milli>(simulationEnd - simulationStart).count();
+        frame.waitMs = std::chrono::duration<double, std::milli>(simulationStart - waitStart).count();
+        frame.simulationAllocations = threadAllocations() - allocationsBefore;
+        pushRenderCommand({RENDER_FRAME, framesSimulated % FRAMES_IN_FLIGHT, 0, 0});
+        framesSimulated++;
+        if (checkAllocations && framesSimulated >= ALLOCATION_WARMUP_FRAMES + ALLOCATION_CHECK_FRAMES)
+            glfwSetWindowShouldClose(window, true);
+
+        // GL benchmarks run on the render thread with the camera of the frame just queued, the cpu-only ones here
+        if (benchmarkRequested)
+        {
+            benchmarkRequested = false;
+            pushRenderCommand({RENDER_VERTEX_BENCHMARK, (framesSimulated - 1) % FRAMES_IN_FLIGHT, 0, 0});
+        }
+        if (gpuCullBenchmarkRequested)
+        {
+            gpuCullBenchmarkRequested = false;
+            pushRenderCommand({RENDER_GPU_CULL_BENCHMARK, (framesSimulated - 1) % FRAMES_IN_FLIGHT, 0, 0});
+        }
+        if (spinBenchmarkRequested)
+        {
+            spinBenchmarkRequested = false;
+            pushRenderCommand({RENDER_SPIN_BENCHMARK, (framesSimulated - 1) % FRAMES_IN_FLIGHT, 0, 0});
+        }
+        if (cullBenchmarkRequested)
+        {
+            cullBenchmarkRequested = false;
+            runCullingBenchmark();
+        }
+        if (occlusionBenchmarkRequested)
+        {
+            occlusionBenchmarkRequested = false;
+            runOcclusionBenchmark(occlusionCuller, simulation.cubeOccluder);
+        }
+        if (recordBenchmarkRequested)
+        {
+            recordBenchmarkRequested = false;
+            runRecordingBenchmark(ourCube, VAO, texture1, texture2);
+        }
+        if (jobBenchmarkRequested)
+        {
+            jobBenchmarkRequested = false;
+            runJobBenchmark();
+        }
+        if (transformBenchmarkRequested)
+        {
+            transformBenchmarkRequested = false;
+            runTransformBenchmark();
+        }
+        if (ecsBenchmarkRequested)
+        {
+            ecsBenchmarkRequested = false;
+            runEcsBenchmark();
+        }
+    }
+    pushRenderCommand({RENDER_QUIT, 0, 0, 0});
+    renderThread.join();
+    glfwMakeContextCurrent(window);
 
-        glm::mat4 view = camera.GetViewMatrix();
+    //--------------------------------------------------------------------------------------------------
+    // optional: de-allocate all resources once they've outlived their purpose:
+    glState().deleteVertexArrays(1, &VAO);
+    glState().deleteBuffers(1, &VBO);
+    glState().deleteBuffers(1, &lightingUBO);
+    staticBatcher.release();
+    shaderCache.release();
+    if (pullingSupported)
+    {
+        meshPool.release();
+        glState().deleteBuffers(1, &instanceSSBO);
+        glState().deleteBuffers(1, &spinSSBO);
+        rowImpostor.release();
+        renderer.release();
+        delete cullCompute;
+    }
 
-        glm::mat4 projection = glm::mat4(1.0f);
-        projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+    glfwTerminate(); // Cleanup and exit
+    if (checkAllocations)
+    {
+        unsigned int checkedFrames = framesRendered.load(std::memory_order_acquire);
+        checkedFrames = checkedFrames > ALLOCATION_WARMUP_FRAMES ? checkedFrames - ALLOCATION_WARMUP_FRAMES : 0;
+        if (checkedFrames < ALLOCATION_CHECK_FRAMES)
+        {
+            std::cout << "ERROR::FRAME::ALLOCATION_CHECK: closed after " << checkedFrames << " of " << ALLOCATION_CHECK_FRAMES << " frames" << std::endl;
+            return 1;
+        }
+        std::cout << "allocation check: " << renderer.steadyAllocations << " heap allocation(s) in " << checkedFrames << " frames after the warm-up" << std::endl;
+        if (renderer.steadyAllocations > 0)
+            return 1;
+    }
+    return 0;
+    //--------------------------------------------------------------------------------------------------
+}
 
-        ourCube.use();
+//--------------------------------------------------------------------------------------------------
+// Render thread
+// the queries and the queue's storage, on the thread that has the context before run() takes it
+void FrameRenderer::init(const SceneResources &resources)
+{
+    SceneResources::operator=(resources);
+    renderQueue.reserve(PACKET_CAPACITY, MODEL_CAPACITY);
+    if (!pullingSupported)
+        return;
+    rowQueries.init(NR_LOD_SPHERES);
+    sceneStats.init();
+    sceneTimer.init();
+    if (!sceneStats.statistics)
+        std::cout << "GL_ARB_pipeline_statistics_query not available, counting samples passed instead of fragment invocations" << std::endl;
+}
+// ------------------------------------------------------------------------
+void FrameRenderer::run(FrameState *frames)
+{
+    glfwMakeContextCurrent(window);
+    RenderCommand command;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(renderSignalMutex);
+            renderCommandPushed.wait(lock, [&]() { return renderCommands.pop(command); });
+        }
+        notifyRenderSignal(renderThreadProgress); // room in the queue again
+        if (command.type == RENDER_QUIT)
+            break;
+        if (command.type == RENDER_RESIZE)
+            glState().viewport(0, 0, command.width, command.height);
+        else if (command.type == RENDER_VERTEX_BENCHMARK)
+            runVertexPathBenchmark(*ourCube, *ourCubePull, VAO, *meshPool, instanceSSBO, frames[command.frame]);
+        else if (command.type == RENDER_GPU_CULL_BENCHMARK)
+            runGpuCullingBenchmark(*ourCubePull, *cullCompute, *meshPool, cubeMesh, frames[command.frame]);
+        else if (command.type == RENDER_SPIN_BENCHMARK)
+            runSpinBenchmark(*ourCubePull, *ourSpin, *meshPool, instanceSSBO, frames[command.frame]);
+        else
+            renderFrame(frames[command.frame]);
+    }
+    glfwMakeContextCurrent(NULL);
+}
+// ------------------------------------------------------------------------
+void FrameRenderer::release()
+{
+    if (!pullingSupported)
+        return;
+    sceneStats.release();
+    sceneTimer.release();
+    rowQueries.release();
+}
+// submits and swaps one simulated frame, then hands its state back to the main thread
+// ------------------------------------------------------------------------
+void FrameRenderer::renderFrame(const FrameState &frame)
+{
+    auto renderStart = std::chrono::high_resolution_clock::now();
+    unsigned long long allocationsBefore = threadAllocations(), reportAllocations = 0;
+    const Camera &viewer = frame.camera;
+    const glm::mat4 &view = frame.view;
+    const glm::mat4 &projection = frame.projection;
+    // settings as they were when the frame was simulated
+    bool vertexPulling = frame.vertexPulling;
+    bool depthPrepass = frame.depthPrepass;
+    reportFrames++;
+
+    glClearColor(0.23f * sin(frame.time), 0.55f * cos(frame.time), 0.36f * sin(frame.time), 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        int view_location = glGetUniformLocation(ourCube.ID, "view");
-        glUniformMatrix4fv(view_location, 1, GL_FALSE, glm::value_ptr(view));
+    //--------------------------------------------------------------------------------------------------
+    // Setting properties through uniforms
 
-        int projection_location = glGetUniformLocation(ourCube.ID, "projection");
-        glUniformMatrix4fv(projection_location, 1, GL_FALSE, glm::value_ptr(projection));
+    // texture activate
+    // bind textures on corresponding texture units
+    // the state cache activates the texture unit (GL_TEXTURE0 to GL_TEXTURE15) and drops binds that are already there
+    glState().bindTexture(0, GL_TEXTURE_2D, texture1);
+    glState().bindTexture(1, GL_TEXTURE_2D, texture2);
 
-        glBindVertexArray(VAO);
+    // the lights: one memcpy into the Lighting block, or uniforms on every lit program
+    const LitPrograms &lit = frame.lightingBlock ? blockLit : uniformLit;
+    if (frame.lightingBlock)
+    {
+        fillLightingBlock(lightingData, frame.pointLights, frame.spotLight, viewer);
+        glState().bindBuffer(GL_UNIFORM_BUFFER, lightingUBO);
+        void *mapped = glMapBufferRange(GL_UNIFORM_BUFFER, 0, sizeof(LightingBlock), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        memcpy(mapped, &lightingData, sizeof(LightingBlock));
+        glUnmapBuffer(GL_UNIFORM_BUFFER);
+        glState().bindBufferBase(GL_UNIFORM_BUFFER, LIGHTING_BINDING, lightingUBO);
+    }
 
-        for (unsigned int i = 0; i < 10; i++)
-        {
-            glm::mat4 model = glm::mat4(1.0f);
-            model = translate(model, cubePositions[i]);
-            float angle = glfwGetTime() * 100;
-            model = rotate(model, glm::radians(angle), glm::vec3(1.0f, 0.3f, 0.5f));
+    // the frame's programs defer their uploads (no use() needed to set them), the render queue flushes
+    // what changed when it binds a program for a draw; values the program already has are dropped
+    const Shader &cubeShader = vertexPulling ? *lit.pull : *lit.vao;
+    if (!frame.lightingBlock)
+        setLightingUniforms(cubeShader, frame.pointLights, frame.spotLight, viewer);
+    cubeShader.setMat4("view"_u, view);
+    cubeShader.setMat4("projection"_u, projection);
+
+    // once a second; on 4.3 when the scene's gpu timer and statistics have a result as well
+    bool sceneResults = true, report = false;
+    if (pullingSupported)
+    {
+        sceneTimer.poll();
+        sceneResults = sceneStats.poll();
+    }
+    if (sceneResults && frame.time - lastLodReport >= 1.0f)
+    {
+        // the report itself may allocate, it is not part of the frame
+        unsigned long long reportStart = threadAllocations();
+        lastLodReport = frame.time;
+        report = true;
+        printReport(frame);
+        reportAllocations = threadAllocations() - reportStart;
+    }
 
-            int modelLocation = glGetUniformLocation(ourCube.ID, "model");
-            glUniformMatrix4fv(modelLocation, 1, GL_FALSE, glm::value_ptr(model));
+    if (pullingSupported)
+    {
+        glState().bindBuffer(GL_SHADER_STORAGE_BUFFER, instanceSSBO);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, frame.instanceModels.size() * sizeof(glm::mat4), frame.instanceModels.data());
+        glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, INSTANCE_BINDING, instanceSSBO);
+    }
 
-            glDrawArrays(GL_TRIANGLES, 0, 36);
+    buildQueue(frame);
+    setFrameUniforms(frame, lit);
+
+    renderQueue.sort();
+    // gpu time and vertex/fragment work of the whole scene, press Z / I to compare. The gpu timer
+    // means little on a software driver, so the cpu side is timed as well: the submission every frame,
+    // and on the report frame the whole scene with glFinish before and after
+    if (report)
+        glFinish();
+    auto submitStart = std::chrono::high_resolution_clock::now();
+    if (pullingSupported)
+    {
+        sceneTimer.begin();
+        sceneStats.begin();
+    }
+    renderQueue.submit();
+    if (pullingSupported)
+    {
+        sceneStats.end();
+        sceneTimer.end();
+    }
+    submitMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - submitStart).count();
+    submitFrames++;
+    if (report)
+    {
+        glFinish();
+        unsigned long long reportStart = threadAllocations();
+        double finishedMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - submitStart).count();
+        std::cout << "  scene cpu: " << submitMs / submitFrames << " ms submit (average), " << finishedMs
+                  << " ms until finished (glFinish), depth pre-pass " << (depthPrepass ? "on" : "off") << std::endl;
+        submitMs = 0.0;
+        submitFrames = 0;
+        reportAllocations += threadAllocations() - reportStart;
+    }
+    renderMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - renderStart).count();
+    // steady state: nothing on the heap, neither while simulating nor while submitting
+    unsigned long long submitted = threadAllocations() - allocationsBefore - reportAllocations;
+    simulationAllocations += frame.simulationAllocations;
+    submissionAllocations += submitted;
+    if (framesRendered.load(std::memory_order_relaxed) >= ALLOCATION_WARMUP_FRAMES)
+        steadyAllocations += frame.simulationAllocations + submitted;
+    if (framesRendered.load(std::memory_order_relaxed) >= ALLOCATION_WARMUP_FRAMES && (frame.simulationAllocations > 0 || submitted > 0))
+        std::cout << "ERROR::FRAME::HEAP_ALLOCATION: frame " << framesRendered.load(std::memory_order_relaxed) << " allocated "
+                  << frame.simulationAllocations << " time(s) in simulation, " << submitted << " in submission" << std::endl;
+
+    glfwSwapBuffers(window);
+    // the frame state is free for the main thread again
+    framesRendered.fetch_add(1, std::memory_order_release);
+    notifyRenderSignal(renderThreadProgress);
+}
+// the per-second report, then its counters start over
+// ------------------------------------------------------------------------
+void FrameRenderer::printReport(const FrameState &frame)
+{
+    if (pullingSupported)
+    {
+        std::cout << "spheres: " << frame.lodTriangles << " triangles submitted (" << frame.fullTriangles << " without LOD), "
+                  << frame.impostorCount << " impostor(s)" << std::endl;
+        std::cout << "  culling " << (frame.cullingEnabled ? "on" : "off") << ": " << std::count(frame.objectVisible.begin(), frame.objectVisible.end(), 1)
+                  << " of " << frame.objectVisible.size() << " objects drawn, " << frame.nodesTested << " BVH node(s) tested" << std::endl;
+        if (frame.queryOcclusionEnabled)
+        {
+            std::cout << "  occlusion queries: " << rowQueries.queriesIssued << " issued, " << rowQueries.resultsCollected << " results ("
+                      << rowQueries.resultsVisible << " visible), latency avg " << (rowQueries.resultsCollected ? (float)rowQueries.latencyFrames / rowQueries.resultsCollected : 0.0f)
+                      << " max " << rowQueries.maxLatencyFrames << " frame(s), " << rowQueries.conditionalDraws << " conditional / " << rowQueries.plainDraws << " plain draws" << std::endl;
+            std::cout << "  visibility history (# visible, . occluded, newest last):";
+            for (unsigned int i = 0; i < NR_LOD_SPHERES; i++)
+            {
+                std::cout << " ";
+                for (int bit = 7; bit >= 0; bit--)
+                    std::cout << (bit >= (int)rowQueries.historyLength(i) ? '-' : (rowQueries.history(i) >> bit) & 1 ? '#' : '.');
+            }
+            std::cout << std::endl;
+            rowQueries.resetStats();
         }
-
-        //--------------------------------------------------------------------------------------------------
-        // Light Sources
-        // also draw the lamp object(s)
-        ourLight.use();
-        ourLight.setMat4("projection", projection);
-        ourLight.setMat4("view", view);
-
-        // we now draw as many light bulbs as we have point lights.
-        glBindVertexArray(VAO);
-        // world transformation
-        glm::mat4 model = glm::mat4(1.0f);
-        for (unsigned int i = 0; i < 4; i++)
+        if (frame.occlusionEnabled)
+            std::cout << "  occlusion: " << frame.objectsOccluded << " of " << frame.objectsTested << " occluded, raster "
+                      << frame.rasterMs << " ms (" << frame.occludersUsed << " occluders, " << frame.trianglesRasterized
+                      << " triangles, " << frame.occlusionThreads << " threads), test " << frame.testMs << " ms" << std::endl;
+        std::cout << "  scene shader invocations: " << sceneStats.vertices << " vertex, " << sceneStats.fragments
+                  << (sceneStats.statistics ? " fragment" : " samples passed") << std::endl;
+        std::cout << "  scene: " << sceneTimer.milliseconds << " ms gpu, depth pre-pass " << (frame.depthPrepass ? "on" : "off") << std::endl;
+    }
+    else
+        std::cout << "frame (OpenGL 3.3, no sphere row):" << std::endl;
+    std::cout << "  render queue: " << renderQueue.packets.size() << " packets, " << renderQueue.stateChanges << " state changes ("
+              << renderQueue.programBinds << " program, " << renderQueue.vaoBinds << " VAO, " << renderQueue.textureBinds << " texture), "
+              << renderQueue.unsortedStateChanges << " in submission order, " << renderQueue.skippedBinds << " redundant binds skipped, sort "
+              << renderQueue.sortMs << " ms" << std::endl;
+    std::cout << "  gl state cache: " << glState().issued / reportFrames << " calls issued, " << glState().filtered / reportFrames
+              << " redundant calls filtered per frame" << std::endl;
+    std::cout << "  uniforms: " << Shader::uniformUploads / reportFrames << " uploads, " << Shader::uniformUploadsSkipped / reportFrames
+              << " skipped (value unchanged or replaced before the draw) per frame" << std::endl;
+    std::cout << "  threads: simulation " << frame.simulationMs << " ms on the main thread (waited " << frame.waitMs
+              << " ms for a free frame state), submission " << renderMs << " ms on the render thread" << std::endl;
+    std::cout << "  transforms: " << frame.transformsRecomputed << " of " << frame.transformNodes
+              << " hierarchy nodes recomputed this frame, 10 spinning cubes composed by the SoA kernel" << std::endl;
+    std::cout << "  jobs: " << frame.workerUtilization.size() << " worker(s), " << frame.jobsExecuted << " executed ("
+              << frame.jobsStolen << " stolen) in the last second, utilization";
+    for (float utilization : frame.workerUtilization)
+        std::cout << " " << utilization * 100.0f << "%";
+    std::cout << std::endl;
+    std::cout << "  heap: " << simulationAllocations << " allocation(s) in simulation, " << submissionAllocations << " in submission over "
+              << reportFrames << " frames, frame arena " << frame.arenaUsed / 1024.0 << " of " << frame.arenaCapacity / 1024.0 << " KB" << std::endl;
+    glState().resetCounters();
+    Shader::resetUniformCounters();
+    reportFrames = 0;
+    simulationAllocations = submissionAllocations = 0;
+}
+// Render queue: the packets the main thread recorded plus the occlusion query boxes, sorted by pass,
+// program, textures, mesh and depth, then submitted with redundant binds skipped
+// ------------------------------------------------------------------------
+void FrameRenderer::buildQueue(const FrameState &frame)
+{
+    bool queries = pullingSupported && frame.queryOcclusionEnabled;
+    renderQueue.clear();
+    renderQueue.depthPrepass = frame.depthPrepass;
+    if (queries)
+    {
+        // occlusion queries: bounding boxes of the row objects against the depth pass
+        rowQueries.beginFrame();
+        for (unsigned int i = 0; i < NR_LOD_SPHERES; i++)
         {
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, pointLightPositions[i]);
-            model = glm::scale(model, glm::vec3(0.2f)); // Make it a smaller cube
-            ourLight.setMat4("model", model);
-            glDrawArrays(GL_TRIANGLES, 0, 36);
+            if (!frame.objectVisible[10 + i] || frame.sphereImpostor[i] || !rowQueries.needsQuery(i))
+                continue;
+            glm::vec3 center = (frame.objectMin[10 + i] + frame.objectMax[10 + i]) * 0.5f;
+            DrawPacket packet;
+            packet.shader = ourLight;
+            packet.VAO = lightVAO;
+            packet.count = 36;
+            packet.model = renderQueue.addModel(glm::scale(glm::translate(glm::mat4(1.0f), center), frame.objectMax[10 + i] - frame.objectMin[10 + i]));
+            packet.query = rowQueries.issueQuery(i);
+            renderQueue.add(RENDER_PASS_QUERY, 0, 0, glm::length(center - frame.camera.Position), packet);
         }
-
-        glfwSwapBuffers(window); // Swap buffers and poll IO events
-        glfwPollEvents();
     }
+    renderQueue.append(frame.commands);
+    if (queries)
+    {
+        // each row packet waits for the query of its object (or is drawn plainly while it is trusted)
+        for (DrawPacket &packet : renderQueue.packets)
+        {
+            if (packet.queryObject >= 0)
+                packet.condition = rowQueries.drawCondition(packet.queryObject);
+        }
+    }
+}
+// per-frame uniforms of every program the packets use except the cube shader, which has its own already
+// ------------------------------------------------------------------------
+void FrameRenderer::setFrameUniforms(const FrameState &frame, const LitPrograms &lit)
+{
+    const Camera &viewer = frame.camera;
+    const glm::mat4 &view = frame.view;
+    const glm::mat4 &projection = frame.projection;
+    ourLight->setMat4("projection"_u, projection);
+    ourLight->setMat4("view"_u, view);
+    ourDepth->setMat4("projection"_u, projection);
+    ourDepth->setMat4("view"_u, view);
+    if (!pullingSupported)
+        return;
+    if (!frame.vertexPulling)
+    {
+        if (!frame.lightingBlock)
+            setLightingUniforms(*lit.pull, frame.pointLights, frame.spotLight, viewer);
+        lit.pull->setMat4("view"_u, view);
+        lit.pull->setMat4("projection"_u, projection);
+    }
+    ourDepthPull->setMat4("view"_u, view);
+    ourDepthPull->setMat4("projection"_u, projection);
+    if (frame.gpuAnimation)
+    {
+        if (!frame.lightingBlock)
+            setLightingUniforms(*lit.spin, frame.pointLights, frame.spotLight, viewer);
+        lit.spin->setMat4("view"_u, view);
+        lit.spin->setMat4("projection"_u, projection);
+        lit.spin->setFloat("time"_u, frame.time);
+        ourDepthSpin->setMat4("view"_u, view);
+        ourDepthSpin->setMat4("projection"_u, projection);
+        ourDepthSpin->setFloat("time"_u, frame.time);
+        glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, SPIN_BINDING, spinSSBO);
+    }
+    if (!frame.lightingBlock)
+        setLightingUniforms(*lit.impostor, frame.pointLights, frame.spotLight, viewer);
+    lit.impostor->setMat4("view"_u, view);
+    lit.impostor->setMat4("projection"_u, projection);
+    rowImpostor->setUniforms(*lit.impostor, 2);
+    // attribute streams of the pool, the queue only switches VAOs
+    meshPool->bind();
+}
 
-    //--------------------------------------------------------------------------------------------------
-    // optional: de-allocate all resources once they've outlived their purpose:
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
+//--------------------------------------------------------------------------------------------------
+// Simulation
+// per-frame lists at their full size, so stepping a frame never grows them
+void Simulation::init(const SceneResources &resources)
+{
+    SceneResources::operator=(resources);
+    objectVisible.assign(10 + NR_LOD_SPHERES, 1);
+    sphereLevel.assign(NR_LOD_SPHERES, 0);
+    sphereInstance.assign(NR_LOD_SPHERES, 0);
+    sceneCommands.resize(SCENE_GROUP_COUNT);
+    for (CommandBuffer &buffer : sceneCommands)
+        buffer.reserve(PACKET_CAPACITY, MODEL_CAPACITY);
+    workerUtilization.assign(jobSystem.workerCount(), 0.0f);
+}
+// simulates the frame at time into frame, with the settings as they are now
+// ------------------------------------------------------------------------
+void Simulation::step(FrameState &frame, float time)
+{
+    frameArena.reset();
+    frame.time = time;
+    frame.camera = camera;
+    frame.vertexPulling = vertexPulling;
+    frame.queryOcclusionEnabled = queryOcclusionEnabled;
+    frame.depthPrepass = depthPrepass;
+    frame.cullingEnabled = cullingEnabled;
+    frame.occlusionEnabled = occlusionEnabled;
+    frame.gpuAnimation = pullingSupported && spinLayoutMatches && gpuAnimation;
+    frame.lightingBlock = lightingLayoutMatches && lightingBlock;
+    frame.view = camera.GetViewMatrix();
+    frame.projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+
+    updateTransforms(frame);
+    cull(frame);
+    selectLods(frame);
+    recordPackets(frame);
+
+    frame.objectVisible = objectVisible;
+    frame.objectMin = objectMin;
+    frame.objectMax = objectMax;
+    frame.nodesTested = sceneBvh.nodesTested;
+    frame.occludersUsed = occlusionCuller.occludersUsed;
+    frame.trianglesRasterized = occlusionCuller.trianglesRasterized;
+    frame.objectsTested = occlusionCuller.objectsTested;
+    frame.objectsOccluded = occlusionCuller.objectsOccluded;
+    frame.rasterMs = occlusionCuller.rasterMs;
+    frame.testMs = occlusionCuller.testMs;
+    frame.occlusionThreads = occlusionCuller.threadCount;
+    if (time - lastJobSample >= 1.0f)
+    {
+        lastJobSample = time;
+        jobSystem.sampleStats(workerUtilization, jobsExecuted, jobsStolen);
+    }
+    frame.workerUtilization = workerUtilization;
+    frame.jobsExecuted = jobsExecuted;
+    frame.jobsStolen = jobsStolen;
+    frame.arenaUsed = frameArena.used;
+    frame.arenaCapacity = frameArena.capacity();
+}
+// the hierarchy, the lights taken from it and the spinning cubes
+// ------------------------------------------------------------------------
+void Simulation::updateTransforms(FrameState &frame)
+{
+    // transform hierarchy: only a moved camera dirties anything (its subtree is the flashlight)
+    if (frame.view != cameraView)
+    {
+        cameraView = frame.view;
+        sceneGraph.setLocal(cameraNode, glm::inverse(frame.view));
+    }
+    frame.transformsRecomputed = sceneGraph.update();
+    frame.transformNodes = sceneGraph.size();
+    frame.pointLights.clear();
+    scene.each<PointLight, SceneNode>([&](Entity, const PointLight &light, const SceneNode &node)
+                                      {
+                                          frame.pointLights.push_back(light);
+                                          frame.pointLights.back().position = glm::vec3(sceneGraph.world(node.node)[3]);
+                                      });
+    scene.each<SpotLight, SceneNode>([&](Entity, const SpotLight &light, const SceneNode &node)
+                                     {
+                                         const glm::mat4 &world = sceneGraph.world(node.node);
+                                         frame.spotLight = light;
+                                         frame.spotLight.position = glm::vec3(world[3]);
+                                         frame.spotLight.direction = -glm::normalize(glm::vec3(world[2]));
+                                     });
+
+    // transform updates and the world boxes for culling on the job system (10 cubes are below the
+    // grain, they stay on this thread). The matrices go straight into the instance list, the cubes
+    // are its first entries; invisible ones are compacted away after culling
+    std::vector<glm::mat4> &instanceModels = frame.instanceModels;
+    if (!frame.gpuAnimation)
+    {
+        scene.each<Transform, Spin, MeshRenderer>([&](Entity, Transform &transform, const Spin &spin, const MeshRenderer &renderer)
+                                                  {
+                                                      transform.rotation = glm::angleAxis(glm::radians(frame.time * spin.degreesPerSecond + spin.phase), spin.axis);
+                                                      cubeTransforms.setRotation(renderer.object, transform.rotation);
+                                                  });
+        jobSystem.parallelFor(10, [&](unsigned int first, unsigned int last)
+                              {
+                                  cubeTransforms.compose(first, last, &instanceModels[first]);
+                                  for (unsigned int i = first; i < last; i++)
+                                      transformBounds(instanceModels[i], CUBE_MIN, CUBE_MAX, objectMin[i], objectMax[i]);
+                              });
+        for (unsigned int i = 0; i < 10; i++)
+            sceneBvh.update(i, objectMin[i], objectMax[i]);
+        cubesSpinOnGpu = false;
+    }
+    else if (!cubesSpinOnGpu)
+    {
+        // the swept boxes never change, they go into the BVH once
+        for (unsigned int i = 0; i < 10; i++)
+        {
+            objectMin[i] = spinMin[i];
+            objectMax[i] = spinMax[i];
+            sceneBvh.update(i, objectMin[i], objectMax[i]);
+        }
+        cubesSpinOnGpu = true;
+    }
+}
+// ------------------------------------------------------------------------
+void Simulation::cull(FrameState &frame)
+{
+    glm::mat4 viewProjection = frame.projection * frame.view;
+    std::vector<glm::mat4> &instanceModels = frame.instanceModels;
+    // frustum culling: refit the spinning cubes, then only visible objects go into the draw lists
+    sceneBvh.refit();
+    visibleObjects.clear();
+    std::fill(objectVisible.begin(), objectVisible.end(), frame.cullingEnabled ? 0 : 1);
+    if (frame.cullingEnabled)
+    {
+        sceneBvh.cull(Frustum(viewProjection), visibleObjects);
+        for (unsigned int id : visibleObjects)
+            objectVisible[id] = 1;
+    }
+    // occlusion culling: the cubes that survived are rasterized on the cpu (tiles as jobs), everything is tested
+    // against them, the tests split over the job system as well
+    if (frame.occlusionEnabled)
+    {
+        occlusionCuller.beginFrame(viewProjection, frame.camera.Position);
+        for (unsigned int i = 0; i < 10; i++)
+        {
+            if (objectVisible[i] && frame.gpuAnimation)
+                occlusionCuller.addOccluder(cubeOccluder, spinOccluderModels[i], spinOccluderMin[i], spinOccluderMax[i]);
+            else if (objectVisible[i])
+                occlusionCuller.addOccluder(cubeOccluder, instanceModels[i], objectMin[i], objectMax[i]);
+        }
+        occlusionCuller.rasterize();
+        occlusionCuller.cullObjects(objectMin, objectMax, objectVisible);
+    }
+    // animated on the gpu the cubes are drawn straight from the spin SSBO, they take no instance slots
+    visibleCubes = 0;
+    for (unsigned int i = 0; i < 10 && !frame.gpuAnimation; i++)
+    {
+        if (objectVisible[i])
+            instanceModels[visibleCubes++] = instanceModels[i];
+    }
+}
+// LOD spheres: pick a level per sphere, then group the instances by level (after the visible cubes)
+// so every level is one instanced draw
+// ------------------------------------------------------------------------
+void Simulation::selectLods(FrameState &frame)
+{
+    const Camera &viewer = frame.camera;
+    std::vector<glm::mat4> &instanceModels = frame.instanceModels;
+    std::fill(levelCount, levelCount + NR_LOD_LEVELS, 0);
+    frame.lodTriangles = frame.fullTriangles = 0;
+    // past the cut-over distance a sphere becomes an impostor, those go after the LOD groups
+    std::vector<char> &sphereImpostor = frame.sphereImpostor;
+    sphereImpostor.assign(NR_LOD_SPHERES, 0);
+    frame.impostorCount = 0;
+    if (!pullingSupported)
+        return;
+    float pixelsPerUnit = SCR_HEIGHT / (2.0f * tan(glm::radians(viewer.Zoom) * 0.5f));
+    for (unsigned int i = 0; i < NR_LOD_SPHERES; i++)
+    {
+        if (!objectVisible[10 + i])
+            continue;
+        float distance = glm::length(spherePositions[i] - viewer.Position);
+        sphereLevel[i] = lodEnabled ? selectLod(rowLods, distance, rowScale, pixelsPerUnit, LOD_PIXEL_ERROR, LOD_HYSTERESIS, sphereLevel[i]) : 0;
+        frame.fullTriangles += rowLods.levels[0].triangleCount;
+        if (impostorsEnabled && distance > impostorDistance)
+        {
+            sphereImpostor[i] = 1;
+            frame.impostorCount++;
+            frame.lodTriangles += 2;
+            continue;
+        }
+        levelCount[sphereLevel[i]]++;
+        frame.lodTriangles += rowLods.levels[sphereLevel[i]].triangleCount;
+    }
+    unsigned int next = visibleCubes;
+    for (unsigned int level = 0; level < rowLods.levels.size(); level++)
+    {
+        levelFirst[level] = next;
+        for (unsigned int i = 0; i < NR_LOD_SPHERES; i++)
+        {
+            if (!objectVisible[10 + i] || sphereLevel[i] != level || sphereImpostor[i])
+                continue;
+            sphereInstance[i] = next;
+            instanceModels[next++] = sphereModels[i];
+        }
+    }
+    impostorFirst = next;
+    for (unsigned int i = 0; i < NR_LOD_SPHERES; i++)
+    {
+        if (!sphereImpostor[i])
+            continue;
+        instanceModels[next++] = sphereModels[i];
+    }
+}
+// Draw packets of the frame, recorded without GL: the cubes, the row and the lamps each go into their
+// own command buffer on the job system and are appended to the frame's buffer in that order (the same
+// packets as recording them one after another); the render thread adds the occlusion query boxes,
+// sorts and submits them
+// ------------------------------------------------------------------------
+void Simulation::recordPackets(FrameState &frame)
+{
+    recordParallel(jobSystem, sceneCommands, SCENE_GROUP_COUNT, [&](CommandBuffer &commands, unsigned int first, unsigned int last)
+                   {
+                       for (unsigned int group = first; group < last; group++)
+                       {
+                           if (group == SCENE_GROUP_CUBES)
+                               recordCubes(frame, commands);
+                           else if (group == SCENE_GROUP_ROW && pullingSupported)
+                               recordRow(frame, commands);
+                           else if (group == SCENE_GROUP_LAMPS)
+                               recordLamps(frame, commands);
+                       }
+                   });
+    frame.commands.clear();
+    for (const CommandBuffer &buffer : sceneCommands)
+        frame.commands.append(buffer);
+}
+// ------------------------------------------------------------------------
+void Simulation::recordCubes(const FrameState &frame, CommandBuffer &commands)
+{
+    const glm::vec3 &viewPos = frame.camera.Position;
+    const std::vector<glm::mat4> &instanceModels = frame.instanceModels;
+    const LitPrograms &lit = frame.lightingBlock ? blockLit : uniformLit;
+    const Shader &cubeShader = frame.vertexPulling ? *lit.pull : *lit.vao;
+    // the cubes are the occluders of the row queries, so with queries on they are in the depth pass either way
+    bool cubesInDepthPass = frame.depthPrepass || (pullingSupported && frame.queryOcclusionEnabled);
+    if (frame.gpuAnimation)
+    {
+        // one instanced draw per run of visible cubes in the spin SSBO (all ten in view is one draw)
+        for (unsigned int first = 0; first < 10;)
+        {
+            if (!objectVisible[first])
+            {
+                first++;
+                continue;
+            }
+            unsigned int last = first;
+            float nearest = commands.maxDepth;
+            for (; last < 10 && objectVisible[last]; last++)
+                nearest = std::min(nearest, glm::length(cubeTransforms.position(last) - viewPos));
+            DrawPacket packet = poolPacket(*lit.spin, *meshPool, cubeMesh, first, last - first);
+            packet.textures[0] = texture1;
+            packet.textures[1] = texture2;
+            commands.add(RENDER_PASS_OPAQUE, texture1, cubeMesh, nearest, packet);
+            if (cubesInDepthPass)
+                commands.add(RENDER_PASS_DEPTH, 0, cubeMesh, nearest, poolPacket(*ourDepthSpin, *meshPool, cubeMesh, first, last - first));
+            first = last;
+        }
+    }
+    else if (frame.vertexPulling && visibleCubes > 0)
+    {
+        // one empty VAO for everything, one instanced draw for all cubes, depth of the nearest one
+        float nearest = commands.maxDepth;
+        for (unsigned int i = 0; i < visibleCubes; i++)
+            nearest = std::min(nearest, glm::length(glm::vec3(instanceModels[i][3]) - viewPos));
+        DrawPacket packet = poolPacket(cubeShader, *meshPool, cubeMesh, 0, visibleCubes);
+        packet.textures[0] = texture1;
+        packet.textures[1] = texture2;
+        commands.add(RENDER_PASS_OPAQUE, texture1, cubeMesh, nearest, packet);
+        if (cubesInDepthPass)
+            commands.add(RENDER_PASS_DEPTH, 0, cubeMesh, nearest, poolPacket(*ourDepthPull, *meshPool, cubeMesh, 0, visibleCubes));
+    }
+    else if (!frame.vertexPulling)
+    {
+        for (unsigned int i = 0; i < visibleCubes; i++)
+        {
+            float distance = glm::length(glm::vec3(instanceModels[i][3]) - viewPos);
+            DrawPacket packet;
+            packet.shader = &cubeShader;
+            packet.VAO = VAO;
+            packet.count = 36;
+            packet.model = commands.addModel(instanceModels[i]);
+            packet.textures[0] = texture1;
+            packet.textures[1] = texture2;
+            commands.add(RENDER_PASS_OPAQUE, texture1, 0, distance, packet);
+            if (cubesInDepthPass)
+            {
+                packet.shader = ourDepth;
+                packet.textures[0] = packet.textures[1] = 0;
+                commands.add(RENDER_PASS_DEPTH, 0, 0, distance, packet);
+            }
+        }
+    }
+}
+// ------------------------------------------------------------------------
+void Simulation::recordRow(const FrameState &frame, CommandBuffer &commands)
+{
+    const glm::vec3 &viewPos = frame.camera.Position;
+    const std::vector<char> &sphereImpostor = frame.sphereImpostor;
+    const LitPrograms &lit = frame.lightingBlock ? blockLit : uniformLit;
+    const Shader &sphereShader = *lit.pull;
+    if (frame.queryOcclusionEnabled)
+    {
+        // one packet per object, the render thread makes each one conditional on the query of its object.
+        // Queried objects stay out of the depth pass: their boxes are tested against the occluders' depth
+        // only (their own would always let the box through), so with the pre-pass on they go to the
+        // cutout pass, which writes its own depth after the GL_EQUAL opaque pass
+        unsigned int rowPass = frame.depthPrepass ? RENDER_PASS_CUTOUT : RENDER_PASS_OPAQUE;
+        for (unsigned int i = 0; i < NR_LOD_SPHERES; i++)
+        {
+            if (!objectVisible[10 + i] || sphereImpostor[i])
+                continue;
+            unsigned int mesh = rowLods.levels[sphereLevel[i]].mesh;
+            float distance = glm::length(spherePositions[i] - viewPos);
+            DrawPacket packet = poolPacket(sphereShader, *meshPool, mesh, sphereInstance[i], 1);
+            packet.textures[0] = texture1;
+            packet.textures[1] = texture2;
+            packet.queryObject = (int)i;
+            commands.add(rowPass, texture1, mesh, distance, packet);
+        }
+    }
+    else
+    {
+        for (unsigned int level = 0; level < rowLods.levels.size(); level++)
+        {
+            if (levelCount[level] == 0)
+                continue;
+            float nearest = commands.maxDepth;
+            for (unsigned int i = 0; i < NR_LOD_SPHERES; i++)
+            {
+                if (objectVisible[10 + i] && !sphereImpostor[i] && sphereLevel[i] == level)
+                    nearest = std::min(nearest, glm::length(spherePositions[i] - viewPos));
+            }
+            unsigned int mesh = rowLods.levels[level].mesh;
+            DrawPacket packet = poolPacket(sphereShader, *meshPool, mesh, levelFirst[level], levelCount[level]);
+            packet.textures[0] = texture1;
+            packet.textures[1] = texture2;
+            commands.add(RENDER_PASS_OPAQUE, texture1, mesh, nearest, packet);
+            if (frame.depthPrepass)
+                commands.add(RENDER_PASS_DEPTH, 0, mesh, nearest, poolPacket(*ourDepthPull, *meshPool, mesh, levelFirst[level], levelCount[level]));
+        }
+    }
 
-    glfwTerminate(); // Cleanup and exit
-    return 0;
-    //--------------------------------------------------------------------------------------------------
+    if (frame.impostorCount > 0)
+    {
+        // impostors move their depth in the fragment shader, they are not in the depth pass
+        float nearest = commands.maxDepth;
+        for (unsigned int i = 0; i < NR_LOD_SPHERES; i++)
+        {
+            if (sphereImpostor[i])
+                nearest = std::min(nearest, glm::length(spherePositions[i] - viewPos));
+        }
+        DrawPacket packet;
+        packet.shader = lit.impostor;
+        packet.VAO = meshPool->VAO;
+        packet.mode = GL_TRIANGLE_STRIP;
+        packet.count = 4;
+        packet.instanceCount = frame.impostorCount;
+        packet.instanceOffset = (int)impostorFirst;
+        packet.textures[2] = rowImpostor->albedoTexture;
+        packet.textures[3] = rowImpostor->normalTexture;
+        packet.textures[4] = rowImpostor->depthTexture;
+        commands.add(RENDER_PASS_CUTOUT, rowImpostor->albedoTexture, rowImpostor->mesh, nearest, packet);
+    }
+}
+// the lamp object(s), already in world space inside the static batch
+// ------------------------------------------------------------------------
+void Simulation::recordLamps(const FrameState &frame, CommandBuffer &commands)
+{
+    lampRuns.clear();
+    staticBatcher.collect(LAMP_MATERIAL, Frustum(frame.projection * frame.view), lampRuns);
+    int lampModel = commands.addModel(glm::mat4(1.0f));
+    for (const StaticRun &run : lampRuns)
+    {
+        float distance = glm::length((run.boundsMin + run.boundsMax) * 0.5f - frame.camera.Position);
+        DrawPacket packet;
+        packet.shader = ourLight;
+        packet.VAO = run.VAO;
+        packet.indexed = true;
+        packet.first = run.firstIndex;
+        packet.count = run.indexCount;
+        packet.model = lampModel;
+        commands.add(RENDER_PASS_OPAQUE, 0, 0, distance, packet);
+        if (frame.depthPrepass)
+        {
+            packet.shader = ourDepth;
+            commands.add(RENDER_PASS_DEPTH, 0, 0, distance, packet);
+        }
+    }
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -408,13 +1917,1050 @@ void processInput(GLFWwindow *window)
         camera.ProcessKeyboard(LEFT, deltaTime);
     if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
         camera.ProcessKeyboard(RIGHT, deltaTime);
+
+    // P: switch between the VAO path and vertex pulling, B: benchmark both
+    if (keyPressed(window, GLFW_KEY_P) && pullingSupported)
+    {
+        vertexPulling = !vertexPulling;
+        std::cout << (vertexPulling ? "vertex pulling (SSBO)" : "VAO attributes") << std::endl;
+    }
+
+    if (keyPressed(window, GLFW_KEY_B) && pullingSupported)
+        benchmarkRequested = true;
+
+    // M: cubes animated in the vertex shader, K: benchmark a million of them against cpu matrices
+    if (keyPressed(window, GLFW_KEY_M) && spinLayoutMatches)
+    {
+        gpuAnimation = !gpuAnimation;
+        std::cout << "cube animation on the " << (gpuAnimation ? "gpu (4.3.spin.vert)" : "cpu") << std::endl;
+    }
+
+    // U: lights through the std140 Lighting block instead of plain uniforms
+    if (keyPressed(window, GLFW_KEY_U) && lightingLayoutMatches)
+    {
+        lightingBlock = !lightingBlock;
+        std::cout << "lights in " << (lightingBlock ? "the Lighting uniform block (LIGHTS_IN_BLOCK)" : "plain uniforms") << std::endl;
+    }
+
+    if (keyPressed(window, GLFW_KEY_K) && spinLayoutMatches)
+        spinBenchmarkRequested = true;
+
+    // L: LOD selection on/off (off = every sphere at full detail)
+    if (keyPressed(window, GLFW_KEY_L))
+    {
+        lodEnabled = !lodEnabled;
+        std::cout << "LOD " << (lodEnabled ? "on" : "off") << std::endl;
+    }
+
+    // I: impostors on/off, [ / ]: move the cut-over distance closer / further
+    if (keyPressed(window, GLFW_KEY_I))
+    {
+        impostorsEnabled = !impostorsEnabled;
+        std::cout << "impostors " << (impostorsEnabled ? "on" : "off") << std::endl;
+    }
+
+    if (keyPressed(window, GLFW_KEY_LEFT_BRACKET))
+    {
+        impostorDistance = std::max(IMPOSTOR_DISTANCE_STEP, impostorDistance - IMPOSTOR_DISTANCE_STEP);
+        std::cout << "impostor cut-over: " << impostorDistance << std::endl;
+    }
+
+    if (keyPressed(window, GLFW_KEY_RIGHT_BRACKET))
+    {
+        impostorDistance += IMPOSTOR_DISTANCE_STEP;
+        std::cout << "impostor cut-over: " << impostorDistance << std::endl;
+    }
+
+    // C: frustum culling on/off, V: culling benchmark
+    if (keyPressed(window, GLFW_KEY_C))
+    {
+        cullingEnabled = !cullingEnabled;
+        std::cout << "frustum culling " << (cullingEnabled ? "on" : "off") << std::endl;
+    }
+
+    if (keyPressed(window, GLFW_KEY_V))
+        cullBenchmarkRequested = true;
+
+    // G: CPU vs GPU culling benchmark
+    if (keyPressed(window, GLFW_KEY_G) && pullingSupported)
+        gpuCullBenchmarkRequested = true;
+
+    // O: occlusion culling on/off, H: occlusion benchmark
+    if (keyPressed(window, GLFW_KEY_O))
+    {
+        occlusionEnabled = !occlusionEnabled;
+        std::cout << "occlusion culling " << (occlusionEnabled ? "on" : "off") << std::endl;
+    }
+
+    if (keyPressed(window, GLFW_KEY_H))
+        occlusionBenchmarkRequested = true;
+
+    // Q: hardware occlusion queries for the row
+    if (keyPressed(window, GLFW_KEY_Q) && pullingSupported)
+    {
+        queryOcclusionEnabled = !queryOcclusionEnabled;
+        std::cout << "occlusion queries " << (queryOcclusionEnabled ? "on" : "off") << std::endl;
+    }
+
+    // Z: depth pre-pass on/off
+    if (keyPressed(window, GLFW_KEY_Z))
+    {
+        depthPrepass = !depthPrepass;
+        std::cout << "depth pre-pass " << (depthPrepass ? "on" : "off") << std::endl;
+    }
+
+    // R: parallel command recording benchmark
+    if (keyPressed(window, GLFW_KEY_R))
+        recordBenchmarkRequested = true;
+
+    // J: job system scaling benchmark
+    if (keyPressed(window, GLFW_KEY_J))
+        jobBenchmarkRequested = true;
+
+    // T: transform benchmark
+    if (keyPressed(window, GLFW_KEY_T))
+        transformBenchmarkRequested = true;
+
+    // E: ECS benchmark
+    if (keyPressed(window, GLFW_KEY_E))
+        ecsBenchmarkRequested = true;
+}
+
+// true only on the frame a key goes down, so holding a toggle key does not flip it every frame
+// ------------------------------------------------------------------------
+bool keyPressed(GLFWwindow *window, int key)
+{
+    static bool held[GLFW_KEY_LAST + 1] = {};
+    bool down = glfwGetKey(window, key) == GLFW_PRESS;
+    bool pressed = down && !held[key];
+    held[key] = down;
+    return pressed;
+}
+
+//--------------------------------------------------------------------------------------------------
+// lighting uniforms shared by the VAO and the vertex pulling programs
+void setLightingUniforms(const Shader &shader, const std::vector<PointLight> &pointLights, const SpotLight &spotLight, const Camera &viewer)
+{
+    shader.setVec3("viewPos"_u, viewer.Position);
+    shader.setFloat("material.shininess"_u, 32.0f);
+
+    /*
+       Here we set all the uniforms for the 5/6 types of lights we have. We have to set them manually and index
+       the proper PointLight struct in the array to set each uniform variable. This can be done more code-friendly
+       by defining light types as classes and set their values in there, or by using a more efficient uniform approach
+       by using 'Uniform buffer objects', but that is something we'll discuss in the 'Advanced GLSL' tutorial.
+    */
+    // directional light
+    shader.setVec3("dirLight.direction"_u, -0.2f, -1.0f, -0.3f);
+    shader.setVec3("dirLight.ambient"_u, 0.05f, 0.05f, 0.05f);
+    shader.setVec3("dirLight.diffuse"_u, 0.4f, 0.4f, 0.4f);
+    shader.setVec3("dirLight.specular"_u, 0.5f, 0.5f, 0.5f);
+    // point lights, the shaders have room for NR_POINT_LIGHTS
+    for (unsigned int i = 0; i < pointLights.size() && i < NR_POINT_LIGHTS; i++)
+    {
+        const PointLight &light = pointLights[i];
+        const PointLightUniforms &uniforms = POINT_LIGHT_UNIFORMS[i];
+        shader.setVec3(uniforms.position, light.position);
+        shader.setVec3(uniforms.ambient, light.ambient);
+        shader.setVec3(uniforms.diffuse, light.diffuse);
+        shader.setVec3(uniforms.specular, light.specular);
+        shader.setFloat(uniforms.constant, light.constant);
+        shader.setFloat(uniforms.linear, light.linear);
+        shader.setFloat(uniforms.quadratic, light.quadratic);
+    }
+    // spotLight, hangs under the camera in the scene graph
+    shader.setVec3("spotLight.position"_u, spotLight.position);
+    shader.setVec3("spotLight.direction"_u, spotLight.direction);
+    shader.setVec3("spotLight.ambient"_u, spotLight.ambient);
+    shader.setVec3("spotLight.diffuse"_u, spotLight.diffuse);
+    shader.setVec3("spotLight.specular"_u, spotLight.specular);
+    shader.setFloat("spotLight.constant"_u, spotLight.constant);
+    shader.setFloat("spotLight.linear"_u, spotLight.linear);
+    shader.setFloat("spotLight.quadratic"_u, spotLight.quadratic);
+    shader.setFloat("spotLight.cutOff"_u, spotLight.cutOff);
+    shader.setFloat("spotLight.outerCutOff"_u, spotLight.outerCutOff);
+}
+
+//--------------------------------------------------------------------------------------------------
+// the values of setLightingUniforms() laid out as the Lighting block, padding untouched
+void fillLightingBlock(LightingBlock &block, const std::vector<PointLight> &pointLights, const SpotLight &spotLight, const Camera &viewer)
+{
+    block.viewPos = viewer.Position;
+    block.material.shininess = 32.0f;
+    block.dirLight.direction = glm::vec3(-0.2f, -1.0f, -0.3f);
+    block.dirLight.ambient = glm::vec3(0.05f, 0.05f, 0.05f);
+    block.dirLight.diffuse = glm::vec3(0.4f, 0.4f, 0.4f);
+    block.dirLight.specular = glm::vec3(0.5f, 0.5f, 0.5f);
+    for (unsigned int i = 0; i < pointLights.size() && i < NR_POINT_LIGHTS; i++)
+    {
+        const PointLight &light = pointLights[i];
+        PointLightStd140 &target = block.pointLights[i];
+        target.position = light.position;
+        target.ambient = light.ambient;
+        target.diffuse = light.diffuse;
+        target.specular = light.specular;
+        target.constant = light.constant;
+        target.linear = light.linear;
+        target.quadratic = light.quadratic;
+    }
+    SpotLightStd140 &spot = block.spotLight;
+    spot.position = spotLight.position;
+    spot.direction = spotLight.direction;
+    spot.ambient = spotLight.ambient;
+    spot.diffuse = spotLight.diffuse;
+    spot.specular = spotLight.specular;
+    spot.constant = spotLight.constant;
+    spot.linear = spotLight.linear;
+    spot.quadratic = spotLight.quadratic;
+    spot.cutOff = spotLight.cutOff;
+    spot.outerCutOff = spotLight.outerCutOff;
+}
+
+//--------------------------------------------------------------------------------------------------
+// every member of the Lighting block by the name the linker gives it, with its offset in LightingBlock
+std::vector<BlockMember> lightingBlockMembers()
+{
+    std::vector<BlockMember> members = {
+        {"viewPos", offsetof(LightingBlock, viewPos)},
+        {"material.shininess", offsetof(LightingBlock, material.shininess)},
+        {"dirLight.direction", offsetof(LightingBlock, dirLight.direction)},
+        {"dirLight.ambient", offsetof(LightingBlock, dirLight.ambient)},
+        {"dirLight.diffuse", offsetof(LightingBlock, dirLight.diffuse)},
+        {"dirLight.specular", offsetof(LightingBlock, dirLight.specular)},
+    };
+    for (unsigned int i = 0; i < NR_POINT_LIGHTS; i++)
+    {
+        std::string light = "pointLights[" + std::to_string(i) + "].";
+        size_t base = offsetof(LightingBlock, pointLights) + i * sizeof(PointLightStd140);
+        members.push_back({light + "position", base + offsetof(PointLightStd140, position)});
+        members.push_back({light + "constant", base + offsetof(PointLightStd140, constant)});
+        members.push_back({light + "linear", base + offsetof(PointLightStd140, linear)});
+        members.push_back({light + "quadratic", base + offsetof(PointLightStd140, quadratic)});
+        members.push_back({light + "ambient", base + offsetof(PointLightStd140, ambient)});
+        members.push_back({light + "diffuse", base + offsetof(PointLightStd140, diffuse)});
+        members.push_back({light + "specular", base + offsetof(PointLightStd140, specular)});
+    }
+    size_t spot = offsetof(LightingBlock, spotLight);
+    members.push_back({"spotLight.position", spot + offsetof(SpotLightStd140, position)});
+    members.push_back({"spotLight.direction", spot + offsetof(SpotLightStd140, direction)});
+    members.push_back({"spotLight.cutOff", spot + offsetof(SpotLightStd140, cutOff)});
+    members.push_back({"spotLight.outerCutOff", spot + offsetof(SpotLightStd140, outerCutOff)});
+    members.push_back({"spotLight.constant", spot + offsetof(SpotLightStd140, constant)});
+    members.push_back({"spotLight.linear", spot + offsetof(SpotLightStd140, linear)});
+    members.push_back({"spotLight.quadratic", spot + offsetof(SpotLightStd140, quadratic)});
+    members.push_back({"spotLight.ambient", spot + offsetof(SpotLightStd140, ambient)});
+    members.push_back({"spotLight.diffuse", spot + offsetof(SpotLightStd140, diffuse)});
+    members.push_back({"spotLight.specular", spot + offsetof(SpotLightStd140, specular)});
+    return members;
+}
+
+//--------------------------------------------------------------------------------------------------
+// draws BENCH_INSTANCES cubes BENCH_FRAMES times through each path and prints the average frame time.
+// glFinish makes the cpu wait for the (software) driver so the numbers include the actual rendering.
+void runVertexPathBenchmark(const Shader &vaoShader, const Shader &pullShader, unsigned int VAO, const MeshPool &meshPool, unsigned int instanceSSBO, const FrameState &frame)
+{
+    std::vector<glm::mat4> models(BENCH_INSTANCES);
+    unsigned int side = (unsigned int)ceil(sqrt((float)BENCH_INSTANCES));
+    for (unsigned int i = 0; i < BENCH_INSTANCES; i++)
+    {
+        glm::mat4 model = glm::mat4(1.0f);
+        model = glm::translate(model, glm::vec3((float)(i % side) - side * 0.5f, (float)(i / side) - side * 0.5f, -60.0f));
+        models[i] = glm::scale(model, glm::vec3(0.5f));
+    }
+    const glm::mat4 &view = frame.view;
+    const glm::mat4 &projection = frame.projection;
+
+    // VAO path: one uniform upload + one draw call per cube
+    vaoShader.use();
+    vaoShader.setMat4("view", view);
+    vaoShader.setMat4("projection", projection);
+    vaoShader.flushUniforms();
+    glState().bindVertexArray(VAO);
+    glFinish();
+    double start = glfwGetTime();
+    for (unsigned int frame = 0; frame < BENCH_FRAMES; frame++)
+    {
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        int modelLocation = glGetUniformLocation(vaoShader.ID, "model");
+        for (unsigned int i = 0; i < BENCH_INSTANCES; i++)
+        {
+            glUniformMatrix4fv(modelLocation, 1, GL_FALSE, glm::value_ptr(models[i]));
+            glDrawArrays(GL_TRIANGLES, 0, 36);
+        }
+        glFinish();
+    }
+    double vaoTime = (glfwGetTime() - start) * 1000.0 / BENCH_FRAMES;
+    vaoShader.invalidateUniforms(); // model went to GL around the shadow
+
+    // pulling path: matrices uploaded into the instance SSBO every frame, one instanced draw
+    glState().bindBuffer(GL_SHADER_STORAGE_BUFFER, instanceSSBO);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, models.size() * sizeof(glm::mat4), NULL, GL_DYNAMIC_DRAW);
+    pullShader.use();
+    pullShader.setMat4("view", view);
+    pullShader.setMat4("projection", projection);
+    pullShader.setInt("instanceOffset", 0);
+    pullShader.flushUniforms();
+    meshPool.bind();
+    glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, INSTANCE_BINDING, instanceSSBO);
+    glFinish();
+    start = glfwGetTime();
+    for (unsigned int frame = 0; frame < BENCH_FRAMES; frame++)
+    {
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, models.size() * sizeof(glm::mat4), models.data());
+        meshPool.draw(0, BENCH_INSTANCES);
+        glFinish();
+    }
+    double pullTime = (glfwGetTime() - start) * 1000.0 / BENCH_FRAMES;
+
+    std::cout << "BENCHMARK " << BENCH_INSTANCES << " cubes (" << glGetString(GL_RENDERER) << ")" << std::endl;
+    std::cout << "  VAO path:      " << vaoTime << " ms/frame, " << BENCH_INSTANCES << " draw calls" << std::endl;
+    std::cout << "  vertex pulling: " << pullTime << " ms/frame, 1 draw call" << std::endl;
+
+    // shrink the buffer back to what the demo needs
+    glBufferData(GL_SHADER_STORAGE_BUFFER, INSTANCE_CAPACITY * sizeof(glm::mat4), NULL, GL_DYNAMIC_DRAW);
+    glState().bindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+//--------------------------------------------------------------------------------------------------
+// SPIN_BENCH_INSTANCES spinning cubes in a grid in front of the camera, SPIN_BENCH_FRAMES frames each way:
+//   cpu: rotation of every cube + TransformStore::compose into the matrices, upload, one pulled draw
+//   gpu: only the time uniform changes, 4.3.spin.vert builds the rotations from the static SSBO
+// Prints the cpu time until the frame is issued and the whole frame (glFinish) for both.
+void runSpinBenchmark(const Shader &pullShader, const Shader &spinShader, const MeshPool &meshPool, unsigned int instanceSSBO, const FrameState &frame)
+{
+    unsigned int side = (unsigned int)ceil(sqrt((float)SPIN_BENCH_INSTANCES));
+    TransformStore store;
+    std::vector<SpinInstance> spins(SPIN_BENCH_INSTANCES);
+    std::vector<glm::vec3> axes(SPIN_BENCH_INSTANCES);
+    std::vector<float> speeds(SPIN_BENCH_INSTANCES), phases(SPIN_BENCH_INSTANCES);
+    srand(7);
+    for (unsigned int i = 0; i < SPIN_BENCH_INSTANCES; i++)
+    {
+        glm::vec3 position((float)(i % side) - side * 0.5f, (float)(i / side) - side * 0.5f, -60.0f);
+        axes[i] = glm::normalize(glm::vec3((float)rand() / RAND_MAX, (float)rand() / RAND_MAX, (float)rand() / RAND_MAX) + 0.1f);
+        speeds[i] = glm::radians(50.0f + 100.0f * rand() / RAND_MAX);
+        phases[i] = 6.2831853f * rand() / RAND_MAX;
+        store.add(position, glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(0.5f));
+        spins[i].positionScale = glm::vec4(position, 0.5f);
+        spins[i].axisSpeed = glm::vec4(axes[i], speeds[i]);
+        spins[i].phase = phases[i];
+    }
+    std::vector<glm::mat4> models(SPIN_BENCH_INSTANCES);
+
+    // cpu path, the same work the cubes do every frame with M off
+    glState().bindBuffer(GL_SHADER_STORAGE_BUFFER, instanceSSBO);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, models.size() * sizeof(glm::mat4), NULL, GL_DYNAMIC_DRAW);
+    pullShader.use();
+    pullShader.setMat4("view", frame.view);
+    pullShader.setMat4("projection", frame.projection);
+    pullShader.setInt("instanceOffset", 0);
+    pullShader.flushUniforms();
+    meshPool.bind();
+    glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, INSTANCE_BINDING, instanceSSBO);
+    glFinish();
+    double cpuIssue = 0.0, start = glfwGetTime();
+    for (unsigned int frame = 0; frame < SPIN_BENCH_FRAMES; frame++)
+    {
+        double frameStart = glfwGetTime();
+        float time = frame / 60.0f;
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        for (unsigned int i = 0; i < SPIN_BENCH_INSTANCES; i++)
+            store.setRotation(i, glm::angleAxis(time * speeds[i] + phases[i], axes[i]));
+        store.compose(0, SPIN_BENCH_INSTANCES, models.data());
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, models.size() * sizeof(glm::mat4), models.data());
+        meshPool.draw(0, SPIN_BENCH_INSTANCES);
+        cpuIssue += glfwGetTime() - frameStart;
+        glFinish();
+    }
+    double cpuFrame = (glfwGetTime() - start) * 1000.0 / SPIN_BENCH_FRAMES;
+    cpuIssue *= 1000.0 / SPIN_BENCH_FRAMES;
+    // shrink the buffer back to what the demo needs
+    glBufferData(GL_SHADER_STORAGE_BUFFER, INSTANCE_CAPACITY * sizeof(glm::mat4), NULL, GL_DYNAMIC_DRAW);
+
+    // gpu path, the parameters are uploaded once
+    unsigned int benchSpinSSBO;
+    glGenBuffers(1, &benchSpinSSBO);
+    glState().bindBuffer(GL_SHADER_STORAGE_BUFFER, benchSpinSSBO);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, spins.size() * sizeof(SpinInstance), spins.data(), GL_STATIC_DRAW);
+    glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, SPIN_BINDING, benchSpinSSBO);
+    spinShader.use();
+    spinShader.setMat4("view", frame.view);
+    spinShader.setMat4("projection", frame.projection);
+    spinShader.setInt("instanceOffset", 0);
+    spinShader.flushUniforms();
+    glFinish();
+    double gpuIssue = 0.0;
+    start = glfwGetTime();
+    for (unsigned int frame = 0; frame < SPIN_BENCH_FRAMES; frame++)
+    {
+        double frameStart = glfwGetTime();
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        spinShader.setFloat("time", frame / 60.0f);
+        spinShader.flushUniforms();
+        meshPool.draw(0, SPIN_BENCH_INSTANCES);
+        gpuIssue += glfwGetTime() - frameStart;
+        glFinish();
+    }
+    double gpuFrame = (glfwGetTime() - start) * 1000.0 / SPIN_BENCH_FRAMES;
+    gpuIssue *= 1000.0 / SPIN_BENCH_FRAMES;
+    glState().deleteBuffers(1, &benchSpinSSBO);
+    glState().bindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    std::cout << "SPIN BENCHMARK " << SPIN_BENCH_INSTANCES << " spinning cubes (" << glGetString(GL_RENDERER) << ")" << std::endl;
+    std::cout << "  cpu matrices: " << cpuIssue << " ms cpu, " << cpuFrame << " ms/frame, " << models.size() * sizeof(glm::mat4) / (1024 * 1024)
+              << " MB uploaded per frame" << std::endl;
+    std::cout << "  gpu spin:     " << gpuIssue << " ms cpu, " << gpuFrame << " ms/frame, nothing uploaded (" << spins.size() * sizeof(SpinInstance) / (1024 * 1024)
+              << " MB of parameters once)" << std::endl;
+}
+
+//--------------------------------------------------------------------------------------------------
+// CULL_BENCH_OBJECTS random boxes around the camera: BVH build, refit after every box moved, and the
+// culling itself (BVH vs testing every box with Frustum::intersects), averaged over CULL_BENCH_FRAMES.
+void runCullingBenchmark()
+{
+    std::vector<glm::vec3> boundsMin(CULL_BENCH_OBJECTS), boundsMax(CULL_BENCH_OBJECTS);
+    srand(1);
+    for (unsigned int i = 0; i < CULL_BENCH_OBJECTS; i++)
+    {
+        glm::vec3 offset((float)rand() / RAND_MAX, (float)rand() / RAND_MAX, (float)rand() / RAND_MAX);
+        glm::vec3 center = camera.Position + (offset - 0.5f) * 200.0f;
+        boundsMin[i] = center - 0.5f;
+        boundsMax[i] = center + 0.5f;
+    }
+    glm::mat4 view = camera.GetViewMatrix();
+    glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+    Frustum frustum(projection * view);
+
+    SceneBvh bvh;
+    double start = glfwGetTime();
+    bvh.build(boundsMin, boundsMax);
+    double buildTime = (glfwGetTime() - start) * 1000.0;
+
+    // every box drifts a little each frame, like the spinning cubes in the scene
+    start = glfwGetTime();
+    for (unsigned int frame = 0; frame < CULL_BENCH_FRAMES; frame++)
+    {
+        glm::vec3 drift(frame % 2 ? 0.01f : -0.01f);
+        for (unsigned int i = 0; i < CULL_BENCH_OBJECTS; i++)
+        {
+            boundsMin[i] += drift;
+            boundsMax[i] += drift;
+            bvh.update(i, boundsMin[i], boundsMax[i]);
+        }
+        bvh.refit();
+    }
+    double refitTime = (glfwGetTime() - start) * 1000.0 / CULL_BENCH_FRAMES;
+
+    std::vector<unsigned int> visible;
+    visible.reserve(CULL_BENCH_OBJECTS);
+    start = glfwGetTime();
+    for (unsigned int frame = 0; frame < CULL_BENCH_FRAMES; frame++)
+    {
+        visible.clear();
+        bvh.cull(frustum, visible);
+    }
+    double bvhTime = (glfwGetTime() - start) * 1000.0 / CULL_BENCH_FRAMES;
+    size_t bvhVisible = visible.size();
+
+    start = glfwGetTime();
+    for (unsigned int frame = 0; frame < CULL_BENCH_FRAMES; frame++)
+    {
+        visible.clear();
+        for (unsigned int i = 0; i < CULL_BENCH_OBJECTS; i++)
+        {
+            if (frustum.intersects(boundsMin[i], boundsMax[i]))
+                visible.push_back(i);
+        }
+    }
+    double bruteTime = (glfwGetTime() - start) * 1000.0 / CULL_BENCH_FRAMES;
+
+#if defined(__AVX2__)
+    const char *simd = "AVX2";
+#else
+    const char *simd = "scalar";
+#endif
+    std::cout << "CULLING BENCHMARK " << CULL_BENCH_OBJECTS << " boxes (" << simd << ", " << bvh.nodes.size() << " BVH nodes)" << std::endl;
+    std::cout << "  build:          " << buildTime << " ms" << std::endl;
+    std::cout << "  update + refit: " << refitTime << " ms/frame" << std::endl;
+    std::cout << "  BVH cull:       " << bvhTime << " ms/frame, " << bvh.nodesTested << " nodes tested" << std::endl;
+    std::cout << "  test every box: " << bruteTime << " ms/frame" << std::endl;
+    std::cout << "  visible: " << bvhVisible << " (every box: " << visible.size() << "), "
+              << 100.0 * (1.0 - (double)bvhVisible / CULL_BENCH_OBJECTS) << "% of the instances never submitted" << std::endl;
+}
+
+//--------------------------------------------------------------------------------------------------
+// a dense OCCLUSION_FIELD_SIDE^3 field of spinning cubes in front of the camera, frustum culled with the
+// BVH, then occlusion culled with the nearest cubes as occluders. Runs single threaded and with every
+// core to show the rasterizer scaling, prints the occluded fraction and the cost per frame.
+void runOcclusionBenchmark(OcclusionCuller &culler, unsigned int cubeOccluder)
+{
+    const unsigned int count = OCCLUSION_FIELD_SIDE * OCCLUSION_FIELD_SIDE * OCCLUSION_FIELD_SIDE;
+    std::vector<glm::mat4> models(count);
+    std::vector<glm::vec3> boundsMin(count), boundsMax(count);
+    srand(3);
+    for (unsigned int i = 0; i < count; i++)
+    {
+        glm::vec3 cell((float)(i % OCCLUSION_FIELD_SIDE), (float)(i / OCCLUSION_FIELD_SIDE % OCCLUSION_FIELD_SIDE), (float)(i / (OCCLUSION_FIELD_SIDE * OCCLUSION_FIELD_SIDE)));
+        glm::vec3 position = camera.Position + glm::vec3((cell.x - OCCLUSION_FIELD_SIDE * 0.5f) * 1.5f, (cell.y - OCCLUSION_FIELD_SIDE * 0.5f) * 1.5f, -3.0f - cell.z * 1.5f);
+        models[i] = glm::rotate(glm::translate(glm::mat4(1.0f), position), (float)rand() / RAND_MAX * 6.28f, glm::vec3(1.0f, 0.3f, 0.5f));
+        transformBounds(models[i], CUBE_MIN, CUBE_MAX, boundsMin[i], boundsMax[i]);
+    }
+    glm::mat4 viewProjection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f) * camera.GetViewMatrix();
+    SceneBvh bvh;
+    bvh.build(boundsMin, boundsMax);
+    std::vector<unsigned int> visible;
+    bvh.cull(Frustum(viewProjection), visible);
+
+    unsigned int savedThreads = culler.threadCount, savedOccluders = culler.maxOccluders;
+    FrameArena *savedArena = culler.arena;
+    culler.maxOccluders = 64;
+    culler.arena = nullptr; // its own arena, reset every benchmark frame
+    std::cout << "OCCLUSION BENCHMARK " << count << " cubes, " << visible.size() << " in the frustum, " << culler.maxOccluders << " occluders" << std::endl;
+    for (unsigned int threads = 1; threads <= savedThreads; threads = threads == savedThreads ? threads + 1 : savedThreads)
+    {
+        culler.threadCount = threads;
+        double rasterMs = 0.0, testMs = 0.0;
+        unsigned int occluded = 0;
+        for (unsigned int frame = 0; frame < BENCH_FRAMES; frame++)
+        {
+            culler.beginFrame(viewProjection, camera.Position);
+            for (unsigned int id : visible)
+                culler.addOccluder(cubeOccluder, models[id], boundsMin[id], boundsMax[id]);
+            culler.rasterize();
+            for (unsigned int id : visible)
+                culler.isVisible(boundsMin[id], boundsMax[id]);
+            rasterMs += culler.rasterMs;
+            testMs += culler.testMs;
+            occluded = culler.objectsOccluded;
+        }
+        std::cout << "  " << threads << " thread(s): raster " << rasterMs / BENCH_FRAMES << " ms, test " << testMs / BENCH_FRAMES << " ms, "
+                  << occluded << " occluded (" << 100.0 * occluded / std::max<size_t>(1, visible.size()) << "% of the frustum survivors)" << std::endl;
+    }
+    culler.threadCount = savedThreads;
+    culler.maxOccluders = savedOccluders;
+    culler.arena = savedArena;
+}
+
+//--------------------------------------------------------------------------------------------------
+// GPU_CULL_INSTANCES static cubes around the camera drawn BENCH_FRAMES times with
+//  - CPU culling: BVH cull, copy the visible matrices, upload them, one instanced draw
+//  - GPU culling: compute pass + glDrawElementsIndirect, the matrices were uploaded once
+// "cpu" is the time until the frame's commands are issued, "frame" includes glFinish.
+void runGpuCullingBenchmark(const Shader &pullShader, const ComputeShader &cullShader, const MeshPool &meshPool, unsigned int cubeMesh, const FrameState &frame)
+{
+    std::vector<glm::mat4> models(GPU_CULL_INSTANCES);
+    std::vector<glm::vec3> boundsMin(GPU_CULL_INSTANCES), boundsMax(GPU_CULL_INSTANCES);
+    srand(2);
+    for (unsigned int i = 0; i < GPU_CULL_INSTANCES; i++)
+    {
+        glm::vec3 offset((float)rand() / RAND_MAX, (float)rand() / RAND_MAX, (float)rand() / RAND_MAX);
+        glm::mat4 model = glm::translate(glm::mat4(1.0f), frame.camera.Position + (offset - 0.5f) * 200.0f);
+        models[i] = glm::rotate(model, (float)rand() / RAND_MAX * 6.28f, glm::vec3(1.0f, 0.3f, 0.5f));
+        transformBounds(models[i], CUBE_MIN, CUBE_MAX, boundsMin[i], boundsMax[i]);
+    }
+    const glm::mat4 &view = frame.view;
+    const glm::mat4 &projection = frame.projection;
+    Frustum frustum(projection * view);
+
+    pullShader.use();
+    pullShader.setMat4("view", view);
+    pullShader.setMat4("projection", projection);
+    pullShader.setInt("instanceOffset", 0);
+    pullShader.flushUniforms();
+    meshPool.bind();
+
+    // CPU path
+    SceneBvh bvh;
+    bvh.build(boundsMin, boundsMax);
+    std::vector<unsigned int> visible;
+    std::vector<glm::mat4> visibleModels;
+    visible.reserve(GPU_CULL_INSTANCES);
+    visibleModels.reserve(GPU_CULL_INSTANCES);
+    unsigned int visibleSSBO;
+    glGenBuffers(1, &visibleSSBO);
+    glState().bindBuffer(GL_SHADER_STORAGE_BUFFER, visibleSSBO);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, GPU_CULL_INSTANCES * sizeof(glm::mat4), NULL, GL_STREAM_DRAW);
+    glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, INSTANCE_BINDING, visibleSSBO);
+    double cpuIssue = 0.0, cpuCull = 0.0;
+    glFinish();
+    double start = glfwGetTime();
+    for (unsigned int frame = 0; frame < BENCH_FRAMES; frame++)
+    {
+        double frameStart = glfwGetTime();
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        visible.clear();
+        visibleModels.clear();
+        bvh.cull(frustum, visible);
+        for (unsigned int id : visible)
+            visibleModels.push_back(models[id]);
+        cpuCull += glfwGetTime() - frameStart;
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, visibleModels.size() * sizeof(glm::mat4), visibleModels.data());
+        meshPool.draw(cubeMesh, (unsigned int)visibleModels.size());
+        cpuIssue += glfwGetTime() - frameStart;
+        glFinish();
+    }
+    double cpuFrame = (glfwGetTime() - start) * 1000.0 / BENCH_FRAMES;
+    cpuIssue *= 1000.0 / BENCH_FRAMES;
+    cpuCull *= 1000.0 / BENCH_FRAMES;
+    glState().deleteBuffers(1, &visibleSSBO);
+
+    // GPU path
+    GpuCuller culler;
+    culler.init(meshPool.meshes[cubeMesh], GPU_CULL_INSTANCES);
+    culler.upload(models);
+    double gpuIssue = 0.0;
+    glFinish();
+    start = glfwGetTime();
+    for (unsigned int frame = 0; frame < BENCH_FRAMES; frame++)
+    {
+        double frameStart = glfwGetTime();
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        culler.cull(cullShader, frustum, CUBE_MIN, CUBE_MAX, INSTANCE_BINDING);
+        pullShader.use();
+        meshPool.bind();
+        culler.draw(INSTANCE_BINDING);
+        gpuIssue += glfwGetTime() - frameStart;
+        glFinish();
+    }
+    double gpuFrame = (glfwGetTime() - start) * 1000.0 / BENCH_FRAMES;
+    gpuIssue *= 1000.0 / BENCH_FRAMES;
+
+    // only for this printout, the frames above never read anything back
+    DrawElementsIndirectCommand command;
+    glState().bindBuffer(GL_DRAW_INDIRECT_BUFFER, culler.commandBuffer);
+    glGetBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, sizeof(command), &command);
+    glState().bindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    culler.release();
+
+    std::cout << "GPU CULLING BENCHMARK " << GPU_CULL_INSTANCES << " cubes (" << glGetString(GL_RENDERER) << ")" << std::endl;
+    std::cout << "  CPU cull + upload: cpu " << cpuIssue << " ms (cull + copy " << cpuCull << " ms), frame " << cpuFrame << " ms, " << visible.size() << " visible" << std::endl;
+    std::cout << "  compute + indirect: cpu " << gpuIssue << " ms, frame " << gpuFrame << " ms, " << command.instanceCount << " visible" << std::endl;
+}
+
+//--------------------------------------------------------------------------------------------------
+// RECORD_BENCH_OBJECTS spinning cubes around the camera: every visible one is recorded as a packet with its
+// model matrix and sort key. The objects are split into one chunk per thread, each chunk is recorded into
+// its own CommandBuffer on a JobSystem with that many workers (recordParallel, the system is started before
+// the timing), then the buffers are merged into a RenderQueue and sorted. Nothing is drawn, so this runs on
+// the main thread and only measures the cpu side for 1 to N threads.
+void runRecordingBenchmark(const Shader &shader, unsigned int VAO, unsigned int texture1, unsigned int texture2)
+{
+    std::vector<glm::vec3> centers(RECORD_BENCH_OBJECTS);
+    srand(3);
+    for (unsigned int i = 0; i < RECORD_BENCH_OBJECTS; i++)
+    {
+        glm::vec3 offset((float)rand() / RAND_MAX, (float)rand() / RAND_MAX, (float)rand() / RAND_MAX);
+        centers[i] = camera.Position + (offset - 0.5f) * 100.0f;
+    }
+    glm::mat4 view = camera.GetViewMatrix();
+    glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+    Frustum frustum(projection * view);
+    glm::vec3 eye = camera.Position;
+
+    auto record = [&](CommandBuffer &buffer, unsigned int first, unsigned int last, float time)
+    {
+        for (unsigned int i = first; i < last; i++)
+        {
+            glm::mat4 model = glm::translate(glm::mat4(1.0f), centers[i]);
+            model = glm::rotate(model, glm::radians(time * 100.0f + i), glm::vec3(1.0f, 0.3f, 0.5f));
+            glm::vec3 boundsMin, boundsMax;
+            transformBounds(model, glm::vec3(-0.5f), glm::vec3(0.5f), boundsMin, boundsMax);
+            if (!frustum.intersects(boundsMin, boundsMax))
+                continue;
+            DrawPacket packet;
+            packet.shader = &shader;
+            packet.VAO = VAO;
+            packet.count = 36;
+            packet.model = buffer.addModel(model);
+            packet.textures[0] = texture1;
+            packet.textures[1] = texture2;
+            buffer.add(RENDER_PASS_OPAQUE, texture1, 0, glm::length(centers[i] - eye), packet);
+        }
+    };
+
+    unsigned int maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<unsigned int> threadCounts;
+    for (unsigned int threads = 1; threads < maxThreads; threads *= 2)
+        threadCounts.push_back(threads);
+    threadCounts.push_back(maxThreads);
+
+    std::cout << "RECORDING BENCHMARK " << RECORD_BENCH_OBJECTS << " objects, " << RECORD_BENCH_FRAMES << " frames per thread count" << std::endl;
+    RenderQueue queue;
+    double singleThreadMs = 0.0;
+    for (unsigned int threads : threadCounts)
+    {
+        std::vector<CommandBuffer> buffers(threads);
+        JobSystem jobs(threads);
+        double recordMs = 0.0, mergeMs = 0.0, sortMs = 0.0;
+        for (unsigned int frame = 0; frame < RECORD_BENCH_FRAMES; frame++)
+        {
+            float time = frame / 60.0f;
+            auto start = std::chrono::high_resolution_clock::now();
+            recordParallel(jobs, buffers, RECORD_BENCH_OBJECTS, [&](CommandBuffer &buffer, unsigned int first, unsigned int last)
+                           { record(buffer, first, last, time); });
+            auto recorded = std::chrono::high_resolution_clock::now();
+            queue.clear();
+            for (const CommandBuffer &buffer : buffers)
+                queue.append(buffer);
+            auto merged = std::chrono::high_resolution_clock::now();
+            queue.sort();
+            recordMs += std::chrono::duration<double, std::milli>(recorded - start).count();
+            mergeMs += std::chrono::duration<double, std::milli>(merged - recorded).count();
+            sortMs += queue.sortMs;
+        }
+        recordMs /= RECORD_BENCH_FRAMES;
+        mergeMs /= RECORD_BENCH_FRAMES;
+        sortMs /= RECORD_BENCH_FRAMES;
+        if (threads == 1)
+            singleThreadMs = recordMs;
+        std::cout << "  " << threads << " thread(s): record " << recordMs << " ms (x" << singleThreadMs / recordMs << "), merge "
+                  << mergeMs << " ms, sort " << sortMs << " ms, " << queue.packets.size() << " packets" << std::endl;
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+// One simulated frame as a job graph, JOB_BENCH_FRAMES times for 1 to N workers (a JobSystem each):
+//   transforms (model matrix + world box of JOB_BENCH_OBJECTS spinning cubes) -> frustum culling
+//   light projection (screen rectangle of JOB_BENCH_LIGHTS moving point lights) -> binning into tiles
+// The two chains only meet at the end, the arrows are dependencies. Prints ms/frame, jobs, steals and how
+// busy every worker was.
+void runJobBenchmark()
+{
+    std::vector<glm::vec3> centers(JOB_BENCH_OBJECTS), lightCenters(JOB_BENCH_LIGHTS);
+    srand(4);
+    for (glm::vec3 &center : centers)
+        center = camera.Position + (glm::vec3((float)rand() / RAND_MAX, (float)rand() / RAND_MAX, (float)rand() / RAND_MAX) - 0.5f) * 100.0f;
+    for (glm::vec3 &center : lightCenters)
+        center = camera.Position + (glm::vec3((float)rand() / RAND_MAX, (float)rand() / RAND_MAX, (float)rand() / RAND_MAX) - 0.5f) * 60.0f;
+    std::vector<glm::mat4> models(JOB_BENCH_OBJECTS);
+    std::vector<glm::vec3> boundsMin(JOB_BENCH_OBJECTS), boundsMax(JOB_BENCH_OBJECTS);
+    std::vector<char> visible(JOB_BENCH_OBJECTS);
+    std::vector<glm::vec4> lightRects(JOB_BENCH_LIGHTS); // pixels, x0 y0 x1 y1, empty behind the camera
+    const unsigned int tilesX = (SCR_WIDTH + LIGHT_TILE_SIZE - 1) / LIGHT_TILE_SIZE;
+    const unsigned int tilesY = (SCR_HEIGHT + LIGHT_TILE_SIZE - 1) / LIGHT_TILE_SIZE;
+    std::vector<unsigned int> tileCounts(tilesX * tilesY);
+    std::vector<unsigned short> tileLights(tilesX * tilesY * MAX_LIGHTS_PER_TILE);
+
+    glm::mat4 view = camera.GetViewMatrix();
+    glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+    glm::mat4 viewProjection = projection * view;
+    Frustum frustum(viewProjection);
+    const float lightRadius = 3.0f;
+    const float pixelsPerUnit = SCR_HEIGHT / (2.0f * tan(glm::radians(camera.Zoom) * 0.5f));
+
+    unsigned int maxWorkers = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<unsigned int> workerCounts;
+    for (unsigned int workers = 1; workers < maxWorkers; workers *= 2)
+        workerCounts.push_back(workers);
+    workerCounts.push_back(maxWorkers);
+
+    std::cout << "JOB SYSTEM BENCHMARK " << JOB_BENCH_OBJECTS << " objects (transform -> cull), " << JOB_BENCH_LIGHTS << " lights (project -> bin into "
+              << tilesX * tilesY << " tiles), " << JOB_BENCH_FRAMES << " frames" << std::endl;
+    double singleWorkerMs = 0.0;
+    for (unsigned int workers : workerCounts)
+    {
+        JobSystem jobs(workers);
+        std::vector<float> utilization;
+        unsigned long long executed = 0, stolen = 0;
+        jobs.sampleStats(utilization, executed, stolen);
+        float time = 0.0f;
+        auto transform = [&](unsigned int first, unsigned int last)
+        {
+            for (unsigned int i = first; i < last; i++)
+            {
+                models[i] = glm::rotate(glm::translate(glm::mat4(1.0f), centers[i]), glm::radians(time * 100.0f + i), glm::vec3(1.0f, 0.3f, 0.5f));
+                transformBounds(models[i], glm::vec3(-0.5f), glm::vec3(0.5f), boundsMin[i], boundsMax[i]);
+            }
+        };
+        auto cull = [&](unsigned int first, unsigned int last)
+        {
+            for (unsigned int i = first; i < last; i++)
+                visible[i] = frustum.intersects(boundsMin[i], boundsMax[i]) ? 1 : 0;
+        };
+        auto project = [&](unsigned int first, unsigned int last)
+        {
+            for (unsigned int i = first; i < last; i++)
+            {
+                glm::vec3 position = lightCenters[i] + glm::vec3(sin(time + i), 0.0f, cos(time + i)) * 2.0f;
+                glm::vec4 clip = viewProjection * glm::vec4(position, 1.0f);
+                if (clip.w < 0.1f)
+                {
+                    lightRects[i] = glm::vec4(1.0f, 1.0f, 0.0f, 0.0f);
+                    continue;
+                }
+                float x = (clip.x / clip.w * 0.5f + 0.5f) * SCR_WIDTH;
+                float y = (clip.y / clip.w * 0.5f + 0.5f) * SCR_HEIGHT;
+                float radius = lightRadius * pixelsPerUnit / clip.w;
+                lightRects[i] = glm::vec4(x - radius, y - radius, x + radius, y + radius);
+            }
+        };
+        auto bin = [&](unsigned int first, unsigned int last)
+        {
+            for (unsigned int tile = first; tile < last; tile++)
+            {
+                float x0 = (float)(tile % tilesX * LIGHT_TILE_SIZE), y0 = (float)(tile / tilesX * LIGHT_TILE_SIZE);
+                float x1 = x0 + LIGHT_TILE_SIZE, y1 = y0 + LIGHT_TILE_SIZE;
+                unsigned int count = 0;
+                for (unsigned int i = 0; i < JOB_BENCH_LIGHTS && count < MAX_LIGHTS_PER_TILE; i++)
+                {
+                    const glm::vec4 &rect = lightRects[i];
+                    if (rect.x < x1 && rect.z > x0 && rect.y < y1 && rect.w > y0)
+                        tileLights[tile * MAX_LIGHTS_PER_TILE + count++] = (unsigned short)i;
+                }
+                tileCounts[tile] = count;
+            }
+        };
+
+        auto start = std::chrono::high_resolution_clock::now();
+        for (unsigned int frame = 0; frame < JOB_BENCH_FRAMES; frame++)
+        {
+            time = frame / 60.0f;
+            Job *transforms = jobs.createParallelFor(JOB_BENCH_OBJECTS, transform);
+            Job *culling = jobs.createParallelFor(JOB_BENCH_OBJECTS, cull);
+            Job *lights = jobs.createParallelFor(JOB_BENCH_LIGHTS, project, 16);
+            Job *binning = jobs.createParallelFor(tilesX * tilesY, bin, 4);
+            jobs.addDependency(transforms, culling);
+            jobs.addDependency(lights, binning);
+            jobs.run(transforms);
+            jobs.run(culling);
+            jobs.run(lights);
+            jobs.run(binning);
+            jobs.wait(culling);
+            jobs.wait(binning);
+        }
+        double frameMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / JOB_BENCH_FRAMES;
+        jobs.sampleStats(utilization, executed, stolen);
+        if (workers == 1)
+            singleWorkerMs = frameMs;
+
+        unsigned int visibleCount = (unsigned int)std::count(visible.begin(), visible.end(), 1);
+        unsigned long long binned = 0;
+        for (unsigned int count : tileCounts)
+            binned += count;
+        std::cout << "  " << workers << " worker(s): " << frameMs << " ms/frame (x" << singleWorkerMs / frameMs << "), "
+                  << executed / JOB_BENCH_FRAMES << " jobs/frame, " << stolen / JOB_BENCH_FRAMES << " stolen, " << visibleCount << " visible, "
+                  << binned << " light/tile pairs, utilization";
+        for (float busy : utilization)
+            std::cout << " " << (int)(busy * 100.0f + 0.5f) << "%";
+        std::cout << std::endl;
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+// TRANSFORM_BENCH_OBJECTS random objects (position, axis/angle rotation, scale), their world matrices
+// TRANSFORM_BENCH_FRAMES times with:
+//   glm:          translate * rotate(angle, axis) * scale per object, like the cubes used to do
+//   glm quat:     translate * mat4_cast(q) * scale per object, same inputs as the kernel but AoS and scalar
+//   SoA kernel:   TransformStore::compose over the whole store
+// Prints matrices per second and the largest difference to the glm matrices.
+void runTransformBenchmark()
+{
+    std::vector<glm::vec3> positions(TRANSFORM_BENCH_OBJECTS), axes(TRANSFORM_BENCH_OBJECTS), scales(TRANSFORM_BENCH_OBJECTS);
+    std::vector<float> angles(TRANSFORM_BENCH_OBJECTS);
+    std::vector<glm::quat> rotations(TRANSFORM_BENCH_OBJECTS);
+    TransformStore store;
+    srand(5);
+    for (unsigned int i = 0; i < TRANSFORM_BENCH_OBJECTS; i++)
+    {
+        positions[i] = (glm::vec3((float)rand() / RAND_MAX, (float)rand() / RAND_MAX, (float)rand() / RAND_MAX) - 0.5f) * 100.0f;
+        axes[i] = glm::normalize(glm::vec3((float)rand() / RAND_MAX, (float)rand() / RAND_MAX, (float)rand() / RAND_MAX) + 0.1f);
+        angles[i] = (float)rand() / RAND_MAX * 6.2831853f;
+        scales[i] = glm::vec3((float)rand() / RAND_MAX, (float)rand() / RAND_MAX, (float)rand() / RAND_MAX) * 1.5f + 0.5f;
+        rotations[i] = glm::angleAxis(angles[i], axes[i]);
+        store.add(positions[i], rotations[i], scales[i]);
+    }
+    std::vector<glm::mat4> reference(TRANSFORM_BENCH_OBJECTS), models(TRANSFORM_BENCH_OBJECTS);
+
+    double start = glfwGetTime();
+    for (unsigned int frame = 0; frame < TRANSFORM_BENCH_FRAMES; frame++)
+    {
+        for (unsigned int i = 0; i < TRANSFORM_BENCH_OBJECTS; i++)
+        {
+            glm::mat4 model = glm::mat4(1.0f);
+            model = glm::translate(model, positions[i]);
+            model = glm::rotate(model, angles[i], axes[i]);
+            reference[i] = glm::scale(model, scales[i]);
+        }
+    }
+    double glmTime = (glfwGetTime() - start) / TRANSFORM_BENCH_FRAMES;
+
+    start = glfwGetTime();
+    for (unsigned int frame = 0; frame < TRANSFORM_BENCH_FRAMES; frame++)
+    {
+        for (unsigned int i = 0; i < TRANSFORM_BENCH_OBJECTS; i++)
+            models[i] = glm::scale(glm::translate(glm::mat4(1.0f), positions[i]) * glm::mat4_cast(rotations[i]), scales[i]);
+    }
+    double quatTime = (glfwGetTime() - start) / TRANSFORM_BENCH_FRAMES;
+
+    start = glfwGetTime();
+    for (unsigned int frame = 0; frame < TRANSFORM_BENCH_FRAMES; frame++)
+        store.compose(0, store.size(), models.data());
+    double soaTime = (glfwGetTime() - start) / TRANSFORM_BENCH_FRAMES;
+
+    float maxError = 0.0f;
+    for (unsigned int i = 0; i < TRANSFORM_BENCH_OBJECTS; i++)
+    {
+        for (int column = 0; column < 4; column++)
+            maxError = std::max(maxError, glm::length(models[i][column] - reference[i][column]));
+    }
+
+#if defined(__AVX2__)
+    const char *simd = "AVX2, 8 per step";
+#else
+    const char *simd = "scalar";
+#endif
+    std::cout << "TRANSFORM BENCHMARK " << TRANSFORM_BENCH_OBJECTS << " objects, " << TRANSFORM_BENCH_FRAMES << " frames" << std::endl;
+    std::cout << "  glm translate/rotate/scale: " << glmTime * 1000.0 << " ms/frame, " << TRANSFORM_BENCH_OBJECTS / glmTime / 1e6 << " M matrices/s" << std::endl;
+    std::cout << "  glm quaternion:             " << quatTime * 1000.0 << " ms/frame, " << TRANSFORM_BENCH_OBJECTS / quatTime / 1e6 << " M matrices/s" << std::endl;
+    std::cout << "  SoA kernel (" << simd << "): " << soaTime * 1000.0 << " ms/frame, " << TRANSFORM_BENCH_OBJECTS / soaTime / 1e6 << " M matrices/s (x"
+              << glmTime / soaTime << " over glm)" << std::endl;
+    std::cout << "  largest difference to glm: " << maxError << std::endl;
+}
+
+//--------------------------------------------------------------------------------------------------
+// ECS_BENCH_ENTITIES entities of four kinds (spinning renderables, static renderables, point lights, bare
+// transforms) in a World, and the same objects as individually allocated structs with pointers to their
+// optional components, visited in shuffled order like a heap that has been alive for a while. Per frame:
+//   Transform + Spin:         move every spinning object a bit (writes)
+//   Transform + MeshRenderer: sum the renderable positions (reads)
+//   Transform + PointLight:   count the lights near the camera
+// Prints create time, ms/frame of each query for both layouts, then the cost of destroying half the world.
+void runEcsBenchmark()
+{
+    struct ObjectWithPointers
+    {
+        Transform transform;
+        Spin *spin = nullptr;
+        MeshRenderer *renderer = nullptr;
+        PointLight *light = nullptr;
+    };
+    std::vector<ObjectWithPointers *> objects;
+    World world;
+    std::vector<Entity> entities;
+    entities.reserve(ECS_BENCH_ENTITIES);
+    srand(6);
+    glm::vec3 center = camera.Position;
+    auto randomPosition = [&]()
+    {
+        return center + (glm::vec3((float)rand() / RAND_MAX, (float)rand() / RAND_MAX, (float)rand() / RAND_MAX) - 0.5f) * 200.0f;
+    };
+
+    double start = glfwGetTime();
+    for (unsigned int i = 0; i < ECS_BENCH_ENTITIES; i++)
+    {
+        Transform transform{randomPosition()};
+        if (i % 16 == 15)
+            entities.push_back(world.create(transform, PointLight{glm::vec3(0.0f), glm::vec3(0.05f), glm::vec3(0.8f), glm::vec3(1.0f), 1.0f, 0.09f, 0.032f}));
+        else if (i % 4 == 0)
+            entities.push_back(world.create(transform, Spin{glm::vec3(0.0f, 1.0f, 0.0f), 100.0f}, MeshRenderer{i}));
+        else if (i % 4 == 1 || i % 4 == 2)
+            entities.push_back(world.create(transform, MeshRenderer{i}));
+        else
+            entities.push_back(world.create(transform));
+    }
+    double createTime = glfwGetTime() - start;
+    for (Entity entity : entities)
+    {
+        ObjectWithPointers *object = new ObjectWithPointers;
+        object->transform = world.get<Transform>(entity);
+        if (world.has<Spin>(entity))
+            object->spin = new Spin(world.get<Spin>(entity));
+        if (world.has<MeshRenderer>(entity))
+            object->renderer = new MeshRenderer(world.get<MeshRenderer>(entity));
+        if (world.has<PointLight>(entity))
+            object->light = new PointLight(world.get<PointLight>(entity));
+        objects.push_back(object);
+    }
+    for (unsigned int i = (unsigned int)objects.size() - 1; i > 0; i--)
+        std::swap(objects[i], objects[rand() % (i + 1)]);
+
+    const float step = 0.001f, lightRange = 20.0f;
+    glm::vec3 ecsSum(0.0f), pointerSum(0.0f);
+    unsigned int ecsLights = 0, pointerLights = 0;
+    double ecsTimes[3] = {0.0, 0.0, 0.0}, pointerTimes[3] = {0.0, 0.0, 0.0};
+    for (unsigned int frame = 0; frame < ECS_BENCH_FRAMES; frame++)
+    {
+        start = glfwGetTime();
+        world.eachChunk<Transform, Spin>([&](unsigned int count, const Entity *, Transform *transforms, Spin *spins)
+                                         {
+                                             for (unsigned int i = 0; i < count; i++)
+                                                 transforms[i].position += spins[i].axis * step;
+                                         });
+        ecsTimes[0] += glfwGetTime() - start;
+        start = glfwGetTime();
+        ecsSum = glm::vec3(0.0f);
+        world.eachChunk<Transform, MeshRenderer>([&](unsigned int count, const Entity *, Transform *transforms, MeshRenderer *)
+                                                 {
+                                                     for (unsigned int i = 0; i < count; i++)
+                                                         ecsSum += transforms[i].position;
+                                                 });
+        ecsTimes[1] += glfwGetTime() - start;
+        start = glfwGetTime();
+        ecsLights = 0;
+        world.each<Transform, PointLight>([&](Entity, const Transform &transform, const PointLight &)
+                                          {
+                                              if (glm::length(transform.position - center) < lightRange)
+                                                  ecsLights++;
+                                          });
+        ecsTimes[2] += glfwGetTime() - start;
+
+        start = glfwGetTime();
+        for (ObjectWithPointers *object : objects)
+        {
+            if (object->spin)
+                object->transform.position += object->spin->axis * step;
+        }
+        pointerTimes[0] += glfwGetTime() - start;
+        start = glfwGetTime();
+        pointerSum = glm::vec3(0.0f);
+        for (ObjectWithPointers *object : objects)
+        {
+            if (object->renderer)
+                pointerSum += object->transform.position;
+        }
+        pointerTimes[1] += glfwGetTime() - start;
+        start = glfwGetTime();
+        pointerLights = 0;
+        for (ObjectWithPointers *object : objects)
+        {
+            if (object->light && glm::length(object->transform.position - center) < lightRange)
+                pointerLights++;
+        }
+        pointerTimes[2] += glfwGetTime() - start;
+    }
+
+    std::cout << "ECS BENCHMARK " << ECS_BENCH_ENTITIES << " entities, " << world.archetypeCount() << " archetypes, " << world.chunkCount() << " chunks of "
+              << ECS_CHUNK_SIZE << " bytes, created in " << createTime * 1000.0 << " ms" << std::endl;
+    const char *names[3] = {"Transform + Spin (write):  ", "Transform + MeshRenderer:  ", "Transform + PointLight:    "};
+    for (int query = 0; query < 3; query++)
+    {
+        double ecsMs = ecsTimes[query] * 1000.0 / ECS_BENCH_FRAMES, pointerMs = pointerTimes[query] * 1000.0 / ECS_BENCH_FRAMES;
+        std::cout << "  " << names[query] << ecsMs << " ms/frame, through pointers " << pointerMs << " ms/frame (x" << pointerMs / ecsMs << ")" << std::endl;
+    }
+    std::cout << "  results agree: " << (glm::length(ecsSum - pointerSum) <= 1e-3f * glm::length(pointerSum) && ecsLights == pointerLights ? "yes" : "NO")
+              << " (" << ecsLights << " lights in range)" << std::endl;
+
+    start = glfwGetTime();
+    for (unsigned int i = 0; i < entities.size(); i += 2)
+        world.destroy(entities[i]);
+    std::cout << "  destroyed every other entity in " << (glfwGetTime() - start) * 1000.0 << " ms, " << world.entityCount() << " left in "
+              << world.chunkCount() << " chunks" << std::endl;
+    for (ObjectWithPointers *object : objects)
+    {
+        delete object->spin;
+        delete object->renderer;
+        delete object->light;
+        delete object;
+    }
 }
 
 //--------------------------------------------------------------------------------------------------
 // glfw: whenever the window size changed (by OS or user resize) this callback function executes
 void framebuffer_size_callback(GLFWwindow *window, int width, int height)
 {
-    glViewport(0, 0, width, height);
+    // the callback runs on the main thread, the viewport is set by the render thread
+    pushRenderCommand({RENDER_RESIZE, 0, width, height});
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -447,4 +2993,35 @@ void scroll_callback(GLFWwindow *window, double xoffset, double yoffset)
     camera.ProcessMouseScroll(static_cast<float>(yoffset));
 }
 
-//--------------------------------------------------------------------------------------------------
\ No newline at end of file
+//--------------------------------------------------------------------------------------------------
+
+//--------------------------------------------------------------------------------------------------
+// uv sphere of radius 0.5 in the position(3) normal(3) texcoord(2) layout, indexed
+void buildSphere(unsigned int stacks, unsigned int slices, std::vector<float> &vertices, std::vector<unsigned int> &indices)
+{
+    const float PI = 3.14159265359f;
+    for (unsigned int i = 0; i <= stacks; i++)
+    {
+        float theta = PI * i / stacks;
+        for (unsigned int j = 0; j <= slices; j++)
+        {
+            float phi = 2.0f * PI * j / slices;
+            glm::vec3 normal(sin(theta) * cos(phi), cos(theta), sin(theta) * sin(phi));
+            float vertex[8] = {normal.x * 0.5f, normal.y * 0.5f, normal.z * 0.5f, normal.x, normal.y, normal.z,
+                               (float)j / slices, 1.0f - (float)i / stacks};
+            vertices.insert(vertices.end(), vertex, vertex + 8);
+        }
+    }
+    for (unsigned int i = 0; i < stacks; i++)
+    {
+        for (unsigned int j = 0; j < slices; j++)
+        {
+            unsigned int a = i * (slices + 1) + j;
+            unsigned int b = a + slices + 1;
+            unsigned int quad[6] = {a, a + 1, b, a + 1, b + 1, b};
+            indices.insert(indices.end(), quad, quad + 6);
+        }
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
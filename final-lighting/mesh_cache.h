@@ -0,0 +1,281 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <glm.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "mesh_import.h"
+#include "mesh_lod.h"
+#include "mesh_pool.h"
+
+// Binary mesh cache (.meshcache next to the source file). Little endian, every stream 16 byte aligned
+// and already in the MeshPool layout, so a load is a map, no parsing: the pool keeps the mapping and its
+// upload() hands the streams straight to the gpu buffers (MeshPool::addMappedMesh)
+//   MeshCacheHeader
+//   MeshCacheLod[lodCount]            index ranges into the index stream, level 0 first
+//   vec4 positions[vertexCount]       w = 1
+//   vec4 normals[vertexCount]         w = 0
+//   vec2 texCoords[vertexCount]
+//   uint indices[indexCount]          mesh-local, all levels back to back
+// Bump MESH_CACHE_VERSION whenever the layout or the LOD generator changes, old files get rebuilt.
+const uint32_t MESH_CACHE_MAGIC = 0x4348534D; // "MSHC"
+const uint32_t MESH_CACHE_VERSION = 1;
+
+struct MeshCacheHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t lodCount;
+    uint32_t reserved;
+    float boundsMin[3];
+    float boundsMax[3];
+    uint64_t lodOffset;
+    uint64_t positionOffset;
+    uint64_t normalOffset;
+    uint64_t texCoordOffset;
+    uint64_t indexOffset;
+    uint64_t fileSize;
+};
+
+struct MeshCacheLod
+{
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    float error;
+    uint32_t reserved;
+};
+
+// read-only memory mapping of a whole file
+class MappedFile
+{
+public:
+    const unsigned char *data = nullptr;
+    size_t size = 0;
+
+    MappedFile() {}
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    ~MappedFile() { close(); }
+
+    bool open(const char *path)
+    {
+        close();
+#ifdef _WIN32
+        file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+        LARGE_INTEGER fileSize;
+        GetFileSizeEx(file, &fileSize);
+        size = (size_t)fileSize.QuadPart;
+        mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping)
+            data = (const unsigned char *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+        fd = ::open(path, O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat info;
+        fstat(fd, &info);
+        size = (size_t)info.st_size;
+        void *mapped = size ? mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+        data = mapped == MAP_FAILED ? nullptr : (const unsigned char *)mapped;
+#endif
+        if (!data)
+            close();
+        return data != nullptr;
+    }
+    void close()
+    {
+#ifdef _WIN32
+        if (data)
+            UnmapViewOfFile(data);
+        if (mapping)
+            CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE)
+            CloseHandle(file);
+        mapping = NULL;
+        file = INVALID_HANDLE_VALUE;
+#else
+        if (data)
+            munmap((void *)data, size);
+        if (fd >= 0)
+            ::close(fd);
+        fd = -1;
+#endif
+        data = nullptr;
+        size = 0;
+    }
+
+private:
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = NULL;
+#else
+    int fd = -1;
+#endif
+};
+
+// ------------------------------------------------------------------------
+inline uint64_t alignCacheOffset(uint64_t offset)
+{
+    return (offset + 15) & ~(uint64_t)15;
+}
+
+// writes a mesh (level 0 = mesh, further levels from the chain) that is already in the pool
+// ------------------------------------------------------------------------
+inline bool writeMeshCache(const char *cachePath, const MeshPool &pool, const LodChain &chain, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax)
+{
+    const MeshRange &base = pool.meshes[chain.levels[0].mesh];
+    MeshCacheHeader header = {};
+    header.magic = MESH_CACHE_MAGIC;
+    header.version = MESH_CACHE_VERSION;
+    header.vertexCount = base.vertexCount;
+    header.lodCount = (uint32_t)chain.levels.size();
+    for (int i = 0; i < 3; i++)
+    {
+        header.boundsMin[i] = boundsMin[i];
+        header.boundsMax[i] = boundsMax[i];
+    }
+
+    std::vector<MeshCacheLod> lods;
+    std::vector<unsigned int> indices;
+    for (const LodLevel &level : chain.levels)
+    {
+        const MeshRange &range = pool.meshes[level.mesh];
+        lods.push_back({(uint32_t)indices.size(), range.indexCount, level.error, 0});
+        indices.insert(indices.end(), pool.indices.begin() + range.firstIndex, pool.indices.begin() + range.firstIndex + range.indexCount);
+    }
+    header.indexCount = (uint32_t)indices.size();
+
+    header.lodOffset = alignCacheOffset(sizeof(MeshCacheHeader));
+    header.positionOffset = alignCacheOffset(header.lodOffset + lods.size() * sizeof(MeshCacheLod));
+    header.normalOffset = alignCacheOffset(header.positionOffset + base.vertexCount * sizeof(glm::vec4));
+    header.texCoordOffset = alignCacheOffset(header.normalOffset + base.vertexCount * sizeof(glm::vec4));
+    header.indexOffset = alignCacheOffset(header.texCoordOffset + base.vertexCount * sizeof(glm::vec2));
+    header.fileSize = header.indexOffset + indices.size() * sizeof(unsigned int);
+
+    std::vector<unsigned char> file(header.fileSize, 0);
+    memcpy(&file[0], &header, sizeof(header));
+    memcpy(&file[header.lodOffset], lods.data(), lods.size() * sizeof(MeshCacheLod));
+    memcpy(&file[header.positionOffset], &pool.positions[base.baseVertex], base.vertexCount * sizeof(glm::vec4));
+    memcpy(&file[header.normalOffset], &pool.normals[base.baseVertex], base.vertexCount * sizeof(glm::vec4));
+    memcpy(&file[header.texCoordOffset], &pool.texCoords[base.baseVertex], base.vertexCount * sizeof(glm::vec2));
+    memcpy(&file[header.indexOffset], indices.data(), indices.size() * sizeof(unsigned int));
+
+    std::ofstream out(cachePath, std::ios::binary | std::ios::trunc);
+    out.write((const char *)file.data(), file.size());
+    return out.good();
+}
+
+// maps a cache file and adds its streams to the pool without copying them, fails on any mismatch
+// ------------------------------------------------------------------------
+inline bool readMeshCache(const char *cachePath, MeshPool &pool, LodChain &chain, glm::vec3 &boundsMin, glm::vec3 &boundsMax)
+{
+    std::shared_ptr<MappedFile> mapping = std::make_shared<MappedFile>();
+    MappedFile &file = *mapping;
+    if (!file.open(cachePath) || file.size < sizeof(MeshCacheHeader))
+        return false;
+    MeshCacheHeader header;
+    memcpy(&header, file.data, sizeof(header));
+    if (header.magic != MESH_CACHE_MAGIC || header.version != MESH_CACHE_VERSION || header.fileSize != file.size || header.lodCount == 0)
+        return false;
+    // every stream aligned and inside the file, every level inside the index stream, every index a vertex;
+    // a file that fails is rebuilt from the source
+    auto fits = [&](uint64_t offset, uint64_t count, uint64_t elementSize) {
+        return offset % 16 == 0 && offset >= sizeof(MeshCacheHeader) && offset <= file.size && count * elementSize <= file.size - offset;
+    };
+    if (!fits(header.lodOffset, header.lodCount, sizeof(MeshCacheLod)) || !fits(header.positionOffset, header.vertexCount, sizeof(glm::vec4)) ||
+        !fits(header.normalOffset, header.vertexCount, sizeof(glm::vec4)) || !fits(header.texCoordOffset, header.vertexCount, sizeof(glm::vec2)) ||
+        !fits(header.indexOffset, header.indexCount, sizeof(unsigned int)))
+    {
+        std::cout << "ERROR::MESH::CACHE_CORRUPT: " << cachePath << " (stream out of range)" << std::endl;
+        return false;
+    }
+
+    const MeshCacheLod *lods = (const MeshCacheLod *)(file.data + header.lodOffset);
+    const glm::vec4 *positions = (const glm::vec4 *)(file.data + header.positionOffset);
+    const glm::vec4 *normals = (const glm::vec4 *)(file.data + header.normalOffset);
+    const glm::vec2 *texCoords = (const glm::vec2 *)(file.data + header.texCoordOffset);
+    const unsigned int *indices = (const unsigned int *)(file.data + header.indexOffset);
+    for (unsigned int i = 0; i < header.lodCount; i++)
+    {
+        if ((uint64_t)lods[i].firstIndex + lods[i].indexCount > header.indexCount || lods[i].indexCount % 3 != 0)
+        {
+            std::cout << "ERROR::MESH::CACHE_CORRUPT: " << cachePath << " (level " << i << " out of range)" << std::endl;
+            return false;
+        }
+    }
+    for (unsigned int i = 0; i < header.indexCount; i++)
+    {
+        if (indices[i] >= header.vertexCount)
+        {
+            std::cout << "ERROR::MESH::CACHE_CORRUPT: " << cachePath << " (index " << indices[i] << " of " << header.vertexCount << " vertices)" << std::endl;
+            return false;
+        }
+    }
+
+    std::vector<MeshRange> levels;
+    for (unsigned int i = 0; i < header.lodCount; i++)
+        levels.push_back({0, header.vertexCount, lods[i].firstIndex, lods[i].indexCount});
+    unsigned int firstMesh = pool.addMappedMesh(mapping, positions, normals, texCoords, header.vertexCount, indices, header.indexCount, levels);
+    chain.levels.clear();
+    for (unsigned int i = 0; i < header.lodCount; i++)
+        chain.levels.push_back({firstMesh + i, lods[i].indexCount / 3, lods[i].error});
+    boundsMin = glm::vec3(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]);
+    boundsMax = glm::vec3(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]);
+    return true;
+}
+
+// Loads an OBJ/glTF into the pool with its LOD chain. Uses path.meshcache when it is newer than the source,
+// otherwise imports the text file, generates the LODs and writes the cache for the next run.
+// ------------------------------------------------------------------------
+inline bool loadMesh(const char *path, MeshPool &pool, LodChain &chain, glm::vec3 &boundsMin, glm::vec3 &boundsMax, unsigned int lodLevels = 5)
+{
+    namespace fs = std::filesystem;
+    std::string cachePath = std::string(path) + ".meshcache";
+    auto start = std::chrono::high_resolution_clock::now();
+    auto elapsedMs = [&]() { return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count(); };
+
+    std::error_code ec;
+    bool cacheFresh = fs::exists(cachePath, ec) && (!fs::exists(path, ec) || fs::last_write_time(cachePath, ec) >= fs::last_write_time(path, ec));
+    if (cacheFresh && readMeshCache(cachePath.c_str(), pool, chain, boundsMin, boundsMax))
+    {
+        std::cout << "mesh " << path << ": binary cache, " << elapsedMs() << " ms" << std::endl;
+        return true;
+    }
+
+    ImportedMesh mesh;
+    if (!importMesh(path, mesh))
+        return false;
+    double parseMs = elapsedMs();
+    unsigned int id = pool.addMesh(mesh.vertices.data(), mesh.vertexCount(), 8, 0, 3, 6, mesh.indices.data(), (unsigned int)mesh.indices.size());
+    chain = generateLods(pool, id, lodLevels);
+    boundsMin = mesh.boundsMin;
+    boundsMax = mesh.boundsMax;
+    if (!writeMeshCache(cachePath.c_str(), pool, chain, boundsMin, boundsMax))
+        std::cout << "ERROR::MESH::CACHE_NOT_WRITTEN: " << cachePath << std::endl;
+    std::cout << "mesh " << path << ": text import " << parseMs << " ms, +LODs +cache write " << elapsedMs() << " ms" << std::endl;
+    return true;
+}
+#endif
@@ -0,0 +1,522 @@
+#ifndef MESH_IMPORT_H
+#define MESH_IMPORT_H
+
+#include <glad/glad.h>
+#include <glm.hpp>
+
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// an imported mesh in the usual position(3) normal(3) texcoord(2) layout, indexed
+struct ImportedMesh
+{
+    std::vector<float> vertices;
+    std::vector<unsigned int> indices;
+    glm::vec3 boundsMin = glm::vec3(INFINITY);
+    glm::vec3 boundsMax = glm::vec3(-INFINITY);
+
+    unsigned int vertexCount() const { return (unsigned int)vertices.size() / 8; }
+    void addVertex(const glm::vec3 &position, const glm::vec3 &normal, const glm::vec2 &texCoord)
+    {
+        float vertex[8] = {position.x, position.y, position.z, normal.x, normal.y, normal.z, texCoord.x, texCoord.y};
+        vertices.insert(vertices.end(), vertex, vertex + 8);
+        boundsMin = glm::min(boundsMin, position);
+        boundsMax = glm::max(boundsMax, position);
+    }
+    // smooth normals from the faces, for files that don't have any: the vertices from firstVertex on, from the
+    // triangles from firstIndex on (one glTF primitive, the ones before it keep their normals). Indices outside
+    // that vertex range are skipped, importers reject them before
+    void computeNormals(unsigned int firstVertex = 0, size_t firstIndex = 0)
+    {
+        unsigned int count = vertexCount();
+        std::vector<glm::vec3> normals(count - firstVertex, glm::vec3(0.0f));
+        for (size_t i = firstIndex; i + 2 < indices.size(); i += 3)
+        {
+            if (indices[i] < firstVertex || indices[i] >= count || indices[i + 1] < firstVertex || indices[i + 1] >= count ||
+                indices[i + 2] < firstVertex || indices[i + 2] >= count)
+                continue;
+            glm::vec3 p[3];
+            for (int k = 0; k < 3; k++)
+                p[k] = glm::vec3(vertices[indices[i + k] * 8], vertices[indices[i + k] * 8 + 1], vertices[indices[i + k] * 8 + 2]);
+            glm::vec3 n = glm::cross(p[1] - p[0], p[2] - p[0]); // area weighted
+            for (int k = 0; k < 3; k++)
+                normals[indices[i + k] - firstVertex] += n;
+        }
+        for (unsigned int v = firstVertex; v < count; v++)
+        {
+            glm::vec3 sum = normals[v - firstVertex];
+            glm::vec3 n = glm::length(sum) > 0.0f ? glm::normalize(sum) : glm::vec3(0.0f, 1.0f, 0.0f);
+            vertices[v * 8 + 3] = n.x;
+            vertices[v * 8 + 4] = n.y;
+            vertices[v * 8 + 5] = n.z;
+        }
+    }
+};
+
+//--------------------------------------------------------------------------------------------------
+// Wavefront OBJ: v/vt/vn/f, polygons are fan triangulated, negative (relative) indices are allowed.
+// Every distinct v/vt/vn triple becomes one vertex. Materials and groups are ignored.
+inline bool importObj(const char *path, ImportedMesh &mesh)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        std::cout << "ERROR::MESH::FILE_NOT_SUCCESSFULLY_READ: " << path << std::endl;
+        return false;
+    }
+    std::vector<glm::vec3> positions, normals;
+    std::vector<glm::vec2> texCoords;
+    std::unordered_map<std::string, unsigned int> vertexOf; // "v/vt/vn" -> index
+    bool missingNormals = false;
+
+    std::string line;
+    std::vector<unsigned int> polygon;
+    while (std::getline(file, line))
+    {
+        const char *c = line.c_str();
+        while (*c == ' ' || *c == '\t')
+            c++;
+        if (c[0] == 'v' && c[1] == ' ')
+        {
+            glm::vec3 p;
+            sscanf(c + 2, "%f %f %f", &p.x, &p.y, &p.z);
+            positions.push_back(p);
+        }
+        else if (c[0] == 'v' && c[1] == 'n')
+        {
+            glm::vec3 n;
+            sscanf(c + 3, "%f %f %f", &n.x, &n.y, &n.z);
+            normals.push_back(n);
+        }
+        else if (c[0] == 'v' && c[1] == 't')
+        {
+            glm::vec2 t;
+            sscanf(c + 3, "%f %f", &t.x, &t.y);
+            texCoords.push_back(t);
+        }
+        else if (c[0] == 'f' && c[1] == ' ')
+        {
+            polygon.clear();
+            std::istringstream corners(c + 2);
+            std::string corner;
+            while (corners >> corner)
+            {
+                auto found = vertexOf.find(corner);
+                if (found != vertexOf.end())
+                {
+                    polygon.push_back(found->second);
+                    continue;
+                }
+                // v, v/vt, v//vn or v/vt/vn
+                int v = 0, vt = 0, vn = 0;
+                const char *s = corner.c_str();
+                v = atoi(s);
+                const char *slash = strchr(s, '/');
+                if (slash)
+                {
+                    if (slash[1] != '/')
+                        vt = atoi(slash + 1);
+                    const char *slash2 = strchr(slash + 1, '/');
+                    if (slash2)
+                        vn = atoi(slash2 + 1);
+                }
+                if (v < 0)
+                    v += (int)positions.size() + 1;
+                if (vt < 0)
+                    vt += (int)texCoords.size() + 1;
+                if (vn < 0)
+                    vn += (int)normals.size() + 1;
+                if (v <= 0 || v > (int)positions.size() || vt > (int)texCoords.size() || vn > (int)normals.size())
+                {
+                    std::cout << "ERROR::MESH::OBJ_BAD_INDEX: " << corner << std::endl;
+                    return false;
+                }
+                missingNormals = missingNormals || vn == 0;
+                mesh.addVertex(positions[v - 1], vn ? normals[vn - 1] : glm::vec3(0.0f), vt ? texCoords[vt - 1] : glm::vec2(0.0f));
+                unsigned int index = mesh.vertexCount() - 1;
+                vertexOf[corner] = index;
+                polygon.push_back(index);
+            }
+            for (size_t i = 2; i < polygon.size(); i++)
+            {
+                mesh.indices.push_back(polygon[0]);
+                mesh.indices.push_back(polygon[i - 1]);
+                mesh.indices.push_back(polygon[i]);
+            }
+        }
+    }
+    if (missingNormals)
+        mesh.computeNormals();
+    return !mesh.indices.empty();
+}
+
+//--------------------------------------------------------------------------------------------------
+// just enough JSON for glTF
+struct JsonValue
+{
+    enum Type { Null, Bool, Number, String, Array, Object };
+    Type type = Null;
+    double number = 0.0;
+    std::string string;
+    std::vector<JsonValue> array;
+    std::vector<std::pair<std::string, JsonValue>> object;
+
+    const JsonValue &operator[](const char *key) const
+    {
+        static const JsonValue missing;
+        for (const auto &member : object)
+            if (member.first == key)
+                return member.second;
+        return missing;
+    }
+    const JsonValue &operator[](size_t index) const
+    {
+        static const JsonValue missing;
+        return index < array.size() ? array[index] : missing;
+    }
+    bool has(const char *key) const { return (*this)[key].type != Null; }
+    int asInt(int fallback = 0) const { return type == Number ? (int)number : fallback; }
+};
+
+class JsonParser
+{
+public:
+    explicit JsonParser(const std::string &text) : p(text.c_str()), end(text.c_str() + text.size()) {}
+
+    bool parse(JsonValue &value)
+    {
+        skip();
+        if (p >= end)
+            return false;
+        if (*p == '{')
+        {
+            value.type = JsonValue::Object;
+            p++;
+            skip();
+            if (*p == '}')
+                return ++p, true;
+            while (p < end)
+            {
+                JsonValue key;
+                skip();
+                if (!parseString(key.string))
+                    return false;
+                skip();
+                if (*p++ != ':')
+                    return false;
+                value.object.push_back({key.string, JsonValue()});
+                if (!parse(value.object.back().second))
+                    return false;
+                skip();
+                if (*p == ',')
+                    p++;
+                else if (*p == '}')
+                    return ++p, true;
+                else
+                    return false;
+            }
+            return false;
+        }
+        if (*p == '[')
+        {
+            value.type = JsonValue::Array;
+            p++;
+            skip();
+            if (*p == ']')
+                return ++p, true;
+            while (p < end)
+            {
+                value.array.push_back(JsonValue());
+                if (!parse(value.array.back()))
+                    return false;
+                skip();
+                if (*p == ',')
+                    p++;
+                else if (*p == ']')
+                    return ++p, true;
+                else
+                    return false;
+            }
+            return false;
+        }
+        if (*p == '"')
+        {
+            value.type = JsonValue::String;
+            return parseString(value.string);
+        }
+        if (strncmp(p, "true", 4) == 0 || strncmp(p, "false", 5) == 0)
+        {
+            value.type = JsonValue::Bool;
+            value.number = *p == 't' ? 1.0 : 0.0;
+            p += *p == 't' ? 4 : 5;
+            return true;
+        }
+        if (strncmp(p, "null", 4) == 0)
+        {
+            p += 4;
+            return true;
+        }
+        char *numberEnd = nullptr;
+        value.type = JsonValue::Number;
+        value.number = strtod(p, &numberEnd);
+        if (numberEnd == p)
+            return false;
+        p = numberEnd;
+        return true;
+    }
+
+private:
+    const char *p;
+    const char *end;
+
+    void skip()
+    {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r'))
+            p++;
+    }
+    bool parseString(std::string &out)
+    {
+        if (*p++ != '"')
+            return false;
+        while (p < end && *p != '"')
+        {
+            if (*p == '\\')
+            {
+                p++;
+                char e = *p++;
+                if (e == 'n')
+                    out += '\n';
+                else if (e == 't')
+                    out += '\t';
+                else if (e == 'u')
+                {
+                    out += '?'; // glTF names only, not worth decoding
+                    p += 4;
+                }
+                else
+                    out += e;
+                continue;
+            }
+            out += *p++;
+        }
+        return p++ < end;
+    }
+};
+
+// ------------------------------------------------------------------------
+inline std::vector<unsigned char> decodeBase64(const char *text, size_t length)
+{
+    std::vector<unsigned char> out;
+    unsigned int bits = 0;
+    int count = 0;
+    for (size_t i = 0; i < length && text[i] != '='; i++)
+    {
+        const char *table = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        const char *at = strchr(table, text[i]);
+        if (!at || !text[i])
+            continue;
+        bits = (bits << 6) | (unsigned int)(at - table);
+        count += 6;
+        if (count >= 8)
+        {
+            count -= 8;
+            out.push_back((unsigned char)((bits >> count) & 0xFF));
+        }
+    }
+    return out;
+}
+
+//--------------------------------------------------------------------------------------------------
+// glTF 2.0 (.gltf with external or data: buffers, or binary .glb). All triangle primitives of the first
+// mesh are merged, node transforms are not applied. Attributes must be float, indices any unsigned type.
+inline bool importGltf(const char *path, ImportedMesh &mesh)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+    {
+        std::cout << "ERROR::MESH::FILE_NOT_SUCCESSFULLY_READ: " << path << std::endl;
+        return false;
+    }
+    std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    std::string directory = path;
+    directory = directory.substr(0, directory.find_last_of("/\\") + 1);
+
+    // .glb: 12 byte header, JSON chunk, optional BIN chunk; every length is checked against the file
+    std::string jsonText = data;
+    std::vector<unsigned char> glbBinary;
+    if (data.compare(0, 4, "glTF") == 0)
+    {
+        unsigned int totalLength = 0, jsonLength = 0;
+        if (data.size() >= 20)
+        {
+            memcpy(&totalLength, &data[8], 4);
+            memcpy(&jsonLength, &data[12], 4);
+        }
+        size_t binStart = 20 + (size_t)jsonLength;
+        if (data.size() < 20 || totalLength > data.size() || data.compare(16, 4, "JSON") != 0 || binStart > totalLength)
+        {
+            std::cout << "ERROR::MESH::GLB_BAD_CHUNK: " << path << std::endl;
+            return false;
+        }
+        jsonText = data.substr(20, jsonLength);
+        if (totalLength >= binStart + 8)
+        {
+            unsigned int binLength;
+            memcpy(&binLength, &data[binStart], 4);
+            if (data.compare(binStart + 4, 4, std::string("BIN\0", 4)) != 0 || binStart + 8 + (size_t)binLength > totalLength)
+            {
+                std::cout << "ERROR::MESH::GLB_BAD_CHUNK: " << path << std::endl;
+                return false;
+            }
+            glbBinary.assign(data.begin() + binStart + 8, data.begin() + binStart + 8 + binLength);
+        }
+    }
+
+    JsonValue gltf;
+    if (!JsonParser(jsonText).parse(gltf))
+    {
+        std::cout << "ERROR::MESH::GLTF_BAD_JSON: " << path << std::endl;
+        return false;
+    }
+
+    // load every buffer
+    std::vector<std::vector<unsigned char>> buffers;
+    for (const JsonValue &buffer : gltf["buffers"].array)
+    {
+        const std::string &uri = buffer["uri"].string;
+        if (uri.empty())
+            buffers.push_back(glbBinary);
+        else if (uri.compare(0, 5, "data:") == 0)
+        {
+            size_t comma = uri.find(',');
+            buffers.push_back(decodeBase64(uri.c_str() + comma + 1, uri.size() - comma - 1));
+        }
+        else
+        {
+            std::ifstream bin(directory + uri, std::ios::binary);
+            buffers.push_back(std::vector<unsigned char>((std::istreambuf_iterator<char>(bin)), std::istreambuf_iterator<char>()));
+        }
+    }
+
+    // pointer + stride of an accessor's elements, null if it can't be read
+    auto accessorData = [&](int accessorIndex, size_t elementSize, size_t &count, size_t &stride, int &componentType) -> const unsigned char * {
+        const JsonValue &accessor = gltf["accessors"][accessorIndex];
+        const JsonValue &view = gltf["bufferViews"][accessor["bufferView"].asInt(-1)];
+        if (view.type != JsonValue::Object)
+            return nullptr;
+        size_t bufferIndex = view["buffer"].asInt();
+        if (bufferIndex >= buffers.size())
+            return nullptr;
+        int elements = accessor["count"].asInt();
+        int viewStride = view["byteStride"].asInt((int)elementSize);
+        int viewOffset = view["byteOffset"].asInt(), accessorOffset = accessor["byteOffset"].asInt();
+        size_t bufferSize = buffers[bufferIndex].size();
+        if (elements <= 0 || viewStride <= 0 || viewOffset < 0 || accessorOffset < 0 || (size_t)elements > bufferSize)
+            return nullptr;
+        count = (size_t)elements;
+        componentType = accessor["componentType"].asInt();
+        stride = (size_t)viewStride;
+        size_t offset = (size_t)viewOffset + (size_t)accessorOffset;
+        if (offset > bufferSize || stride * (count - 1) + elementSize > bufferSize - offset)
+            return nullptr;
+        return buffers[bufferIndex].data() + offset;
+    };
+
+    for (const JsonValue &primitive : gltf["meshes"][(size_t)0]["primitives"].array)
+    {
+        if (primitive["mode"].asInt(4) != 4)
+            continue; // triangles only
+        const JsonValue &attributes = primitive["attributes"];
+        size_t count = 0, stride = 0, normalCount = 0, normalStride = 0, uvCount = 0, uvStride = 0;
+        int type = 0, normalType = 0, uvType = 0;
+        const unsigned char *positions = accessorData(attributes["POSITION"].asInt(-1), 12, count, stride, type);
+        if (!positions || type != GL_FLOAT)
+            continue;
+        const unsigned char *normals = attributes.has("NORMAL") ? accessorData(attributes["NORMAL"].asInt(), 12, normalCount, normalStride, normalType) : nullptr;
+        const unsigned char *uvs = attributes.has("TEXCOORD_0") ? accessorData(attributes["TEXCOORD_0"].asInt(), 8, uvCount, uvStride, uvType) : nullptr;
+        if (normals && (normalCount != count || normalType != GL_FLOAT))
+            normals = nullptr;
+        if (uvs && (uvCount != count || uvType != GL_FLOAT))
+            uvs = nullptr;
+
+        unsigned int baseVertex = mesh.vertexCount();
+        size_t baseIndex = mesh.indices.size();
+        for (size_t i = 0; i < count; i++)
+        {
+            glm::vec3 p, n(0.0f);
+            glm::vec2 t(0.0f);
+            memcpy(&p, positions + i * stride, 12);
+            if (normals)
+                memcpy(&n, normals + i * normalStride, 12);
+            if (uvs)
+            {
+                memcpy(&t, uvs + i * uvStride, 8);
+                t.y = 1.0f - t.y; // glTF uv origin is top left
+            }
+            mesh.addVertex(p, n, t);
+        }
+
+        if (primitive.has("indices"))
+        {
+            size_t indexCount = 0, indexStride = 0;
+            int indexType = 0;
+            const JsonValue &indexAccessor = gltf["accessors"][primitive["indices"].asInt()];
+            int componentType = indexAccessor["componentType"].asInt();
+            size_t size = componentType == GL_UNSIGNED_BYTE ? 1 : componentType == GL_UNSIGNED_SHORT ? 2 : 4;
+            const unsigned char *indices = accessorData(primitive["indices"].asInt(), size, indexCount, indexStride, indexType);
+            if (!indices)
+                continue;
+            for (size_t i = 0; i < indexCount; i++)
+            {
+                unsigned int index = 0;
+                if (size == 1)
+                    index = indices[i * indexStride];
+                else if (size == 2)
+                    index = *(const unsigned short *)(indices + i * indexStride);
+                else
+                    index = *(const unsigned int *)(indices + i * indexStride);
+                if (index >= count)
+                {
+                    std::cout << "ERROR::MESH::GLTF_BAD_INDEX: " << index << " of " << count << " vertices in " << path << std::endl;
+                    return false;
+                }
+                mesh.indices.push_back(baseVertex + index);
+            }
+        }
+        else
+        {
+            for (size_t i = 0; i < count; i++)
+                mesh.indices.push_back(baseVertex + (unsigned int)i);
+        }
+        if (!normals)
+            mesh.computeNormals(baseVertex, baseIndex);
+    }
+    if (mesh.indices.empty())
+        std::cout << "ERROR::MESH::GLTF_NO_TRIANGLES: " << path << std::endl;
+    return !mesh.indices.empty();
+}
+
+// ------------------------------------------------------------------------
+inline bool importMesh(const char *path, ImportedMesh &mesh)
+{
+    std::string extension = path;
+    extension = extension.substr(extension.find_last_of('.') + 1);
+    for (char &c : extension)
+        c = (char)tolower(c);
+    if (extension == "obj")
+        return importObj(path, mesh);
+    if (extension == "gltf" || extension == "glb")
+        return importGltf(path, mesh);
+    std::cout << "ERROR::MESH::UNKNOWN_FORMAT: " << path << std::endl;
+    return false;
+}
+#endif
@@ -0,0 +1,310 @@
+#ifndef MESH_LOD_H
+#define MESH_LOD_H
+
+#include <glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <queue>
+#include <tuple>
+#include <vector>
+
+#include "mesh_pool.h"
+
+// one detail level of a mesh inside the MeshPool, error is the geometric error in object units
+struct LodLevel
+{
+    unsigned int mesh; // MeshPool range, all levels share the vertices of level 0
+    unsigned int triangleCount;
+    float error;
+};
+
+struct LodChain
+{
+    std::vector<LodLevel> levels; // 0 = full detail
+};
+
+// symmetric 4x4 quadric (Garland & Heckbert), stored as the 10 unique coefficients.
+// weight is the summed face area, error / weight is a mean squared distance.
+struct Quadric
+{
+    double a2 = 0, ab = 0, ac = 0, ad = 0, b2 = 0, bc = 0, bd = 0, c2 = 0, cd = 0, d2 = 0;
+    double weight = 0;
+
+    static Quadric fromPlane(double a, double b, double c, double d, double weight)
+    {
+        Quadric q;
+        q.a2 = a * a * weight; q.ab = a * b * weight; q.ac = a * c * weight; q.ad = a * d * weight;
+        q.b2 = b * b * weight; q.bc = b * c * weight; q.bd = b * d * weight;
+        q.c2 = c * c * weight; q.cd = c * d * weight;
+        q.d2 = d * d * weight;
+        q.weight = weight;
+        return q;
+    }
+    void add(const Quadric &o)
+    {
+        a2 += o.a2; ab += o.ab; ac += o.ac; ad += o.ad; b2 += o.b2;
+        bc += o.bc; bd += o.bd; c2 += o.c2; cd += o.cd; d2 += o.d2;
+        weight += o.weight;
+    }
+    // mean squared distance of p to the accumulated planes
+    double error(const glm::vec3 &p) const
+    {
+        double x = p.x, y = p.y, z = p.z;
+        double e = a2 * x * x + 2 * ab * x * y + 2 * ac * x * z + 2 * ad * x + b2 * y * y + 2 * bc * y * z + 2 * bd * y + c2 * z * z + 2 * cd * z + d2;
+        return std::max(e, 0.0) / std::max(weight, 1e-12);
+    }
+};
+
+// Quadric error metric simplification of an indexed triangle list down to targetTriangles.
+// Only half-edge collapses are used (a vertex moves onto one of its neighbours), so the result
+// indexes the same vertices as the input and every level can share one vertex buffer.
+// Vertices with equal positions (uv/normal seams) are welded for the topology and move together.
+// maxError receives the largest collapse error, as a distance.
+inline std::vector<unsigned int> simplifyMesh(const std::vector<glm::vec3> &positions, const std::vector<glm::vec2> &texCoords,
+                                              const std::vector<unsigned int> &indices, unsigned int targetTriangles, float &maxError)
+{
+    unsigned int vertexCount = (unsigned int)positions.size();
+    unsigned int triangleCount = (unsigned int)indices.size() / 3;
+
+    // weld: every vertex points at the first vertex with the same position
+    std::vector<unsigned int> weld(vertexCount);
+    {
+        std::map<std::tuple<float, float, float>, unsigned int> firstAt;
+        for (unsigned int v = 0; v < vertexCount; v++)
+            weld[v] = firstAt.insert({std::make_tuple(positions[v].x, positions[v].y, positions[v].z), v}).first->second;
+    }
+
+    std::vector<unsigned int> tris(indices);
+    std::vector<bool> removed(triangleCount, false);
+    std::vector<std::vector<unsigned int>> adjacency(vertexCount); // welded vertex -> triangles
+    std::vector<Quadric> quadrics(vertexCount);
+    for (unsigned int t = 0; t < triangleCount; t++)
+    {
+        glm::vec3 p0 = positions[tris[t * 3]], p1 = positions[tris[t * 3 + 1]], p2 = positions[tris[t * 3 + 2]];
+        glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+        float area = glm::length(n);
+        if (area > 0.0f)
+            n = n / area;
+        Quadric q = Quadric::fromPlane(n.x, n.y, n.z, -glm::dot(n, p0), area * 0.5f);
+        for (int k = 0; k < 3; k++)
+        {
+            quadrics[weld[tris[t * 3 + k]]].add(q);
+            adjacency[weld[tris[t * 3 + k]]].push_back(t);
+        }
+    }
+
+    // open borders get a heavy plane perpendicular to the face so the silhouette stays put
+    {
+        std::map<std::pair<unsigned int, unsigned int>, int> edgeUse;
+        for (unsigned int t = 0; t < triangleCount; t++)
+            for (int k = 0; k < 3; k++)
+            {
+                unsigned int a = weld[tris[t * 3 + k]], b = weld[tris[t * 3 + (k + 1) % 3]];
+                edgeUse[{std::min(a, b), std::max(a, b)}]++;
+            }
+        for (unsigned int t = 0; t < triangleCount; t++)
+        {
+            glm::vec3 p0 = positions[tris[t * 3]], p1 = positions[tris[t * 3 + 1]], p2 = positions[tris[t * 3 + 2]];
+            glm::vec3 faceNormal = glm::cross(p1 - p0, p2 - p0);
+            if (glm::length(faceNormal) == 0.0f)
+                continue;
+            for (int k = 0; k < 3; k++)
+            {
+                unsigned int a = weld[tris[t * 3 + k]], b = weld[tris[t * 3 + (k + 1) % 3]];
+                if (edgeUse[{std::min(a, b), std::max(a, b)}] != 1)
+                    continue;
+                glm::vec3 edge = positions[b] - positions[a];
+                glm::vec3 n = glm::cross(edge, faceNormal);
+                if (glm::length(n) == 0.0f)
+                    continue;
+                n = glm::normalize(n);
+                Quadric q = Quadric::fromPlane(n.x, n.y, n.z, -glm::dot(n, positions[a]), glm::dot(edge, edge) * 10.0f);
+                q.weight = 0; // penalty only, not part of the surface area
+                quadrics[a].add(q);
+                quadrics[b].add(q);
+            }
+        }
+    }
+
+    // candidate collapses, stale entries are skipped by comparing the vertex versions
+    struct Collapse
+    {
+        double cost;
+        unsigned int from, to;
+        unsigned int fromVersion, toVersion;
+        bool operator<(const Collapse &o) const { return cost > o.cost; } // min-heap
+    };
+    std::vector<unsigned int> version(vertexCount, 0);
+    std::vector<bool> dead(vertexCount, false);
+    std::priority_queue<Collapse> heap;
+    auto pushEdges = [&](unsigned int v) {
+        for (unsigned int t : adjacency[v])
+        {
+            if (removed[t])
+                continue;
+            for (int k = 0; k < 3; k++)
+            {
+                unsigned int u = weld[tris[t * 3 + k]];
+                if (u == v)
+                    continue;
+                Quadric q = quadrics[v];
+                q.add(quadrics[u]);
+                heap.push({q.error(positions[u]), v, u, version[v], version[u]});
+                heap.push({q.error(positions[v]), u, v, version[u], version[v]});
+            }
+        }
+    };
+    for (unsigned int v = 0; v < vertexCount; v++)
+        if (weld[v] == v)
+            pushEdges(v);
+
+    // all real vertices of a welded vertex, to pick the seam side with the closest uv
+    std::vector<std::vector<unsigned int>> copies(vertexCount);
+    for (unsigned int v = 0; v < vertexCount; v++)
+        copies[weld[v]].push_back(v);
+
+    double worstCost = 0.0;
+    while (triangleCount > targetTriangles && !heap.empty())
+    {
+        Collapse c = heap.top();
+        heap.pop();
+        if (dead[c.from] || dead[c.to] || version[c.from] != c.fromVersion || version[c.to] != c.toVersion)
+            continue;
+
+        // reject collapses that flip a remaining triangle
+        bool flips = false;
+        for (unsigned int t : adjacency[c.from])
+        {
+            if (removed[t])
+                continue;
+            glm::vec3 p[3], moved[3];
+            bool degenerate = false;
+            for (int k = 0; k < 3; k++)
+            {
+                unsigned int w = weld[tris[t * 3 + k]];
+                p[k] = positions[w];
+                moved[k] = w == c.from ? positions[c.to] : p[k];
+                degenerate = degenerate || w == c.to;
+            }
+            if (degenerate)
+                continue;
+            glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+            glm::vec3 after = glm::cross(moved[1] - moved[0], moved[2] - moved[0]);
+            if (glm::dot(before, after) <= 0.0f)
+            {
+                flips = true;
+                break;
+            }
+        }
+        if (flips)
+            continue;
+
+        // move every triangle of 'from' onto 'to'
+        for (unsigned int t : adjacency[c.from])
+        {
+            if (removed[t])
+                continue;
+            bool degenerate = false;
+            for (int k = 0; k < 3; k++)
+                degenerate = degenerate || weld[tris[t * 3 + k]] == c.to;
+            if (degenerate)
+            {
+                removed[t] = true;
+                triangleCount--;
+                continue;
+            }
+            for (int k = 0; k < 3; k++)
+            {
+                unsigned int &index = tris[t * 3 + k];
+                if (weld[index] != c.from)
+                    continue;
+                unsigned int best = c.to;
+                float bestDistance = INFINITY;
+                for (unsigned int candidate : copies[c.to])
+                {
+                    float d = texCoords.empty() ? 0.0f : glm::length(texCoords[candidate] - texCoords[index]);
+                    if (d < bestDistance)
+                    {
+                        bestDistance = d;
+                        best = candidate;
+                    }
+                }
+                index = best;
+            }
+            adjacency[c.to].push_back(t);
+        }
+        adjacency[c.from].clear();
+        quadrics[c.to].add(quadrics[c.from]);
+        dead[c.from] = true;
+        version[c.to]++;
+        worstCost = std::max(worstCost, c.cost);
+        pushEdges(c.to);
+    }
+
+    std::vector<unsigned int> result;
+    result.reserve(triangleCount * 3);
+    for (unsigned int t = 0; t < removed.size(); t++)
+        if (!removed[t])
+            result.insert(result.end(), tris.begin() + t * 3, tris.begin() + t * 3 + 3);
+    maxError = (float)std::sqrt(std::max(worstCost, 0.0));
+    return result;
+}
+
+// Builds levelCount detail levels for a mesh already in the pool (each one about half the triangles of
+// the previous) and appends their indices to the pool, sharing the mesh's vertices. Call before upload().
+// Every level is simplified from the full mesh so its error is measured against the original surface.
+inline LodChain generateLods(MeshPool &pool, unsigned int mesh, unsigned int levelCount = 5, float reduction = 0.5f)
+{
+    MeshRange base = pool.meshes[mesh];
+    std::vector<glm::vec3> positions(base.vertexCount);
+    std::vector<glm::vec2> texCoords(base.vertexCount);
+    for (unsigned int v = 0; v < base.vertexCount; v++)
+    {
+        positions[v] = glm::vec3(pool.positions[base.baseVertex + v]);
+        texCoords[v] = pool.texCoords[base.baseVertex + v];
+    }
+    std::vector<unsigned int> indices(pool.indices.begin() + base.firstIndex, pool.indices.begin() + base.firstIndex + base.indexCount);
+
+    LodChain chain;
+    chain.levels.push_back({mesh, base.indexCount / 3, 0.0f});
+    float target = (float)chain.levels[0].triangleCount;
+    for (unsigned int level = 1; level < levelCount; level++)
+    {
+        target *= reduction;
+        float error = 0.0f;
+        std::vector<unsigned int> simplified = simplifyMesh(positions, texCoords, indices, (unsigned int)target, error);
+        if (simplified.size() / 3 >= chain.levels.back().triangleCount)
+            break; // nothing left to collapse
+        error = std::max(error, chain.levels.back().error); // keep the chain monotonic
+
+        MeshRange range = base;
+        range.firstIndex = (unsigned int)pool.indices.size();
+        range.indexCount = (unsigned int)simplified.size();
+        pool.indices.insert(pool.indices.end(), simplified.begin(), simplified.end());
+        pool.meshes.push_back(range);
+        chain.levels.push_back({(unsigned int)pool.meshes.size() - 1, range.indexCount / 3, error});
+    }
+    return chain;
+}
+
+// Picks a level from its projected screen-space error. pixelsPerUnit is screenHeight / (2 * tan(fovy / 2)),
+// scale the instance's uniform scale. A coarser level is only taken once its error is below
+// threshold * (1 - hysteresis), so an object sitting on a boundary does not pop back and forth.
+inline unsigned int selectLod(const LodChain &chain, float distance, float scale, float pixelsPerUnit,
+                              float thresholdPixels, float hysteresis, unsigned int previous)
+{
+    distance = std::max(distance, 1e-3f);
+    auto pixels = [&](unsigned int level) { return chain.levels[level].error * scale / distance * pixelsPerUnit; };
+
+    unsigned int level = std::min(previous, (unsigned int)chain.levels.size() - 1);
+    // refine right away when the current level is too coarse
+    while (level > 0 && pixels(level) > thresholdPixels)
+        level--;
+    // coarsen only with some margin
+    while (level + 1 < chain.levels.size() && pixels(level + 1) <= thresholdPixels * (1.0f - hysteresis))
+        level++;
+    return level;
+}
+#endif
@@ -0,0 +1,189 @@
+#ifndef MESH_POOL_H
+#define MESH_POOL_H
+
+#include <glad/glad.h>
+#include <glm.hpp>
+
+#include <memory>
+#include <vector>
+
+#include "gl_state.h"
+
+// where a mesh lives inside the shared pool
+struct MeshRange
+{
+    unsigned int baseVertex;
+    unsigned int vertexCount;
+    unsigned int firstIndex;
+    unsigned int indexCount;
+};
+
+// Vertex pulling: every mesh is appended into the same SSBO streams (positions, normals, uvs) and
+// the vertex shader fetches its attributes with gl_VertexID. The only VAO is an empty one that
+// just holds the element buffer, so any mesh/vertex format can be drawn without a VAO switch.
+// Binding points must match 4.3.pull.vert.
+// Meshes added with addMappedMesh() have no cpu copy: upload() hands their streams (already in the pool
+// layout, e.g. a mapped .meshcache) straight to the gpu buffers, after the meshes that have one.
+class MeshPool
+{
+public:
+    static const unsigned int POSITION_BINDING = 0;
+    static const unsigned int NORMAL_BINDING = 1;
+    static const unsigned int TEXCOORD_BINDING = 2;
+
+    unsigned int VAO = 0;
+    unsigned int EBO = 0;
+    unsigned int positionSSBO = 0;
+    unsigned int normalSSBO = 0;
+    unsigned int texCoordSSBO = 0;
+
+    // std430 pads vec3 arrays to 16 bytes, so positions/normals are stored as vec4 on the cpu side too
+    std::vector<glm::vec4> positions;
+    std::vector<glm::vec4> normals;
+    std::vector<glm::vec2> texCoords;
+    std::vector<unsigned int> indices;
+    std::vector<MeshRange> meshes;
+
+    // append an interleaved mesh, offsets/stride are in floats (same numbers as glVertexAttribPointer)
+    // a negative offset means the attribute is missing. Without indices the mesh is drawn as a triangle list.
+    // ------------------------------------------------------------------------
+    unsigned int addMesh(const float *vertices, unsigned int vertexCount, int stride, int positionOffset, int normalOffset, int texCoordOffset,
+                         const unsigned int *meshIndices = nullptr, unsigned int indexCount = 0)
+    {
+        MeshRange range;
+        range.baseVertex = (unsigned int)positions.size();
+        range.vertexCount = vertexCount;
+        range.firstIndex = (unsigned int)indices.size();
+        range.indexCount = meshIndices ? indexCount : vertexCount;
+
+        for (unsigned int i = 0; i < vertexCount; i++)
+        {
+            const float *v = vertices + i * stride;
+            positions.push_back(positionOffset >= 0 ? glm::vec4(v[positionOffset], v[positionOffset + 1], v[positionOffset + 2], 1.0f) : glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+            normals.push_back(normalOffset >= 0 ? glm::vec4(v[normalOffset], v[normalOffset + 1], v[normalOffset + 2], 0.0f) : glm::vec4(0.0f));
+            texCoords.push_back(texCoordOffset >= 0 ? glm::vec2(v[texCoordOffset], v[texCoordOffset + 1]) : glm::vec2(0.0f));
+        }
+        // indices stay mesh-local, glDrawElementsBaseVertex adds baseVertex and gl_VertexID sees the sum
+        for (unsigned int i = 0; i < range.indexCount; i++)
+            indices.push_back(meshIndices ? meshIndices[i] : i);
+
+        meshes.push_back(range);
+        return (unsigned int)meshes.size() - 1;
+    }
+    // a mesh whose streams stay where they are: owner keeps the memory alive until release(). levels are
+    // index ranges into indices (mesh-local, like addMesh), one mesh each, the first id is returned. The
+    // ranges only point into the pool once upload() has placed the streams, nothing reads them on the cpu
+    // ------------------------------------------------------------------------
+    unsigned int addMappedMesh(std::shared_ptr<const void> owner, const glm::vec4 *meshPositions, const glm::vec4 *meshNormals, const glm::vec2 *meshTexCoords,
+                               unsigned int vertexCount, const unsigned int *meshIndices, unsigned int indexCount, const std::vector<MeshRange> &levels)
+    {
+        MappedMesh mapped = {std::move(owner), meshPositions, meshNormals, meshTexCoords, meshIndices, vertexCount, indexCount,
+                             (unsigned int)meshes.size(), (unsigned int)levels.size(), {}};
+        for (const MeshRange &level : levels)
+        {
+            mapped.firstIndices.push_back(level.firstIndex);
+            meshes.push_back({0, vertexCount, level.firstIndex, level.indexCount});
+        }
+        mappedMeshes.push_back(std::move(mapped));
+        return mappedMeshes.back().firstMesh;
+    }
+    // create the gpu buffers, call once after every mesh has been added. The cpu streams go first, the
+    // mapped meshes after them, each copied by the driver straight from its memory
+    // ------------------------------------------------------------------------
+    void upload()
+    {
+        if (VAO == 0)
+        {
+            glGenVertexArrays(1, &VAO);
+            glGenBuffers(1, &EBO);
+            glGenBuffers(1, &positionSSBO);
+            glGenBuffers(1, &normalSSBO);
+            glGenBuffers(1, &texCoordSSBO);
+        }
+        size_t vertexTotal = positions.size(), indexTotal = indices.size();
+        for (MappedMesh &mapped : mappedMeshes)
+        {
+            for (unsigned int i = 0; i < mapped.meshCount; i++)
+            {
+                meshes[mapped.firstMesh + i].baseVertex = (unsigned int)vertexTotal;
+                meshes[mapped.firstMesh + i].firstIndex = (unsigned int)indexTotal + mapped.firstIndices[i];
+            }
+            vertexTotal += mapped.vertexCount;
+            indexTotal += mapped.indexCount;
+        }
+        uploadStream(positionSSBO, GL_SHADER_STORAGE_BUFFER, positions, vertexTotal, [](const MappedMesh &mapped) { return mapped.positions; });
+        uploadStream(normalSSBO, GL_SHADER_STORAGE_BUFFER, normals, vertexTotal, [](const MappedMesh &mapped) { return mapped.normals; });
+        uploadStream(texCoordSSBO, GL_SHADER_STORAGE_BUFFER, texCoords, vertexTotal, [](const MappedMesh &mapped) { return mapped.texCoords; });
+        glState().bindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+        // no glVertexAttribPointer at all, the VAO only remembers the element buffer
+        glState().bindVertexArray(VAO);
+        uploadStream(EBO, GL_ELEMENT_ARRAY_BUFFER, indices, indexTotal, [](const MappedMesh &mapped) { return mapped.indices; });
+        glState().bindVertexArray(0);
+    }
+    // bind the empty VAO and the attribute streams, once per frame is enough
+    // ------------------------------------------------------------------------
+    void bind() const
+    {
+        glState().bindVertexArray(VAO);
+        glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, POSITION_BINDING, positionSSBO);
+        glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, NORMAL_BINDING, normalSSBO);
+        glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, TEXCOORD_BINDING, texCoordSSBO);
+    }
+    // ------------------------------------------------------------------------
+    void draw(unsigned int mesh, unsigned int instanceCount = 1) const
+    {
+        const MeshRange &range = meshes[mesh];
+        glDrawElementsInstancedBaseVertex(GL_TRIANGLES, range.indexCount, GL_UNSIGNED_INT,
+                                          (void *)(range.firstIndex * sizeof(unsigned int)), instanceCount, range.baseVertex);
+    }
+    // ------------------------------------------------------------------------
+    void release()
+    {
+        glState().deleteVertexArrays(1, &VAO);
+        glState().deleteBuffers(1, &EBO);
+        glState().deleteBuffers(1, &positionSSBO);
+        glState().deleteBuffers(1, &normalSSBO);
+        glState().deleteBuffers(1, &texCoordSSBO);
+        VAO = EBO = positionSSBO = normalSSBO = texCoordSSBO = 0;
+        mappedMeshes.clear();
+    }
+
+private:
+    struct MappedMesh
+    {
+        std::shared_ptr<const void> owner;
+        const glm::vec4 *positions;
+        const glm::vec4 *normals;
+        const glm::vec2 *texCoords;
+        const unsigned int *indices;
+        unsigned int vertexCount, indexCount;
+        unsigned int firstMesh, meshCount;
+        std::vector<unsigned int> firstIndices; // of every level, into indices
+    };
+    std::vector<MappedMesh> mappedMeshes;
+
+    // one buffer: the cpu part, then the same stream of every mapped mesh (stream(mapped) points at it)
+    // ------------------------------------------------------------------------
+    template <typename Element, typename Stream>
+    void uploadStream(unsigned int buffer, GLenum target, const std::vector<Element> &cpuPart, size_t totalCount, Stream stream)
+    {
+        glState().bindBuffer(target, buffer);
+        if (mappedMeshes.empty())
+        {
+            glBufferData(target, cpuPart.size() * sizeof(Element), cpuPart.data(), GL_STATIC_DRAW);
+            return;
+        }
+        glBufferData(target, totalCount * sizeof(Element), NULL, GL_STATIC_DRAW);
+        if (!cpuPart.empty())
+            glBufferSubData(target, 0, cpuPart.size() * sizeof(Element), cpuPart.data());
+        size_t offset = cpuPart.size() * sizeof(Element);
+        for (const MappedMesh &mapped : mappedMeshes)
+        {
+            size_t size = (target == GL_ELEMENT_ARRAY_BUFFER ? mapped.indexCount : mapped.vertexCount) * sizeof(Element);
+            glBufferSubData(target, offset, size, stream(mapped));
+            offset += size;
+        }
+    }
+};
+#endif
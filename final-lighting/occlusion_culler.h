@@ -0,0 +1,403 @@
+#ifndef OCCLUSION_CULLER_H
+#define OCCLUSION_CULLER_H
+
+#include <glm.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "frame_arena.h"
+#include "job_system.h"
+
+// Software occlusion culling on the cpu:
+//  1. the nearest/largest occluder candidates of the frame are picked (screen size estimate)
+//  2. their triangles are binned into 32x32 tiles of a small depth buffer and the tiles are rasterized
+//     in parallel, 8 pixels at a time with AVX2 (depth = ndc z mapped to [0,1], closest wins)
+//  3. a max-depth mip pyramid is built on top
+//  4. isVisible() projects an object's box and compares its closest depth with the pyramid texels
+//     covering its screen rectangle (one level coarse enough that at most 3x3 texels are read)
+// Occluders should be real geometry (or something inside it), never bounding boxes.
+class OcclusionCuller
+{
+public:
+    static const int WIDTH = 256;
+    static const int HEIGHT = 192;
+    static const int TILE_SIZE = 32;
+
+    unsigned int maxOccluders = 16;
+    unsigned int threadCount = std::max(1u, std::thread::hardware_concurrency());
+    JobSystem *jobs = nullptr; // when set, tiles are rasterized as jobs instead of on threads started per frame
+    FrameArena *arena = nullptr; // per-frame scratch (triangles, tile bins), reset by the owner between frames;
+                                 // without one the culler uses its own, reset in beginFrame()
+    // statistics of the last frame
+    unsigned int occludersUsed = 0;
+    unsigned int trianglesRasterized = 0;
+    unsigned int objectsTested = 0;
+    unsigned int objectsOccluded = 0;
+    double rasterMs = 0.0; // selection + binning + rasterization + pyramid
+    double testMs = 0.0;
+
+    // triangle list in local space, returns the id for addOccluder()
+    // ------------------------------------------------------------------------
+    unsigned int addOccluderMesh(const std::vector<glm::vec3> &positions, const std::vector<unsigned int> &indices)
+    {
+        occluderMeshes.push_back({positions, indices});
+        return (unsigned int)occluderMeshes.size() - 1;
+    }
+    // ------------------------------------------------------------------------
+    void beginFrame(const glm::mat4 &viewProjection, const glm::vec3 &cameraPosition)
+    {
+        this->viewProjection = viewProjection;
+        this->cameraPosition = cameraPosition;
+        candidates.clear();
+        if (!arena)
+            ownArena.reset();
+        objectsTested = 0;
+        objectsOccluded = 0;
+        testMs = 0.0;
+    }
+    // a possible occluder with its world bounds (only used to rank the candidates)
+    // ------------------------------------------------------------------------
+    void addOccluder(unsigned int mesh, const glm::mat4 &model, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax)
+    {
+        glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+        float distance = std::max(glm::length(center - cameraPosition), 0.001f);
+        float size = glm::length(boundsMax - boundsMin) / distance;
+        candidates.push_back({mesh, model, size});
+    }
+    // fills the depth buffer and the pyramid, call after all occluders of the frame were added
+    // ------------------------------------------------------------------------
+    void rasterize()
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        std::fill(depth.begin(), depth.end(), 1.0f);
+
+        // biggest on screen first
+        std::sort(candidates.begin(), candidates.end(), [](const Candidate &a, const Candidate &b) { return a.size > b.size; });
+        occludersUsed = std::min((unsigned int)candidates.size(), maxOccluders);
+
+        // transform + bin, all in the frame arena: the triangles, then one array with the triangles of every
+        // tile (tileFirst[tile] up to tileFirst[tile + 1]) from a count pass and a prefix sum
+        FrameArena &scratch = arena ? *arena : ownArena;
+        unsigned int maxTriangles = 0;
+        for (unsigned int i = 0; i < occludersUsed; i++)
+            maxTriangles += (unsigned int)occluderMeshes[candidates[i].mesh].indices.size() / 3;
+        triangles = scratch.allocate<Triangle>(maxTriangles);
+        triangleCount = 0;
+        for (unsigned int i = 0; i < occludersUsed; i++)
+            setupTriangles(candidates[i], scratch);
+        trianglesRasterized = triangleCount;
+        std::fill(tileFirst, tileFirst + TILES_X * TILES_Y + 1, 0u);
+        for (unsigned int i = 0; i < triangleCount; i++)
+            forEachTile(triangles[i], [&](int tile) { tileFirst[tile + 1]++; });
+        for (int tile = 0; tile < TILES_X * TILES_Y; tile++)
+            tileFirst[tile + 1] += tileFirst[tile];
+        tileTriangles = scratch.allocate<unsigned int>(tileFirst[TILES_X * TILES_Y]);
+        unsigned int tileNext[TILES_X * TILES_Y];
+        std::copy(tileFirst, tileFirst + TILES_X * TILES_Y, tileNext);
+        for (unsigned int i = 0; i < triangleCount; i++)
+            forEachTile(triangles[i], [&](int tile) { tileTriangles[tileNext[tile]++] = i; });
+
+        // every tile is owned by one thread, no locking on the depth buffer
+        if (jobs && threadCount > 1)
+        {
+            jobs->parallelFor(TILES_X * TILES_Y, [this](unsigned int first, unsigned int last)
+                              {
+                                  for (unsigned int tile = first; tile < last; tile++)
+                                      rasterizeTile((int)tile);
+                              }, 1);
+        }
+        else
+        {
+            std::atomic<int> nextTile(0);
+            auto worker = [&]()
+            {
+                for (int tile = nextTile++; tile < TILES_X * TILES_Y; tile = nextTile++)
+                    rasterizeTile(tile);
+            };
+            std::vector<std::thread> threads;
+            for (unsigned int i = 1; i < threadCount; i++)
+                threads.emplace_back(worker);
+            worker();
+            for (std::thread &thread : threads)
+                thread.join();
+        }
+
+        buildPyramid();
+        rasterMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+    // false when the box is completely behind the rasterized occluders
+    // ------------------------------------------------------------------------
+    bool isVisible(const glm::vec3 &boundsMin, const glm::vec3 &boundsMax)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        bool visible = testBounds(boundsMin, boundsMax);
+        objectsTested++;
+        if (!visible)
+            objectsOccluded++;
+        testMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        return visible;
+    }
+    // isVisible() for every object whose flag is set, occluded ones get their flag cleared. Split over the job
+    // system when there is one: the pyramid is only read and every flag has a single writer
+    // ------------------------------------------------------------------------
+    void cullObjects(const std::vector<glm::vec3> &boundsMin, const std::vector<glm::vec3> &boundsMax, std::vector<char> &visible)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        std::atomic<unsigned int> tested(0), occluded(0);
+        auto test = [&](unsigned int first, unsigned int last)
+        {
+            unsigned int chunkTested = 0, chunkOccluded = 0;
+            for (unsigned int i = first; i < last; i++)
+            {
+                if (!visible[i])
+                    continue;
+                chunkTested++;
+                if (!testBounds(boundsMin[i], boundsMax[i]))
+                {
+                    visible[i] = 0;
+                    chunkOccluded++;
+                }
+            }
+            tested += chunkTested;
+            occluded += chunkOccluded;
+        };
+        if (jobs && threadCount > 1)
+            jobs->parallelFor((unsigned int)visible.size(), test, 8);
+        else
+            test(0, (unsigned int)visible.size());
+        objectsTested += tested;
+        objectsOccluded += occluded;
+        testMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+
+private:
+    static const int TILES_X = WIDTH / TILE_SIZE;
+    static const int TILES_Y = HEIGHT / TILE_SIZE;
+
+    struct OccluderMesh
+    {
+        std::vector<glm::vec3> positions;
+        std::vector<unsigned int> indices;
+    };
+    struct Candidate
+    {
+        unsigned int mesh;
+        glm::mat4 model;
+        float size;
+    };
+    // screen space triangle ready for the edge function loops
+    struct Triangle
+    {
+        float a[3], b[3], c[3]; // edge i: a*x + b*y + c >= 0 inside
+        float z0, dzdx, dzdy;   // depth at pixel (0,0) and its gradient
+        int minX, minY, maxX, maxY;
+    };
+
+    glm::mat4 viewProjection = glm::mat4(1.0f);
+    glm::vec3 cameraPosition = glm::vec3(0.0f);
+    std::vector<OccluderMesh> occluderMeshes;
+    std::vector<Candidate> candidates;
+    FrameArena ownArena;
+    // this frame's triangles and tile bins, in the frame arena
+    Triangle *triangles = nullptr;
+    unsigned int triangleCount = 0;
+    unsigned int *tileTriangles = nullptr;
+    unsigned int tileFirst[TILES_X * TILES_Y + 1];
+    std::vector<float> depth = std::vector<float>(WIDTH * HEIGHT, 1.0f);
+    std::vector<std::vector<float>> pyramid;   // level 1.. (level 0 is depth)
+    std::vector<glm::ivec2> pyramidSize;
+
+    // ------------------------------------------------------------------------
+    void setupTriangles(const Candidate &candidate, FrameArena &scratch)
+    {
+        const OccluderMesh &mesh = occluderMeshes[candidate.mesh];
+        glm::mat4 transform = viewProjection * candidate.model;
+        glm::vec4 *clip = scratch.allocate<glm::vec4>(mesh.positions.size());
+        for (size_t i = 0; i < mesh.positions.size(); i++)
+            clip[i] = transform * glm::vec4(mesh.positions[i], 1.0f);
+
+        for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+        {
+            glm::vec3 screen[3];
+            bool skip = false;
+            for (int k = 0; k < 3; k++)
+            {
+                const glm::vec4 &v = clip[mesh.indices[i + k]];
+                // crossing the near plane: leaving an occluder out is always safe
+                if (v.w < 0.01f)
+                {
+                    skip = true;
+                    break;
+                }
+                screen[k] = glm::vec3((v.x / v.w * 0.5f + 0.5f) * WIDTH, (v.y / v.w * 0.5f + 0.5f) * HEIGHT, v.z / v.w * 0.5f + 0.5f);
+            }
+            if (skip)
+                continue;
+            float area = (screen[1].x - screen[0].x) * (screen[2].y - screen[0].y) - (screen[2].x - screen[0].x) * (screen[1].y - screen[0].y);
+            if (std::fabs(area) < 1e-6f)
+                continue;
+            if (area < 0.0f) // occluders are closed, both windings are fine
+            {
+                std::swap(screen[1], screen[2]);
+                area = -area;
+            }
+
+            Triangle triangle;
+            triangle.minX = std::max(0, (int)std::floor(std::min(screen[0].x, std::min(screen[1].x, screen[2].x))));
+            triangle.minY = std::max(0, (int)std::floor(std::min(screen[0].y, std::min(screen[1].y, screen[2].y))));
+            triangle.maxX = std::min(WIDTH - 1, (int)std::ceil(std::max(screen[0].x, std::max(screen[1].x, screen[2].x))));
+            triangle.maxY = std::min(HEIGHT - 1, (int)std::ceil(std::max(screen[0].y, std::max(screen[1].y, screen[2].y))));
+            if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+                continue;
+            for (int k = 0; k < 3; k++)
+            {
+                const glm::vec3 &p = screen[k];
+                const glm::vec3 &q = screen[(k + 1) % 3];
+                triangle.a[k] = p.y - q.y;
+                triangle.b[k] = q.x - p.x;
+                triangle.c[k] = p.x * q.y - p.y * q.x;
+            }
+            // plane through the 3 vertices gives z(x, y) = z0 + dzdx * x + dzdy * y
+            glm::vec3 e1 = screen[1] - screen[0], e2 = screen[2] - screen[0];
+            triangle.dzdx = (e1.z * e2.y - e2.z * e1.y) / area;
+            triangle.dzdy = (e2.z * e1.x - e1.z * e2.x) / area;
+            triangle.z0 = screen[0].z - triangle.dzdx * screen[0].x - triangle.dzdy * screen[0].y;
+
+            triangles[triangleCount++] = triangle;
+        }
+    }
+    // fn(tile) for every tile the bounding rectangle of the triangle touches
+    // ------------------------------------------------------------------------
+    template <typename Function>
+    static void forEachTile(const Triangle &triangle, Function fn)
+    {
+        for (int ty = triangle.minY / TILE_SIZE; ty <= triangle.maxY / TILE_SIZE; ty++)
+            for (int tx = triangle.minX / TILE_SIZE; tx <= triangle.maxX / TILE_SIZE; tx++)
+                fn(ty * TILES_X + tx);
+    }
+    // ------------------------------------------------------------------------
+    void rasterizeTile(int tile)
+    {
+        int tileX = (tile % TILES_X) * TILE_SIZE, tileY = (tile / TILES_X) * TILE_SIZE;
+        for (unsigned int k = tileFirst[tile]; k < tileFirst[tile + 1]; k++)
+        {
+            const Triangle &t = triangles[tileTriangles[k]];
+            int minY = std::max(t.minY, tileY), maxY = std::min(t.maxY, tileY + TILE_SIZE - 1);
+            // spans start on a multiple of 8 so every step covers 8 pixels of the same tile row
+            int minX = std::max(t.minX, tileX) & ~7, maxX = std::min(t.maxX, tileX + TILE_SIZE - 1);
+            for (int y = minY; y <= maxY; y++)
+            {
+                float py = y + 0.5f;
+                float *row = &depth[y * WIDTH];
+#if defined(__AVX2__)
+                __m256 zero = _mm256_setzero_ps();
+                __m256 laneOffset = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+                __m256 e0Row = _mm256_set1_ps(t.b[0] * py + t.c[0]), e1Row = _mm256_set1_ps(t.b[1] * py + t.c[1]), e2Row = _mm256_set1_ps(t.b[2] * py + t.c[2]);
+                __m256 a0 = _mm256_set1_ps(t.a[0]), a1 = _mm256_set1_ps(t.a[1]), a2 = _mm256_set1_ps(t.a[2]);
+                __m256 zRow = _mm256_set1_ps(t.z0 + t.dzdy * py), dzdx = _mm256_set1_ps(t.dzdx);
+                for (int x = minX; x <= maxX; x += 8)
+                {
+                    __m256 px = _mm256_add_ps(_mm256_set1_ps((float)x), laneOffset);
+                    __m256 e0 = _mm256_add_ps(_mm256_mul_ps(a0, px), e0Row);
+                    __m256 e1 = _mm256_add_ps(_mm256_mul_ps(a1, px), e1Row);
+                    __m256 e2 = _mm256_add_ps(_mm256_mul_ps(a2, px), e2Row);
+                    __m256 inside = _mm256_and_ps(_mm256_cmp_ps(e0, zero, _CMP_GE_OQ), _mm256_and_ps(_mm256_cmp_ps(e1, zero, _CMP_GE_OQ), _mm256_cmp_ps(e2, zero, _CMP_GE_OQ)));
+                    if (_mm256_movemask_ps(inside) == 0)
+                        continue;
+                    __m256 z = _mm256_add_ps(zRow, _mm256_mul_ps(dzdx, px));
+                    __m256 old = _mm256_loadu_ps(row + x);
+                    _mm256_storeu_ps(row + x, _mm256_blendv_ps(old, _mm256_min_ps(old, z), inside));
+                }
+#else
+                for (int x = minX; x <= maxX; x++)
+                {
+                    float px = x + 0.5f;
+                    if (t.a[0] * px + t.b[0] * py + t.c[0] < 0.0f || t.a[1] * px + t.b[1] * py + t.c[1] < 0.0f || t.a[2] * px + t.b[2] * py + t.c[2] < 0.0f)
+                        continue;
+                    row[x] = std::min(row[x], t.z0 + t.dzdx * px + t.dzdy * py);
+                }
+#endif
+            }
+        }
+    }
+    // each texel keeps the farthest depth of the 2x2 (or edge) texels below it
+    // ------------------------------------------------------------------------
+    void buildPyramid()
+    {
+        if (pyramid.empty())
+        {
+            glm::ivec2 size(WIDTH, HEIGHT);
+            pyramidSize.push_back(size);
+            while (size.x > 1 || size.y > 1)
+            {
+                size = glm::ivec2(std::max(1, (size.x + 1) / 2), std::max(1, (size.y + 1) / 2));
+                pyramidSize.push_back(size);
+                pyramid.push_back(std::vector<float>(size.x * size.y));
+            }
+        }
+        for (size_t level = 1; level < pyramidSize.size(); level++)
+        {
+            const float *source = level == 1 ? depth.data() : pyramid[level - 2].data();
+            glm::ivec2 sourceSize = pyramidSize[level - 1], size = pyramidSize[level];
+            float *target = pyramid[level - 1].data();
+            for (int y = 0; y < size.y; y++)
+            {
+                int y0 = std::min(2 * y, sourceSize.y - 1), y1 = std::min(2 * y + 1, sourceSize.y - 1);
+                for (int x = 0; x < size.x; x++)
+                {
+                    int x0 = std::min(2 * x, sourceSize.x - 1), x1 = std::min(2 * x + 1, sourceSize.x - 1);
+                    target[y * size.x + x] = std::max(std::max(source[y0 * sourceSize.x + x0], source[y0 * sourceSize.x + x1]),
+                                                      std::max(source[y1 * sourceSize.x + x0], source[y1 * sourceSize.x + x1]));
+                }
+            }
+        }
+    }
+    // ------------------------------------------------------------------------
+    bool testBounds(const glm::vec3 &boundsMin, const glm::vec3 &boundsMax) const
+    {
+        glm::vec2 rectMin(INFINITY), rectMax(-INFINITY);
+        float closest = INFINITY;
+        for (int i = 0; i < 8; i++)
+        {
+            glm::vec3 corner(i & 1 ? boundsMax.x : boundsMin.x, i & 2 ? boundsMax.y : boundsMin.y, i & 4 ? boundsMax.z : boundsMin.z);
+            glm::vec4 clip = viewProjection * glm::vec4(corner, 1.0f);
+            if (clip.w < 0.01f) // reaches behind the camera
+                return true;
+            glm::vec2 screen((clip.x / clip.w * 0.5f + 0.5f) * WIDTH, (clip.y / clip.w * 0.5f + 0.5f) * HEIGHT);
+            rectMin = glm::min(rectMin, screen);
+            rectMax = glm::max(rectMax, screen);
+            closest = std::min(closest, clip.z / clip.w * 0.5f + 0.5f);
+        }
+        int minX = std::max(0, (int)std::floor(rectMin.x)), minY = std::max(0, (int)std::floor(rectMin.y));
+        int maxX = std::min(WIDTH - 1, (int)std::floor(rectMax.x)), maxY = std::min(HEIGHT - 1, (int)std::floor(rectMax.y));
+        if (minX > maxX || minY > maxY)
+            return true; // off screen, that is the frustum culler's job
+
+        // coarsest level needed so the rectangle covers at most 2 texels per axis (3 with misalignment)
+        int level = 0;
+        while ((maxX - minX) >> level > 1 || (maxY - minY) >> level > 1)
+            level++;
+        level = std::min(level, (int)pyramidSize.size() - 1);
+        const float *texels = level == 0 ? depth.data() : pyramid[level - 1].data();
+        glm::ivec2 size = pyramidSize[level];
+        for (int y = minY >> level; y <= (maxY >> level) && y < size.y; y++)
+        {
+            for (int x = minX >> level; x <= (maxX >> level) && x < size.x; x++)
+            {
+                if (closest <= texels[y * size.x + x])
+                    return true;
+            }
+        }
+        return false;
+    }
+};
+#endif
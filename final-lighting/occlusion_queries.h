@@ -0,0 +1,141 @@
+#ifndef OCCLUSION_QUERIES_H
+#define OCCLUSION_QUERIES_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <vector>
+
+// Hardware occlusion culling for a few expensive objects, without the cpu ever waiting on the gpu:
+//  - test pass: the object's bounding box is drawn (no color/depth writes) inside an
+//    ANY_SAMPLES_PASSED_CONSERVATIVE query (core since 4.3) on issueQuery(), after the occluders
+//  - draw pass: the real object is drawn inside glBeginConditionalRender on drawCondition(), the gpu
+//    skips it when no sample passed
+// The GL calls themselves are made by whoever draws (RenderQueue wraps query/condition packets).
+// Results are only picked up when GL_QUERY_RESULT_AVAILABLE says so (usually a frame or two later) and
+// feed temporal coherence: an object that was visible is trusted for revisitInterval frames and drawn
+// without a query, occluded objects are queried every frame. Each result is shifted into a 32 bit
+// per-object history (bit 0 = newest, 1 = visible).
+class OcclusionQueries
+{
+public:
+    unsigned int revisitInterval = 4;
+    // statistics, reset with resetStats()
+    unsigned int queriesIssued = 0;
+    unsigned int resultsCollected = 0;
+    unsigned int resultsVisible = 0;
+    unsigned int latencyFrames = 0;   // summed over the collected results
+    unsigned int maxLatencyFrames = 0;
+    unsigned int conditionalDraws = 0;
+    unsigned int plainDraws = 0;
+
+    // ------------------------------------------------------------------------
+    void init(unsigned int objectCount)
+    {
+        objects.resize(objectCount);
+        for (QueryObject &object : objects)
+            glGenQueries(1, &object.query);
+    }
+    // collects whatever results arrived since the last frame, never blocks
+    // ------------------------------------------------------------------------
+    void beginFrame()
+    {
+        frame++;
+        for (QueryObject &object : objects)
+        {
+            object.testedThisFrame = false;
+            if (!object.pending)
+                continue;
+            GLuint available = 0;
+            glGetQueryObjectuiv(object.query, GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+                continue;
+            GLuint passed = 0;
+            glGetQueryObjectuiv(object.query, GL_QUERY_RESULT, &passed);
+            object.pending = false;
+            object.visible = passed != 0;
+            object.history = (object.history << 1) | (object.visible ? 1u : 0u);
+            object.historyLength = std::min(object.historyLength + 1, 32u);
+            unsigned int latency = frame - object.issuedFrame;
+            latencyFrames += latency;
+            maxLatencyFrames = std::max(maxLatencyFrames, latency);
+            resultsCollected++;
+            resultsVisible += object.visible ? 1 : 0;
+        }
+    }
+    // true when the object should get a bounding box query this frame
+    // ------------------------------------------------------------------------
+    bool needsQuery(unsigned int id) const
+    {
+        const QueryObject &object = objects[id];
+        if (object.pending)
+            return false;
+        return !object.visible || frame - object.issuedFrame >= revisitInterval;
+    }
+    // query object to wrap the bounding box draw in, color and depth writes must be off
+    // ------------------------------------------------------------------------
+    unsigned int issueQuery(unsigned int id)
+    {
+        QueryObject &object = objects[id];
+        object.pending = true;
+        object.testedThisFrame = true;
+        object.issuedFrame = frame;
+        queriesIssued++;
+        return object.query;
+    }
+    // query to draw the real object conditionally on: this frame's, or a still pending one for an object that
+    // was occluded. 0 when the object is trusted as visible and drawn normally
+    // ------------------------------------------------------------------------
+    unsigned int drawCondition(unsigned int id)
+    {
+        const QueryObject &object = objects[id];
+        if (object.testedThisFrame || (object.pending && !object.visible))
+        {
+            conditionalDraws++;
+            return object.query;
+        }
+        plainDraws++;
+        return 0;
+    }
+    // last 32 results of one object, bit 0 is the newest
+    // ------------------------------------------------------------------------
+    unsigned int history(unsigned int id) const
+    {
+        return objects[id].history;
+    }
+    // how many of the history bits are real results (up to 32)
+    // ------------------------------------------------------------------------
+    unsigned int historyLength(unsigned int id) const
+    {
+        return objects[id].historyLength;
+    }
+    // ------------------------------------------------------------------------
+    void resetStats()
+    {
+        queriesIssued = resultsCollected = resultsVisible = 0;
+        latencyFrames = maxLatencyFrames = 0;
+        conditionalDraws = plainDraws = 0;
+    }
+    // ------------------------------------------------------------------------
+    void release()
+    {
+        for (QueryObject &object : objects)
+            glDeleteQueries(1, &object.query);
+        objects.clear();
+    }
+
+private:
+    struct QueryObject
+    {
+        unsigned int query = 0;
+        bool pending = false;        // issued, result not read yet
+        bool visible = false;        // last known result, unknown counts as occluded so the first frame queries
+        bool testedThisFrame = false;
+        unsigned int issuedFrame = 0;
+        unsigned int history = 0;
+        unsigned int historyLength = 0;
+    };
+    std::vector<QueryObject> objects;
+    unsigned int frame = 0;
+};
+#endif
@@ -0,0 +1,142 @@
+#ifndef PIPELINE_STATS_H
+#define PIPELINE_STATS_H
+
+#include <glad/glad.h>
+
+#include "gl_state.h"
+
+// ARB_pipeline_statistics_query (core in 4.6), a 4.3 glad header does not have the tokens
+#ifndef GL_VERTEX_SHADER_INVOCATIONS
+#define GL_VERTEX_SHADER_INVOCATIONS 0x82F0
+#endif
+#ifndef GL_FRAGMENT_SHADER_INVOCATIONS
+#define GL_FRAGMENT_SHADER_INVOCATIONS 0x82F4
+#endif
+
+// Counts vertex and fragment shader invocations of everything drawn between begin() and end().
+// Results are read back a few frames later without stalling: while a pair is still in flight
+// begin()/end() do nothing and the last finished result stays in vertices/fragments.
+// Without the extension only GL_SAMPLES_PASSED is available, so fragments are then the samples
+// that passed the depth test and vertices stay 0.
+class PipelineStatsQuery
+{
+public:
+    bool statistics = false;
+    unsigned long long vertices = 0;
+    unsigned long long fragments = 0;
+
+    // ------------------------------------------------------------------------
+    void init()
+    {
+        statistics = hasGLExtension("GL_ARB_pipeline_statistics_query");
+        glGenQueries(2, queries);
+    }
+    // ------------------------------------------------------------------------
+    void begin()
+    {
+        if (pending)
+            return;
+        if (statistics)
+            glBeginQuery(GL_VERTEX_SHADER_INVOCATIONS, queries[0]);
+        glBeginQuery(statistics ? GL_FRAGMENT_SHADER_INVOCATIONS : GL_SAMPLES_PASSED, queries[1]);
+        active = true;
+    }
+    // ------------------------------------------------------------------------
+    void end()
+    {
+        if (!active)
+            return;
+        if (statistics)
+            glEndQuery(GL_VERTEX_SHADER_INVOCATIONS);
+        glEndQuery(statistics ? GL_FRAGMENT_SHADER_INVOCATIONS : GL_SAMPLES_PASSED);
+        active = false;
+        pending = true;
+    }
+    // picks up the result once the gpu is done, returns true when new numbers arrived
+    // ------------------------------------------------------------------------
+    bool poll()
+    {
+        if (!pending)
+            return false;
+        GLuint available = 0;
+        glGetQueryObjectuiv(queries[1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            return false;
+        GLuint64 result = 0;
+        if (statistics)
+        {
+            glGetQueryObjectui64v(queries[0], GL_QUERY_RESULT, &result);
+            vertices = result;
+        }
+        glGetQueryObjectui64v(queries[1], GL_QUERY_RESULT, &result);
+        fragments = result;
+        pending = false;
+        return true;
+    }
+    // ------------------------------------------------------------------------
+    void release()
+    {
+        glDeleteQueries(2, queries);
+    }
+
+private:
+    unsigned int queries[2] = {0, 0};
+    bool active = false;
+    bool pending = false;
+};
+
+// GL_TIME_ELAPSED around a part of the frame, read back the same non-blocking way as PipelineStatsQuery
+class GpuTimer
+{
+public:
+    double milliseconds = 0.0;
+
+    // ------------------------------------------------------------------------
+    void init()
+    {
+        glGenQueries(1, &query);
+    }
+    // ------------------------------------------------------------------------
+    void begin()
+    {
+        if (pending)
+            return;
+        glBeginQuery(GL_TIME_ELAPSED, query);
+        active = true;
+    }
+    // ------------------------------------------------------------------------
+    void end()
+    {
+        if (!active)
+            return;
+        glEndQuery(GL_TIME_ELAPSED);
+        active = false;
+        pending = true;
+    }
+    // ------------------------------------------------------------------------
+    bool poll()
+    {
+        if (!pending)
+            return false;
+        GLuint available = 0;
+        glGetQueryObjectuiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            return false;
+        GLuint64 nanoseconds = 0;
+        glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+        milliseconds = nanoseconds / 1000000.0;
+        pending = false;
+        return true;
+    }
+    // ------------------------------------------------------------------------
+    void release()
+    {
+        glDeleteQueries(1, &query);
+    }
+
+private:
+    unsigned int query = 0;
+    bool active = false;
+    bool pending = false;
+};
+#endif
@@ -0,0 +1,323 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <glad/glad.h>
+#include <glm.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include "command_buffer.h"
+#include "gl_state.h"
+
+// Dense ids for the handles of one frame (program pointers, texture names, VAO + mesh pairs): the handles are
+// collected, sorted and deduplicated, and a handle's id is its position. GL names and pointers can be anything,
+// the ids of a frame are 0..size()-1; past the key field (more distinct handles than it holds) they share the
+// last id, which only costs binds, never correctness. No allocation once reserve() covered the frame.
+class KeyRegistry
+{
+public:
+    // ------------------------------------------------------------------------
+    void reserve(size_t count)
+    {
+        handles.reserve(count);
+    }
+    // ------------------------------------------------------------------------
+    void clear()
+    {
+        handles.clear();
+    }
+    // ------------------------------------------------------------------------
+    void insert(unsigned long long handle)
+    {
+        handles.push_back(handle);
+    }
+    // after the last insert(), before the first id()
+    // ------------------------------------------------------------------------
+    void finish()
+    {
+        std::sort(handles.begin(), handles.end());
+        handles.erase(std::unique(handles.begin(), handles.end()), handles.end());
+    }
+    // ------------------------------------------------------------------------
+    unsigned int id(unsigned long long handle, unsigned int maxId) const
+    {
+        size_t position = std::lower_bound(handles.begin(), handles.end(), handle) - handles.begin();
+        return (unsigned int)std::min(position, (size_t)maxId);
+    }
+    // ------------------------------------------------------------------------
+    size_t size() const
+    {
+        return handles.size();
+    }
+
+private:
+    std::vector<unsigned long long> handles;
+};
+
+// Sorts the frame's packets (recorded straight into the queue or merged from CommandBuffers with append())
+// by a 64 bit key and submits them while skipping program, VAO and texture binds that are already in
+// place (GLStateCache filters the rest). Per-frame uniforms (view, projection, lights) are set by the caller
+// before submit(); deferred ones are flushed together with the packet's own before each draw.
+// Key, most significant first:
+//   opaque:  pass 3 | program 8 | material 12 | mesh 12 | depth 24 | 5 unused   -> state first, then front to back
+//   blended: pass 3 | ~depth 24 | program 8 | material 12 | mesh 12 | 5 unused  -> back to front, state only breaks ties
+// Program, material and mesh are the frame's dense KeyRegistry ids, not GL names: the shader pointer, the
+// texture name and the (VAO, mesh) pair, so pool mesh ids and meshes that are a VAO of their own never collide.
+class RenderQueue : public CommandBuffer
+{
+public:
+    bool depthPrepass = false; // every opaque packet also has a depth packet
+    // statistics of the last submit()
+    unsigned int programBinds = 0;
+    unsigned int vaoBinds = 0;
+    unsigned int textureBinds = 0;
+    unsigned int skippedBinds = 0;
+    unsigned int stateChanges = 0;         // program + VAO + texture binds in sorted order
+    unsigned int unsortedStateChanges = 0; // the same packets in the order they were added
+    double sortMs = 0.0;
+
+    // ------------------------------------------------------------------------
+    void reserve(size_t packetCount, size_t modelCount)
+    {
+        CommandBuffer::reserve(packetCount, modelCount);
+        order.reserve(packetCount);
+        scratch.reserve(packetCount);
+        programs.reserve(packetCount);
+        materials.reserve(packetCount);
+        meshes.reserve(packetCount);
+    }
+    // ------------------------------------------------------------------------
+    static unsigned long long makeKey(unsigned int pass, unsigned int program, unsigned int material, unsigned int mesh, unsigned int depth)
+    {
+        unsigned long long state = ((unsigned long long)program << 24) | ((unsigned long long)material << 12) | mesh;
+        unsigned long long key = (unsigned long long)(pass & 0x7) << 61;
+        if (pass == RENDER_PASS_BLENDED)
+            key |= ((16777215ull - depth) << 37) | (state << 5);
+        else
+            key |= (state << 29) | ((unsigned long long)depth << 5);
+        return key;
+    }
+    // keys from the frame's dense ids, then an LSD radix sort, 8 bits per pass, passes where every key has
+    // the same byte are skipped
+    // ------------------------------------------------------------------------
+    void sort()
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        unsigned int n = (unsigned int)packets.size();
+        programs.clear();
+        materials.clear();
+        meshes.clear();
+        for (const DrawPacket &packet : packets)
+        {
+            programs.insert((unsigned long long)(uintptr_t)packet.shader);
+            materials.insert(packet.material);
+            meshes.insert(meshHandle(packet));
+        }
+        programs.finish();
+        materials.finish();
+        meshes.finish();
+        order.resize(n);
+        scratch.resize(n);
+        for (unsigned int i = 0; i < n; i++)
+        {
+            const DrawPacket &packet = packets[i];
+            unsigned long long key = makeKey(packet.pass, programs.id((unsigned long long)(uintptr_t)packet.shader, 0xFF),
+                                             materials.id(packet.material, 0xFFF), meshes.id(meshHandle(packet), 0xFFF), packet.depth);
+            order[i] = SortItem{key, i};
+        }
+        for (unsigned int shift = 0; shift < 64 && n > 0; shift += 8)
+        {
+            unsigned int counts[256] = {0};
+            for (const SortItem &item : order)
+                counts[(item.key >> shift) & 0xFF]++;
+            if (counts[(order[0].key >> shift) & 0xFF] == n)
+                continue;
+            unsigned int offset = 0;
+            for (unsigned int digit = 0; digit < 256; digit++)
+            {
+                unsigned int count = counts[digit];
+                counts[digit] = offset;
+                offset += count;
+            }
+            for (const SortItem &item : order)
+                scratch[counts[(item.key >> shift) & 0xFF]++] = item;
+            order.swap(scratch);
+        }
+        sortMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+    // draws the sorted packets, depth/color/blend state follows the pass and is reset to the defaults at the end
+    // ------------------------------------------------------------------------
+    void submit()
+    {
+        programBinds = vaoBinds = textureBinds = skippedBinds = 0;
+        unsortedStateChanges = countInsertionOrderChanges();
+
+        BoundState bound;
+        int pass = -1;
+        for (const SortItem &item : order)
+        {
+            const DrawPacket &packet = packets[item.index];
+            int packetPass = (int)packet.pass;
+            if (packetPass != pass)
+            {
+                pass = packetPass;
+                applyPass(pass);
+            }
+            if (packet.shader != bound.shader)
+            {
+                packet.shader->use();
+                bound.shader = packet.shader;
+                programBinds++;
+            }
+            else
+                skippedBinds++;
+            if (packet.VAO != 0)
+            {
+                if (packet.VAO != bound.VAO)
+                {
+                    glState().bindVertexArray(packet.VAO);
+                    bound.VAO = packet.VAO;
+                    vaoBinds++;
+                }
+                else
+                    skippedBinds++;
+            }
+            for (unsigned int unit = 0; unit < RENDER_TEXTURE_UNITS; unit++)
+            {
+                if (packet.textures[unit] == 0)
+                    continue;
+                if (packet.textures[unit] == bound.textures[unit])
+                {
+                    skippedBinds++;
+                    continue;
+                }
+                glState().bindTexture(unit, GL_TEXTURE_2D, packet.textures[unit]);
+                bound.textures[unit] = packet.textures[unit];
+                textureBinds++;
+            }
+            if (packet.instanceOffset >= 0)
+                packet.shader->setInt("instanceOffset"_u, packet.instanceOffset);
+            if (packet.model >= 0)
+                packet.shader->setMat4("model"_u, models[packet.model]);
+            packet.shader->flushUniforms();
+
+            if (packet.query)
+                glBeginQuery(GL_ANY_SAMPLES_PASSED_CONSERVATIVE, packet.query);
+            if (packet.condition)
+                glBeginConditionalRender(packet.condition, GL_QUERY_WAIT);
+            draw(packet);
+            if (packet.condition)
+                glEndConditionalRender();
+            if (packet.query)
+                glEndQuery(GL_ANY_SAMPLES_PASSED_CONSERVATIVE);
+        }
+        glState().colorMask(true);
+        glState().depthMask(true);
+        glState().depthFunc(GL_LESS);
+        glState().setEnabled(GL_BLEND, false);
+        stateChanges = programBinds + vaoBinds + textureBinds;
+    }
+
+private:
+    struct SortItem
+    {
+        unsigned long long key;
+        unsigned int index;
+    };
+    // what is bound right now, GL state is unknown when submit() starts
+    struct BoundState
+    {
+        const Shader *shader = nullptr;
+        unsigned int VAO = 0;
+        unsigned int textures[RENDER_TEXTURE_UNITS] = {0, 0, 0, 0, 0};
+    };
+    std::vector<SortItem> order;
+    std::vector<SortItem> scratch;
+    KeyRegistry programs, materials, meshes;
+
+    // the mesh is only unique together with its VAO
+    // ------------------------------------------------------------------------
+    static unsigned long long meshHandle(const DrawPacket &packet)
+    {
+        return ((unsigned long long)packet.VAO << 32) | packet.mesh;
+    }
+
+    // ------------------------------------------------------------------------
+    void applyPass(int pass)
+    {
+        bool color = pass != RENDER_PASS_DEPTH && pass != RENDER_PASS_QUERY;
+        glState().colorMask(color);
+        if (pass == RENDER_PASS_DEPTH)
+        {
+            glState().depthFunc(GL_LESS);
+            glState().depthMask(true);
+        }
+        else if (pass == RENDER_PASS_QUERY)
+        {
+            glState().depthFunc(GL_LESS);
+            glState().depthMask(false);
+        }
+        else if (pass == RENDER_PASS_OPAQUE)
+        {
+            // LEQUAL lets occluders that were laid down in the depth pass through again
+            glState().depthFunc(depthPrepass ? GL_EQUAL : GL_LEQUAL);
+            glState().depthMask(!depthPrepass);
+        }
+        else if (pass == RENDER_PASS_CUTOUT)
+        {
+            glState().depthFunc(GL_LEQUAL);
+            glState().depthMask(true);
+        }
+        else
+        {
+            glState().depthFunc(GL_LEQUAL);
+            glState().depthMask(false);
+            glState().setEnabled(GL_BLEND, true);
+            glState().blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        }
+    }
+    // ------------------------------------------------------------------------
+    void draw(const DrawPacket &packet) const
+    {
+        if (packet.indexed)
+            glDrawElementsInstancedBaseVertex(packet.mode, packet.count, GL_UNSIGNED_INT, (void *)(packet.first * sizeof(unsigned int)),
+                                              packet.instanceCount, packet.baseVertex);
+        else if (packet.instanceCount != 1)
+            glDrawArraysInstanced(packet.mode, packet.first, packet.count, packet.instanceCount);
+        else
+            glDrawArrays(packet.mode, packet.first, packet.count);
+    }
+    // binds the packets would need without sorting, nothing is drawn
+    // ------------------------------------------------------------------------
+    unsigned int countInsertionOrderChanges() const
+    {
+        BoundState bound;
+        unsigned int changes = 0;
+        for (const DrawPacket &packet : packets)
+        {
+            if (packet.shader != bound.shader)
+            {
+                bound.shader = packet.shader;
+                changes++;
+            }
+            if (packet.VAO != 0 && packet.VAO != bound.VAO)
+            {
+                bound.VAO = packet.VAO;
+                changes++;
+            }
+            for (unsigned int unit = 0; unit < RENDER_TEXTURE_UNITS; unit++)
+            {
+                if (packet.textures[unit] != 0 && packet.textures[unit] != bound.textures[unit])
+                {
+                    bound.textures[unit] = packet.textures[unit];
+                    changes++;
+                }
+            }
+        }
+        return changes;
+    }
+};
+#endif
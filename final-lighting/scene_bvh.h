@@ -0,0 +1,347 @@
+#ifndef SCENE_BVH_H
+#define SCENE_BVH_H
+
+#include <glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "frustum.h"
+
+// one node of the 8-wide BVH, the bounds of its children are stored SoA so one AVX2 register holds
+// the same coordinate of all 8 boxes. A slot is either another node (child >= 0) or an object (~id).
+struct alignas(32) BvhNode
+{
+    float minX[8], minY[8], minZ[8];
+    float maxX[8], maxY[8], maxZ[8];
+    int child[8];
+    int parent;
+    unsigned int parentSlot;
+    unsigned int count;        // used slots
+    unsigned int objectFirst;  // the objects below this node are order[objectFirst, +objectCount)
+    unsigned int objectCount;
+};
+
+// world-space AABB of a local box under model (Arvo: extents go through the absolute rotation/scale)
+// ------------------------------------------------------------------------
+inline void transformBounds(const glm::mat4 &model, const glm::vec3 &localMin, const glm::vec3 &localMax, glm::vec3 &boundsMin, glm::vec3 &boundsMax)
+{
+    glm::vec3 center = glm::vec3(model * glm::vec4((localMin + localMax) * 0.5f, 1.0f));
+    glm::vec3 halfSize = (localMax - localMin) * 0.5f;
+    glm::vec3 extent(0.0f);
+    for (int column = 0; column < 3; column++)
+        extent += glm::abs(glm::vec3(model[column])) * halfSize[column];
+    boundsMin = center - extent;
+    boundsMax = center + extent;
+}
+
+// Scene BVH of world-space AABBs for frustum culling. Built top-down (median splits along the longest
+// axis, 8 children per node). Moving objects call update() and one refit() per frame, which only
+// recomputes the nodes above changed objects; rebuild once needsRebuild() says the tree got too loose.
+// cull() tests a whole node (8 boxes against 6 planes) per step with AVX2 when compiled with -mavx2
+// and takes fully visible subtrees without further tests.
+class SceneBvh
+{
+public:
+    std::vector<BvhNode> nodes;
+    std::vector<unsigned int> order; // object ids, subtree-contiguous
+    unsigned int nodesTested = 0;    // by the last cull()
+
+    // ------------------------------------------------------------------------
+    void build(const std::vector<glm::vec3> &boundsMin, const std::vector<glm::vec3> &boundsMax)
+    {
+        objectMin = boundsMin;
+        objectMax = boundsMax;
+        unsigned int objectCount = (unsigned int)boundsMin.size();
+        objectNode.assign(objectCount, 0);
+        objectSlot.assign(objectCount, 0);
+        order.resize(objectCount);
+        for (unsigned int i = 0; i < objectCount; i++)
+            order[i] = i;
+        nodes.clear();
+        nodes.reserve(objectCount / 4 + 1);
+        buildNode(0, objectCount, -1, 0);
+        dirty.assign(nodes.size(), 0);
+        dirtyCount = 0;
+        highestDirty = 0;
+        builtArea = rootArea();
+    }
+    // new bounds for one object, takes effect at the next refit()
+    // ------------------------------------------------------------------------
+    void update(unsigned int id, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax)
+    {
+        objectMin[id] = boundsMin;
+        objectMax[id] = boundsMax;
+        unsigned int node = objectNode[id];
+        setSlot(nodes[node], objectSlot[id], boundsMin, boundsMax);
+        markDirty(node);
+    }
+    // pushes the changed bounds up to the root. Children always have higher indices than their parent,
+    // so walking down from the highest dirty index handles every node once, after all of its children
+    // ------------------------------------------------------------------------
+    unsigned int refit()
+    {
+        unsigned int refitted = 0;
+        for (unsigned int index = highestDirty; dirtyCount > 0; index--)
+        {
+            if (!dirty[index])
+                continue;
+            dirty[index] = 0;
+            dirtyCount--;
+            refitted++;
+            const BvhNode &node = nodes[index];
+            if (node.parent < 0)
+                continue;
+            glm::vec3 boundsMin, boundsMax;
+            nodeBounds(node, boundsMin, boundsMax);
+            setSlot(nodes[node.parent], node.parentSlot, boundsMin, boundsMax);
+            markDirty(node.parent);
+        }
+        highestDirty = 0;
+        return refitted;
+    }
+    // refitting keeps the topology, once objects moved far the boxes overlap a lot and culling gets worse
+    // ------------------------------------------------------------------------
+    bool needsRebuild() const
+    {
+        return rootArea() > 2.0f * builtArea;
+    }
+    // appends the ids of all objects whose box touches the frustum
+    // ------------------------------------------------------------------------
+    void cull(const Frustum &frustum, std::vector<unsigned int> &visible)
+    {
+        nodesTested = 0;
+        if (nodes.empty())
+            return;
+        unsigned int stack[64];
+        unsigned int stackSize = 0;
+        stack[stackSize++] = 0;
+        while (stackSize > 0)
+        {
+            const BvhNode &node = nodes[stack[--stackSize]];
+            nodesTested++;
+            unsigned int inside, intersecting;
+            testNode(node, frustum, inside, intersecting);
+            for (unsigned int slot = 0; slot < node.count; slot++)
+            {
+                unsigned int bit = 1u << slot;
+                if (!(intersecting & bit))
+                    continue;
+                int child = node.child[slot];
+                if (child < 0)
+                    visible.push_back((unsigned int)~child);
+                else if (inside & bit)
+                    visible.insert(visible.end(), order.begin() + nodes[child].objectFirst,
+                                   order.begin() + nodes[child].objectFirst + nodes[child].objectCount);
+                else
+                    stack[stackSize++] = (unsigned int)child;
+            }
+        }
+    }
+
+private:
+    std::vector<glm::vec3> objectMin, objectMax;
+    std::vector<unsigned int> objectNode, objectSlot;
+    std::vector<char> dirty;
+    unsigned int dirtyCount = 0;
+    unsigned int highestDirty = 0;
+    float builtArea = 0.0f;
+
+    // ------------------------------------------------------------------------
+    void markDirty(unsigned int node)
+    {
+        if (dirty[node])
+            return;
+        dirty[node] = 1;
+        dirtyCount++;
+        highestDirty = std::max(highestDirty, node);
+    }
+
+    // ------------------------------------------------------------------------
+    static void setSlot(BvhNode &node, unsigned int slot, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax)
+    {
+        node.minX[slot] = boundsMin.x;
+        node.minY[slot] = boundsMin.y;
+        node.minZ[slot] = boundsMin.z;
+        node.maxX[slot] = boundsMax.x;
+        node.maxY[slot] = boundsMax.y;
+        node.maxZ[slot] = boundsMax.z;
+    }
+    // ------------------------------------------------------------------------
+    static void nodeBounds(const BvhNode &node, glm::vec3 &boundsMin, glm::vec3 &boundsMax)
+    {
+        boundsMin = glm::vec3(INFINITY);
+        boundsMax = glm::vec3(-INFINITY);
+        for (unsigned int slot = 0; slot < node.count; slot++)
+        {
+            boundsMin = glm::min(boundsMin, glm::vec3(node.minX[slot], node.minY[slot], node.minZ[slot]));
+            boundsMax = glm::max(boundsMax, glm::vec3(node.maxX[slot], node.maxY[slot], node.maxZ[slot]));
+        }
+    }
+    // ------------------------------------------------------------------------
+    float rootArea() const
+    {
+        if (nodes.empty())
+            return 0.0f;
+        glm::vec3 boundsMin, boundsMax;
+        nodeBounds(nodes[0], boundsMin, boundsMax);
+        glm::vec3 size = boundsMax - boundsMin;
+        return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+    }
+    // builds the node for order[first, first + count) and returns its index
+    // ------------------------------------------------------------------------
+    unsigned int buildNode(unsigned int first, unsigned int count, int parent, unsigned int parentSlot)
+    {
+        unsigned int index = (unsigned int)nodes.size();
+        nodes.emplace_back();
+        BvhNode &node = nodes.back();
+        for (int slot = 0; slot < 8; slot++)
+        {
+            node.minX[slot] = node.minY[slot] = node.minZ[slot] = INFINITY;
+            node.maxX[slot] = node.maxY[slot] = node.maxZ[slot] = -INFINITY;
+            node.child[slot] = 0;
+        }
+        node.parent = parent;
+        node.parentSlot = parentSlot;
+        node.count = 0;
+        node.objectFirst = first;
+        node.objectCount = count;
+
+        // three levels of median splits give up to 8 groups. Splits land on multiples of the largest
+        // full subtree size (8, 64, 512...) so all nodes but the last ones on each level are full
+        unsigned int groups[9] = {first, first + count};
+        unsigned int groupCount = 1;
+        if (count > 8)
+        {
+            unsigned int subtree = 8;
+            while (subtree * 8 < count)
+                subtree *= 8;
+            for (int level = 0; level < 3; level++)
+            {
+                unsigned int split[9];
+                unsigned int splitCount = 0;
+                for (unsigned int g = 0; g < groupCount; g++)
+                {
+                    split[splitCount++] = groups[g];
+                    unsigned int size = groups[g + 1] - groups[g];
+                    if (size <= subtree)
+                        continue;
+                    unsigned int subtrees = (size + subtree - 1) / subtree;
+                    unsigned int middle = groups[g] + (subtrees + 1) / 2 * subtree;
+                    splitMedian(groups[g], middle, groups[g + 1]);
+                    split[splitCount++] = middle;
+                }
+                split[splitCount] = groups[groupCount];
+                groupCount = splitCount;
+                std::copy(split, split + splitCount + 1, groups);
+            }
+        }
+        else
+        {
+            for (unsigned int i = 0; i <= count; i++)
+                groups[i] = first + i;
+            groupCount = count;
+        }
+
+        for (unsigned int g = 0; g < groupCount; g++)
+        {
+            unsigned int groupFirst = groups[g], groupSize = groups[g + 1] - groups[g];
+            if (groupSize == 0)
+                continue;
+            unsigned int slot = nodes[index].count++;
+            glm::vec3 boundsMin, boundsMax;
+            if (groupSize == 1)
+            {
+                unsigned int id = order[groupFirst];
+                nodes[index].child[slot] = ~(int)id;
+                objectNode[id] = index;
+                objectSlot[id] = slot;
+                boundsMin = objectMin[id];
+                boundsMax = objectMax[id];
+            }
+            else
+            {
+                unsigned int child = buildNode(groupFirst, groupSize, (int)index, slot); // may reallocate nodes
+                nodes[index].child[slot] = (int)child;
+                nodeBounds(nodes[child], boundsMin, boundsMax);
+            }
+            setSlot(nodes[index], slot, boundsMin, boundsMax);
+        }
+        return index;
+    }
+    // partitions order[first, last) around middle along the longest axis of the box centers
+    // ------------------------------------------------------------------------
+    void splitMedian(unsigned int first, unsigned int middle, unsigned int last)
+    {
+        if (last - first < 2)
+            return;
+        glm::vec3 centerMin(INFINITY), centerMax(-INFINITY);
+        for (unsigned int i = first; i < last; i++)
+        {
+            glm::vec3 center = objectMin[order[i]] + objectMax[order[i]];
+            centerMin = glm::min(centerMin, center);
+            centerMax = glm::max(centerMax, center);
+        }
+        glm::vec3 extent = centerMax - centerMin;
+        int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+        std::nth_element(order.begin() + first, order.begin() + middle, order.begin() + last,
+                         [&](unsigned int a, unsigned int b)
+                         { return objectMin[a][axis] + objectMax[a][axis] < objectMin[b][axis] + objectMax[b][axis]; });
+    }
+    // bit i of intersecting: slot i touches the frustum, bit i of inside: slot i is completely inside
+    // ------------------------------------------------------------------------
+    static void testNode(const BvhNode &node, const Frustum &frustum, unsigned int &inside, unsigned int &intersecting)
+    {
+        unsigned int used = (1u << node.count) - 1;
+#if defined(__AVX2__)
+        __m256 zero = _mm256_setzero_ps();
+        __m256 outsideMask = zero;
+        __m256 partialMask = zero;
+        for (int i = 0; i < 6; i++)
+        {
+            const glm::vec4 &plane = frustum.planes[i];
+            __m256 a = _mm256_set1_ps(plane.x), b = _mm256_set1_ps(plane.y), c = _mm256_set1_ps(plane.z), d = _mm256_set1_ps(plane.w);
+            // p-vertex (furthest along the normal) decides outside, n-vertex decides fully inside
+            __m256 px = _mm256_load_ps(plane.x >= 0.0f ? node.maxX : node.minX);
+            __m256 py = _mm256_load_ps(plane.y >= 0.0f ? node.maxY : node.minY);
+            __m256 pz = _mm256_load_ps(plane.z >= 0.0f ? node.maxZ : node.minZ);
+            __m256 nx = _mm256_load_ps(plane.x >= 0.0f ? node.minX : node.maxX);
+            __m256 ny = _mm256_load_ps(plane.y >= 0.0f ? node.minY : node.maxY);
+            __m256 nz = _mm256_load_ps(plane.z >= 0.0f ? node.minZ : node.maxZ);
+            __m256 pDistance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(px, a), _mm256_mul_ps(py, b)), _mm256_add_ps(_mm256_mul_ps(pz, c), d));
+            __m256 nDistance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx, a), _mm256_mul_ps(ny, b)), _mm256_add_ps(_mm256_mul_ps(nz, c), d));
+            outsideMask = _mm256_or_ps(outsideMask, _mm256_cmp_ps(pDistance, zero, _CMP_LT_OQ));
+            partialMask = _mm256_or_ps(partialMask, _mm256_cmp_ps(nDistance, zero, _CMP_LT_OQ));
+        }
+        unsigned int outside = (unsigned int)_mm256_movemask_ps(outsideMask);
+        unsigned int partial = (unsigned int)_mm256_movemask_ps(partialMask);
+#else
+        unsigned int outside = 0, partial = 0;
+        for (unsigned int slot = 0; slot < node.count; slot++)
+        {
+            for (int i = 0; i < 6; i++)
+            {
+                const glm::vec4 &plane = frustum.planes[i];
+                float p = plane.x * (plane.x >= 0.0f ? node.maxX[slot] : node.minX[slot]) +
+                          plane.y * (plane.y >= 0.0f ? node.maxY[slot] : node.minY[slot]) +
+                          plane.z * (plane.z >= 0.0f ? node.maxZ[slot] : node.minZ[slot]) + plane.w;
+                float n = plane.x * (plane.x >= 0.0f ? node.minX[slot] : node.maxX[slot]) +
+                          plane.y * (plane.y >= 0.0f ? node.minY[slot] : node.maxY[slot]) +
+                          plane.z * (plane.z >= 0.0f ? node.minZ[slot] : node.maxZ[slot]) + plane.w;
+                if (p < 0.0f)
+                    outside |= 1u << slot;
+                if (n < 0.0f)
+                    partial |= 1u << slot;
+            }
+        }
+#endif
+        intersecting = ~outside & used;
+        inside = ~partial & intersecting;
+    }
+};
+#endif
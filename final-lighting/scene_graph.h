@@ -0,0 +1,115 @@
+#ifndef SCENE_GRAPH_H
+#define SCENE_GRAPH_H
+
+#include <glm.hpp>
+
+#include <algorithm>
+#include <vector>
+
+// Parent/child transforms in one flat array kept in depth-first order, so the subtree of a node is the
+// slots [slot, slot + subtreeSize) and every parent comes before its children. setLocal() only marks a
+// node dirty; update() recomputes world = parent world * local for the subtrees of the dirty nodes in one
+// forward pass each, subtrees nobody touched are never visited. Nodes are referred to by the handle add()
+// returned, their slot moves when nodes are inserted in front of them.
+class TransformHierarchy
+{
+public:
+    static const unsigned int NO_PARENT = ~0u;
+    unsigned int recomputed = 0; // world matrices computed by the last update()
+
+    // ------------------------------------------------------------------------
+    unsigned int add(const glm::mat4 &local, unsigned int parent = NO_PARENT)
+    {
+        unsigned int handle = (unsigned int)slots.size();
+        unsigned int parentSlot = parent == NO_PARENT ? NO_PARENT : slots[parent];
+        unsigned int slot = parent == NO_PARENT ? (unsigned int)locals.size() : parentSlot + subtreeSizes[parentSlot];
+        for (unsigned int ancestor = parentSlot; ancestor != NO_PARENT; ancestor = parentSlots[ancestor])
+            subtreeSizes[ancestor]++;
+        // everything from slot on moves one up
+        for (unsigned int &other : parentSlots)
+        {
+            if (other != NO_PARENT && other >= slot)
+                other++;
+        }
+        for (unsigned int &other : slots)
+        {
+            if (other >= slot)
+                other++;
+        }
+        locals.insert(locals.begin() + slot, local);
+        worlds.insert(worlds.begin() + slot, local);
+        parentSlots.insert(parentSlots.begin() + slot, parentSlot);
+        subtreeSizes.insert(subtreeSizes.begin() + slot, 1u);
+        dirty.insert(dirty.begin() + slot, 1);
+        slots.push_back(slot);
+        dirtyNodes.push_back(handle);
+        return handle;
+    }
+    // ------------------------------------------------------------------------
+    void setLocal(unsigned int node, const glm::mat4 &local)
+    {
+        unsigned int slot = slots[node];
+        locals[slot] = local;
+        if (!dirty[slot])
+        {
+            dirty[slot] = 1;
+            dirtyNodes.push_back(node);
+        }
+    }
+    // ------------------------------------------------------------------------
+    const glm::mat4 &local(unsigned int node) const
+    {
+        return locals[slots[node]];
+    }
+    // as of the last update()
+    // ------------------------------------------------------------------------
+    const glm::mat4 &world(unsigned int node) const
+    {
+        return worlds[slots[node]];
+    }
+    // ------------------------------------------------------------------------
+    unsigned int size() const
+    {
+        return (unsigned int)locals.size();
+    }
+    // returns how many world matrices were recomputed
+    // ------------------------------------------------------------------------
+    unsigned int update()
+    {
+        recomputed = 0;
+        if (dirtyNodes.empty())
+            return 0;
+        dirtySlots.clear();
+        for (unsigned int node : dirtyNodes)
+            dirtySlots.push_back(slots[node]);
+        dirtyNodes.clear();
+        std::sort(dirtySlots.begin(), dirtySlots.end());
+        // a dirty node inside a subtree that was just recomputed is already done
+        unsigned int coveredEnd = 0;
+        for (unsigned int first : dirtySlots)
+        {
+            if (first < coveredEnd)
+                continue;
+            unsigned int end = first + subtreeSizes[first];
+            for (unsigned int slot = first; slot < end; slot++)
+            {
+                unsigned int parent = parentSlots[slot];
+                worlds[slot] = parent == NO_PARENT ? locals[slot] : worlds[parent] * locals[slot];
+                dirty[slot] = 0;
+            }
+            recomputed += end - first;
+            coveredEnd = end;
+        }
+        return recomputed;
+    }
+
+private:
+    // by slot
+    std::vector<glm::mat4> locals, worlds;
+    std::vector<unsigned int> parentSlots, subtreeSizes;
+    std::vector<char> dirty;
+    // by handle
+    std::vector<unsigned int> slots;
+    std::vector<unsigned int> dirtyNodes, dirtySlots;
+};
+#endif
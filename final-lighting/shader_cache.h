@@ -0,0 +1,165 @@
+#ifndef SHADER_CACHE_H
+#define SHADER_CACHE_H
+
+#include <GLFW/glfw3.h>
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#include "gl_state.h"
+#include "shader_s.h"
+
+// Programs by source files and define set: get() builds a permutation the first time it is asked for and
+// hands out the same Shader afterwards, so variants that differ only in their defines (light count, lights
+// in a uniform block) share one source and each is compiled once. The cache owns the programs.
+// get() does not wait for the compile. init() picks how the programs build next to the caller: with
+// GL_KHR_parallel_shader_compile on the driver's threads, otherwise on a hidden window whose context shares
+// objects with the caller's, compiled one after the other by a background thread.
+class ShaderCache
+{
+public:
+    unsigned int compiled = 0; // permutations built
+    unsigned int reused = 0;   // get() calls answered from the cache
+
+    // window: the context that draws, current on the calling thread; before the first get()
+    // ------------------------------------------------------------------------
+    void init(GLFWwindow *window)
+    {
+        Shader::parallelCompile = hasGLExtension("GL_KHR_parallel_shader_compile") || hasGLExtension("GL_ARB_parallel_shader_compile");
+        if (Shader::parallelCompile)
+        {
+            // the default thread count is up to the driver, ask for all it wants to use
+            typedef void(APIENTRY * MaxShaderCompilerThreads)(GLuint count);
+            MaxShaderCompilerThreads maxThreads = (MaxShaderCompilerThreads)glfwGetProcAddress("glMaxShaderCompilerThreadsKHR");
+            if (!maxThreads)
+                maxThreads = (MaxShaderCompilerThreads)glfwGetProcAddress("glMaxShaderCompilerThreadsARB");
+            if (maxThreads)
+                maxThreads(0xFFFFFFFF);
+            return;
+        }
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        compileWindow = glfwCreateWindow(1, 1, "shader compiles", NULL, window);
+        glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+        if (compileWindow)
+            compileThread = std::thread(&ShaderCache::compileLoop, this);
+    }
+    // how init() set things up, for the startup report
+    // ------------------------------------------------------------------------
+    const char *mode() const
+    {
+        if (Shader::parallelCompile)
+            return "parallel compile in the driver";
+        return compileWindow ? "background context" : "compiled on the calling thread";
+    }
+
+    // fragmentPath NULL: vertex stage only
+    // ------------------------------------------------------------------------
+    const Shader &get(const char *vertexPath, const char *fragmentPath = NULL, const ShaderDefines &defines = ShaderDefines())
+    {
+        std::string key = std::string(vertexPath) + "|" + (fragmentPath ? fragmentPath : "") + "|" + Shader::definesKey(defines);
+        auto found = programs.find(key);
+        if (found != programs.end())
+        {
+            reused++;
+            return *found->second;
+        }
+        compiled++;
+        bool background = compileThread.joinable();
+        std::unique_ptr<Shader> &program = programs[key];
+        program.reset(fragmentPath ? new Shader(vertexPath, fragmentPath, defines, !background) : new Shader(vertexPath, defines, !background));
+        if (background)
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            queue.push_back(program.get());
+            queueChanged.notify_one();
+        }
+        return *program;
+    }
+    // how many programs are ready, finishing those whose compile is done; never blocks, so compiled on the
+    // calling thread (no parallel compile, no background context) a program only counts after wait()
+    // ------------------------------------------------------------------------
+    unsigned int readyCount() const
+    {
+        unsigned int count = 0;
+        for (const auto &entry : programs)
+            count += entry.second->ready() ? 1 : 0;
+        return count;
+    }
+    // blocks until every program is ready
+    // ------------------------------------------------------------------------
+    void wait() const
+    {
+        for (const auto &entry : programs)
+            entry.second->wait();
+    }
+    // ------------------------------------------------------------------------
+    size_t size() const
+    {
+        return programs.size();
+    }
+    // deletes every program, references from get() are dangling afterwards
+    // ------------------------------------------------------------------------
+    void release()
+    {
+        stopCompileThread();
+        for (auto &entry : programs)
+            glState().deleteProgram(entry.second->ID);
+        programs.clear();
+    }
+    // ------------------------------------------------------------------------
+    ~ShaderCache()
+    {
+        stopCompileThread();
+    }
+
+private:
+    std::unordered_map<std::string, std::unique_ptr<Shader>> programs;
+    // background compiles: programs queued by get(), oldest first
+    GLFWwindow *compileWindow = NULL;
+    std::thread compileThread;
+    std::mutex queueMutex;
+    std::condition_variable queueChanged;
+    std::deque<Shader *> queue;
+    bool stopping = false;
+
+    // ------------------------------------------------------------------------
+    void compileLoop()
+    {
+        glfwMakeContextCurrent(compileWindow);
+        for (;;)
+        {
+            Shader *program;
+            {
+                std::unique_lock<std::mutex> lock(queueMutex);
+                queueChanged.wait(lock, [this]() { return stopping || !queue.empty(); });
+                if (queue.empty())
+                    break;
+                program = queue.front();
+                queue.pop_front();
+            }
+            program->compileAndCheck();
+        }
+        glfwMakeContextCurrent(NULL);
+    }
+    // what is queued still gets compiled, so no program is left waiting
+    // ------------------------------------------------------------------------
+    void stopCompileThread()
+    {
+        if (!compileThread.joinable())
+            return;
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            stopping = true;
+            queueChanged.notify_one();
+        }
+        compileThread.join();
+        glfwDestroyWindow(compileWindow);
+        compileWindow = NULL;
+    }
+};
+#endif
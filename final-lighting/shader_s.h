@@ -0,0 +1,669 @@
+#ifndef SHADER_H
+#define SHADER_H
+
+#include <glad/glad.h>
+#include <glm.hpp>
+
+#include <string>
+#include <string_view>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+#include "gl_state.h"
+#include "uniform_id.h"
+
+// preprocessor defines a program is built with, name -> value ("" for a plain #define NAME); sorted, so
+// the same set always gives the same permutation key
+using ShaderDefines = std::map<std::string, std::string>;
+
+// KHR_parallel_shader_compile, a 4.3 glad header does not have the token
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+// Uniform values go through a shadow copy per location: a set that repeats the value the program already has
+// is dropped. With deferUploads(true) the setters only write the shadow and flushUniforms() uploads whatever
+// changed since the last flush, so the program does not need to be bound while its uniforms are set; call it
+// after use() and before drawing. Code that uploads with glUniform* directly must call invalidateUniforms().
+// Building does not block: the constructor starts the compile and link, ready() reports when they are done.
+class Shader
+{
+public:
+    static const unsigned int MAX_UNIFORM_NAME = 128; // including the terminating zero
+    // uploads of all programs since the last resetUniformCounters(): sent to GL, and dropped because the program
+    // already had the value or (deferred) a later set replaced it before the flush
+    static inline unsigned long long uniformUploads = 0;
+    static inline unsigned long long uniformUploadsSkipped = 0;
+    // GL_KHR_parallel_shader_compile is there, ready() may poll GL_COMPLETION_STATUS_KHR (ShaderCache::init)
+    static inline bool parallelCompile = false;
+    unsigned int ID;
+    // constructor generates the shader on the fly, the sources go through preprocess() with the given defines.
+    // Compiling and linking only start here (see ready()); compileNow false leaves that to compileAndCheck()
+    // on a context that shares objects with this one
+    // ------------------------------------------------------------------------
+    Shader(const char* vertexPath, const char* fragmentPath, const ShaderDefines& defines = ShaderDefines(), bool compileNow = true)
+    {
+        // 1. retrieve the vertex/fragment source code from filePath, includes resolved
+        addSource(GL_VERTEX_SHADER, "VERTEX", vertexPath, defines);
+        addSource(GL_FRAGMENT_SHADER, "FRAGMENT", fragmentPath, defines);
+        ID = glCreateProgram();
+        if (compileNow)
+        {
+            compile();
+            state = BUILD_COMPILING;
+        }
+    }
+    // vertex stage only, for depth-only passes (the depth is written without a fragment shader)
+    // ------------------------------------------------------------------------
+    explicit Shader(const char* vertexPath, const ShaderDefines& defines = ShaderDefines(), bool compileNow = true)
+    {
+        addSource(GL_VERTEX_SHADER, "VERTEX", vertexPath, defines);
+        ID = glCreateProgram();
+        if (compileNow)
+        {
+            compile();
+            state = BUILD_COMPILING;
+        }
+    }
+    // true once the program can be used, never blocks: with GL_KHR_parallel_shader_compile (parallelCompile)
+    // the driver compiles on its own threads and GL_COMPLETION_STATUS_KHR says when it is done, a program
+    // handed to a background context is ready when that context has checked it. Otherwise looking at the
+    // status would wait for the compile, so ready() stays false until wait() (or use()) finishes the program
+    // ------------------------------------------------------------------------
+    bool ready() const
+    {
+        int current = state.load(std::memory_order_acquire);
+        if (current == BUILD_READY)
+            return true;
+        if (current == BUILD_QUEUED || (current == BUILD_COMPILING && !parallelCompile))
+            return false;
+        if (current == BUILD_COMPILING)
+        {
+            GLint done = GL_FALSE;
+            glGetProgramiv(ID, GL_COMPLETION_STATUS_KHR, &done);
+            if (!done)
+                return false;
+        }
+        finish();
+        return true;
+    }
+    // blocks until the program is ready; use() and the hashed uniform lookups call it, so a program that is
+    // still compiling is only waited for where it is first needed
+    // ------------------------------------------------------------------------
+    void wait() const
+    {
+        while (state.load(std::memory_order_acquire) == BUILD_QUEUED)
+            std::this_thread::yield();
+        finish();
+    }
+    // 2. compile the stages and link without looking at the results, on the thread whose context is current
+    // ------------------------------------------------------------------------
+    void compile()
+    {
+        for (Source &source : sources)
+        {
+            const char* code = source.code.c_str();
+            glShaderSource(source.shader, 1, &code, NULL);
+            glCompileShader(source.shader);
+            glAttachShader(ID, source.shader);
+        }
+        glLinkProgram(ID);
+    }
+    // for a background context: compile(), wait for the results and report errors there, then hand the
+    // program over (ready() on the drawing thread only builds the uniform table afterwards)
+    // ------------------------------------------------------------------------
+    void compileAndCheck()
+    {
+        compile();
+        checkStatus();
+        glFinish(); // the link has to be complete before another context relies on it
+        state.store(BUILD_CHECKED, std::memory_order_release);
+    }
+    // the source of path ready for glShaderSource: the defines go in right after #version, every
+    // #include "file" (relative to the including file) is replaced by the file, each file at most once.
+    // #line directives keep compiler messages pointing at the right line; the number after the colon in
+    // "0:12(3): error" is the index of the file in files
+    // ------------------------------------------------------------------------
+    static std::string preprocess(const char* path, const ShaderDefines& defines, std::vector<std::string>& files)
+    {
+        files.clear();
+        std::string code;
+        appendSource(path, defines, files, code);
+        return code;
+    }
+    // the define set as one string, the key of a permutation
+    // ------------------------------------------------------------------------
+    static std::string definesKey(const ShaderDefines& defines)
+    {
+        std::string key;
+        for (const auto& define : defines)
+            key += define.first + "=" + define.second + ";";
+        return key;
+    }
+    // activate the shader
+    // ------------------------------------------------------------------------
+    void use() const
+    {
+        if (!usable)
+            wait();
+        glState().useProgram(ID);
+    }
+    // ------------------------------------------------------------------------
+    static void resetUniformCounters()
+    {
+        uniformUploads = uniformUploadsSkipped = 0;
+    }
+    // turning deferral off flushes, so the program has to be bound then if anything is pending
+    // ------------------------------------------------------------------------
+    void deferUploads(bool defer) const
+    {
+        if (!defer)
+            flushUniforms();
+        deferred = defer;
+    }
+    // uploads the values set since the last flush, the program must be in use
+    // ------------------------------------------------------------------------
+    void flushUniforms() const
+    {
+        for (int uniformLocation : dirtyLocations)
+        {
+            shadows[uniformLocation].dirty = false;
+            send(uniformLocation, shadows[uniformLocation]);
+        }
+        dirtyLocations.clear();
+    }
+    // forget the shadowed values (pending ones stay), the next set of each uniform goes to GL
+    // ------------------------------------------------------------------------
+    void invalidateUniforms() const
+    {
+        for (UniformShadow &shadow : shadows)
+        {
+            if (!shadow.dirty)
+                shadow.size = 0;
+        }
+    }
+    // location of an active uniform, -1 when the program has none by that name (setting -1 is ignored by GL).
+    // Resolve names once and pass the location to the setters below on hot paths
+    // ------------------------------------------------------------------------
+    int location(std::string_view name) const
+    {
+        // glGetUniformLocation wants a terminated string, a stack copy keeps string_views off the heap
+        char terminated[MAX_UNIFORM_NAME];
+        if (name.size() >= sizeof(terminated))
+        {
+            std::cout << "ERROR::SHADER::UNIFORM_NAME_TOO_LONG: " << name << std::endl;
+            return -1;
+        }
+        std::memcpy(terminated, name.data(), name.size());
+        terminated[name.size()] = '\0';
+        return glGetUniformLocation(ID, terminated);
+    }
+    // cached location of a hashed name ("material.shininess"_u): one probe into the table built after linking.
+    // A name the program does not have is reported once and then stays -1
+    // ------------------------------------------------------------------------
+    int location(UniformId uniform) const
+    {
+        if (!usable)
+            wait();
+        unsigned int mask = (unsigned int)uniformSlots.size() - 1;
+        for (unsigned int i = uniform.hash & mask; uniformSlots[i].location != EMPTY_SLOT; i = (i + 1) & mask)
+        {
+            if (uniformSlots[i].hash == uniform.hash)
+                return uniformSlots[i].location;
+        }
+        std::cout << "ERROR::SHADER::UNKNOWN_UNIFORM: " << uniform.name << " (program " << ID << ")" << std::endl;
+        insertUniform(uniform.hash, -1);
+        return -1;
+    }
+    // utility uniform functions, by name, hashed name or location
+    // ------------------------------------------------------------------------
+    void setBool(std::string_view name, bool value) const
+    {
+        setBool(location(name), value);
+    }
+    void setBool(UniformId uniform, bool value) const
+    {
+        setBool(location(uniform), value);
+    }
+    void setBool(int location, bool value) const
+    {
+        int integer = (int)value;
+        store(location, UNIFORM_INT, &integer, 1);
+    }
+    // ------------------------------------------------------------------------
+    void setInt(std::string_view name, int value) const
+    {
+        setInt(location(name), value);
+    }
+    void setInt(UniformId uniform, int value) const
+    {
+        setInt(location(uniform), value);
+    }
+    void setInt(int location, int value) const
+    {
+        store(location, UNIFORM_INT, &value, 1);
+    }
+    // ------------------------------------------------------------------------
+    void setUint(std::string_view name, unsigned int value) const
+    {
+        setUint(location(name), value);
+    }
+    void setUint(UniformId uniform, unsigned int value) const
+    {
+        setUint(location(uniform), value);
+    }
+    void setUint(int location, unsigned int value) const
+    {
+        store(location, UNIFORM_UINT, &value, 1);
+    }
+    // ------------------------------------------------------------------------
+    void setFloat(std::string_view name, float value) const
+    {
+        setFloat(location(name), value);
+    }
+    void setFloat(UniformId uniform, float value) const
+    {
+        setFloat(location(uniform), value);
+    }
+    void setFloat(int location, float value) const
+    {
+        store(location, UNIFORM_FLOAT, &value, 1);
+    }
+    // ------------------------------------------------------------------------
+    void setVec2(std::string_view name, const glm::vec2& value) const
+    {
+        setVec2(location(name), value);
+    }
+    void setVec2(UniformId uniform, const glm::vec2& value) const
+    {
+        setVec2(location(uniform), value);
+    }
+    void setVec2(int location, const glm::vec2& value) const
+    {
+        store(location, UNIFORM_VEC2, &value[0], 2);
+    }
+    void setVec2(std::string_view name, float x, float y) const
+    {
+        setVec2(location(name), glm::vec2(x, y));
+    }
+    // ------------------------------------------------------------------------
+    void setVec3(std::string_view name, const glm::vec3& value) const
+    {
+        setVec3(location(name), value);
+    }
+    void setVec3(UniformId uniform, const glm::vec3& value) const
+    {
+        setVec3(location(uniform), value);
+    }
+    void setVec3(int location, const glm::vec3& value) const
+    {
+        store(location, UNIFORM_VEC3, &value[0], 3);
+    }
+    void setVec3(std::string_view name, float x, float y, float z) const
+    {
+        setVec3(location(name), glm::vec3(x, y, z));
+    }
+    void setVec3(UniformId uniform, float x, float y, float z) const
+    {
+        setVec3(location(uniform), glm::vec3(x, y, z));
+    }
+    // ------------------------------------------------------------------------
+    void setVec4(std::string_view name, const glm::vec4& value) const
+    {
+        setVec4(location(name), value);
+    }
+    void setVec4(UniformId uniform, const glm::vec4& value) const
+    {
+        setVec4(location(uniform), value);
+    }
+    void setVec4(int location, const glm::vec4& value) const
+    {
+        store(location, UNIFORM_VEC4, &value[0], 4);
+    }
+    void setVec4(std::string_view name, float x, float y, float z, float w) const
+    {
+        setVec4(location(name), glm::vec4(x, y, z, w));
+    }
+    // ------------------------------------------------------------------------
+    void setMat2(std::string_view name, const glm::mat2& mat) const
+    {
+        store(location(name), UNIFORM_MAT2, &mat[0][0], 4);
+    }
+    // ------------------------------------------------------------------------
+    void setMat3(std::string_view name, const glm::mat3& mat) const
+    {
+        store(location(name), UNIFORM_MAT3, &mat[0][0], 9);
+    }
+    // ------------------------------------------------------------------------
+    void setMat4(std::string_view name, const glm::mat4& mat) const
+    {
+        setMat4(location(name), mat);
+    }
+    void setMat4(UniformId uniform, const glm::mat4& mat) const
+    {
+        setMat4(location(uniform), mat);
+    }
+    void setMat4(int location, const glm::mat4& mat) const
+    {
+        store(location, UNIFORM_MAT4, &mat[0][0], 16);
+    }
+
+protected:
+    // a program of one stage of any type (ComputeShader), built like the others
+    // ------------------------------------------------------------------------
+    Shader(GLenum type, const char* typeName, const char* path, const ShaderDefines& defines, bool compileNow)
+    {
+        addSource(type, typeName, path, defines);
+        ID = glCreateProgram();
+        if (compileNow)
+        {
+            compile();
+            state = BUILD_COMPILING;
+        }
+    }
+
+private:
+    enum BuildState
+    {
+        BUILD_QUEUED,    // sources only, waiting for compileAndCheck() on a background context
+        BUILD_COMPILING, // compile() issued here, the results are not looked at yet
+        BUILD_CHECKED,   // compiled and checked on a background context
+        BUILD_READY      // uniform table built, the sources are gone
+    };
+    struct Source
+    {
+        GLenum type;
+        const char* typeName; // for error messages
+        std::string code;
+        std::vector<std::string> files;
+        unsigned int shader;
+    };
+    mutable std::vector<Source> sources; // until the program is ready
+    mutable std::atomic<int> state{BUILD_QUEUED};
+    mutable bool usable = false; // state is BUILD_READY, without the atomic load on every use()
+
+    static const int EMPTY_SLOT = -2;
+    struct UniformSlot
+    {
+        unsigned int hash;
+        int location; // -1: looked up but not in the program
+    };
+    // open addressing on the hash, at most half full; the misses location() reports go in at run time
+    mutable std::vector<UniformSlot> uniformSlots;
+    mutable unsigned int uniformCount = 0;
+
+    enum UniformKind : unsigned char
+    {
+        UNIFORM_INT, // ints, bools and samplers
+        UNIFORM_UINT,
+        UNIFORM_FLOAT,
+        UNIFORM_VEC2,
+        UNIFORM_VEC3,
+        UNIFORM_VEC4,
+        UNIFORM_MAT2,
+        UNIFORM_MAT3,
+        UNIFORM_MAT4
+    };
+    struct UniformShadow
+    {
+        float value[16];        // the last value set, up to a mat4 (ints and uints bit for bit)
+        unsigned char size = 0;  // in 4 byte words, 0: unknown, the next set goes through
+        UniformKind kind = UNIFORM_INT;
+        bool dirty = false; // deferred: set but not uploaded yet
+    };
+    // indexed by location, every active uniform has one; dirtyLocations has room for all of them
+    mutable std::vector<UniformShadow> shadows;
+    mutable std::vector<int> dirtyLocations;
+    mutable bool deferred = false;
+
+    // ------------------------------------------------------------------------
+    void store(int uniformLocation, UniformKind kind, const void *value, unsigned int words) const
+    {
+        if (uniformLocation < 0)
+            return;
+        if (uniformLocation >= (int)shadows.size())
+        {
+            // not a location of this program's table, nothing to compare with
+            UniformShadow direct;
+            std::memcpy(direct.value, value, words * 4);
+            direct.kind = kind;
+            send(uniformLocation, direct);
+            return;
+        }
+        UniformShadow &shadow = shadows[uniformLocation];
+        if (shadow.size == words && shadow.kind == kind && std::memcmp(shadow.value, value, words * 4) == 0)
+        {
+            uniformUploadsSkipped++;
+            return;
+        }
+        std::memcpy(shadow.value, value, words * 4);
+        shadow.size = (unsigned char)words;
+        shadow.kind = kind;
+        if (!deferred)
+            send(uniformLocation, shadow);
+        else if (shadow.dirty)
+            uniformUploadsSkipped++; // the value waiting for the flush never reaches GL
+        else
+        {
+            shadow.dirty = true;
+            dirtyLocations.push_back(uniformLocation);
+        }
+    }
+    // ------------------------------------------------------------------------
+    static void send(int uniformLocation, const UniformShadow &shadow)
+    {
+        uniformUploads++;
+        const float *floats = shadow.value;
+        switch (shadow.kind)
+        {
+        case UNIFORM_INT: glUniform1iv(uniformLocation, 1, (const GLint *)floats); break;
+        case UNIFORM_UINT: glUniform1uiv(uniformLocation, 1, (const GLuint *)floats); break;
+        case UNIFORM_FLOAT: glUniform1fv(uniformLocation, 1, floats); break;
+        case UNIFORM_VEC2: glUniform2fv(uniformLocation, 1, floats); break;
+        case UNIFORM_VEC3: glUniform3fv(uniformLocation, 1, floats); break;
+        case UNIFORM_VEC4: glUniform4fv(uniformLocation, 1, floats); break;
+        case UNIFORM_MAT2: glUniformMatrix2fv(uniformLocation, 1, GL_FALSE, floats); break;
+        case UNIFORM_MAT3: glUniformMatrix3fv(uniformLocation, 1, GL_FALSE, floats); break;
+        case UNIFORM_MAT4: glUniformMatrix4fv(uniformLocation, 1, GL_FALSE, floats); break;
+        }
+    }
+
+    // ------------------------------------------------------------------------
+    void addSource(GLenum type, const char* typeName, const char* path, const ShaderDefines& defines)
+    {
+        Source source;
+        source.type = type;
+        source.typeName = typeName;
+        source.code = preprocess(path, defines, source.files);
+        source.shader = glCreateShader(type);
+        sources.push_back(std::move(source));
+    }
+    // compile and link errors, waits for both when they are not done yet
+    // ------------------------------------------------------------------------
+    void checkStatus() const
+    {
+        for (const Source &source : sources)
+            checkCompileErrors(source.shader, source.typeName, source.files);
+        checkCompileErrors(ID, "PROGRAM");
+        // delete the shaders as they're linked into our program now and no longer necessary
+        for (const Source &source : sources)
+            glDeleteShader(source.shader);
+    }
+    // on the drawing thread, once the compile is done or checked elsewhere
+    // ------------------------------------------------------------------------
+    void finish() const
+    {
+        int current = state.load(std::memory_order_acquire);
+        if (current == BUILD_READY)
+            return;
+        if (current == BUILD_COMPILING)
+            checkStatus();
+        buildUniformTable();
+        std::vector<Source>().swap(sources);
+        state.store(BUILD_READY, std::memory_order_release);
+        usable = true;
+    }
+    // every active uniform, array elements by index as well ("planes[3]") and arrays by their bare name
+    // ------------------------------------------------------------------------
+    void buildUniformTable() const
+    {
+        uniformSlots.assign(16, UniformSlot{0, EMPTY_SLOT});
+        uniformCount = 0;
+        shadows.clear();
+        dirtyLocations.clear();
+        GLint count = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+        for (GLint i = 0; i < count; i++)
+        {
+            char name[MAX_UNIFORM_NAME];
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type;
+            glGetActiveUniform(ID, (GLuint)i, sizeof(name), &length, &size, &type, name);
+            std::string_view base(name, length);
+            if (size > 1 && base.size() > 3 && base.substr(base.size() - 3) == "[0]")
+            {
+                base.remove_suffix(3);
+                addUniform(base);
+                for (GLint element = 0; element < size; element++)
+                    addUniform(std::string(base) + "[" + std::to_string(element) + "]");
+            }
+            else
+                addUniform(base);
+        }
+        dirtyLocations.reserve(shadows.size());
+    }
+    // ------------------------------------------------------------------------
+    void addUniform(std::string_view name) const
+    {
+        int uniformLocation = location(name);
+        if (uniformLocation < 0)
+            return; // block members and atomic counters have no location
+        unsigned int hash = uniformHash(name.data(), name.size());
+        unsigned int mask = (unsigned int)uniformSlots.size() - 1;
+        for (unsigned int i = hash & mask; uniformSlots[i].location != EMPTY_SLOT; i = (i + 1) & mask)
+        {
+            if (uniformSlots[i].hash == hash)
+            {
+                std::cout << "ERROR::SHADER::UNIFORM_HASH_COLLISION: " << name << " (program " << ID << ")" << std::endl;
+                return;
+            }
+        }
+        insertUniform(hash, uniformLocation);
+        if (uniformLocation >= (int)shadows.size())
+            shadows.resize(uniformLocation + 1);
+    }
+    // ------------------------------------------------------------------------
+    void insertUniform(unsigned int hash, int uniformLocation) const
+    {
+        if ((uniformCount + 1) * 2 > uniformSlots.size())
+        {
+            std::vector<UniformSlot> old(uniformSlots.size() * 2, UniformSlot{0, EMPTY_SLOT});
+            old.swap(uniformSlots);
+            uniformCount = 0;
+            for (const UniformSlot &slot : old)
+            {
+                if (slot.location != EMPTY_SLOT)
+                    insertUniform(slot.hash, slot.location);
+            }
+        }
+        unsigned int mask = (unsigned int)uniformSlots.size() - 1;
+        unsigned int i = hash & mask;
+        while (uniformSlots[i].location != EMPTY_SLOT)
+            i = (i + 1) & mask;
+        uniformSlots[i] = UniformSlot{hash, uniformLocation};
+        uniformCount++;
+    }
+    // ------------------------------------------------------------------------
+    static void appendSource(const std::string& path, const ShaderDefines& defines, std::vector<std::string>& files, std::string& code)
+    {
+        std::string source;
+        std::ifstream file;
+        // ensure ifstream objects can throw exceptions:
+        file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+        try
+        {
+            file.open(path);
+            std::stringstream stream;
+            stream << file.rdbuf();
+            file.close();
+            source = stream.str();
+        }
+        catch (std::ifstream::failure& e)
+        {
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << path << " " << e.what() << std::endl;
+            return;
+        }
+        size_t fileIndex = files.size();
+        files.push_back(path);
+        std::string directory = path.substr(0, path.find_last_of("/\\") + 1);
+        std::istringstream lines(source);
+        std::string line;
+        for (unsigned int number = 1; std::getline(lines, line); number++)
+        {
+            size_t start = line.find_first_not_of(" \t");
+            std::string_view directive = start == std::string::npos ? std::string_view() : std::string_view(line).substr(start);
+            if (directive.substr(0, 8) == "#version" && fileIndex == 0)
+            {
+                code += line + "\n";
+                for (const auto& define : defines)
+                    code += "#define " + define.first + " " + define.second + "\n";
+                code += "#line " + std::to_string(number + 1) + " 0\n";
+            }
+            else if (directive.substr(0, 8) == "#include")
+            {
+                size_t open = directive.find('"');
+                size_t close = open == std::string_view::npos ? open : directive.find('"', open + 1);
+                if (close == std::string_view::npos)
+                {
+                    std::cout << "ERROR::SHADER::BAD_INCLUDE: " << path << ":" << number << " " << line << std::endl;
+                    continue;
+                }
+                std::string included = directory + std::string(directive.substr(open + 1, close - open - 1));
+                if (std::find(files.begin(), files.end(), included) != files.end())
+                    continue; // already in, the line stays empty
+                code += "#line 1 " + std::to_string(files.size()) + "\n";
+                appendSource(included, defines, files, code);
+                code += "#line " + std::to_string(number + 1) + " " + std::to_string(fileIndex) + "\n";
+            }
+            else
+                code += line + "\n";
+        }
+    }
+    // utility function for checking shader compilation/linking errors.
+    // ------------------------------------------------------------------------
+    static void checkCompileErrors(GLuint shader, std::string type, const std::vector<std::string>& files = std::vector<std::string>())
+    {
+        GLint success;
+        GLchar infoLog[1024];
+        if (type != "PROGRAM")
+        {
+            glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+            if (!success)
+            {
+                glGetShaderInfoLog(shader, 1024, NULL, infoLog);
+                std::cout << "ERROR::SHADER_COMPILATION_ERROR of type: " << type << "\n" << infoLog;
+                for (size_t i = 0; i < files.size(); i++)
+                    std::cout << "  source " << i << ": " << files[i] << "\n";
+                std::cout << " -- --------------------------------------------------- -- " << std::endl;
+            }
+        }
+        else
+        {
+            glGetProgramiv(shader, GL_LINK_STATUS, &success);
+            if (!success)
+            {
+                glGetProgramInfoLog(shader, 1024, NULL, infoLog);
+                std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
+            }
+        }
+    }
+};
+#endif
\ No newline at end of file
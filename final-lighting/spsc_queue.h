@@ -0,0 +1,43 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <atomic>
+
+// Lock-free single producer / single consumer ring buffer. Capacity must be a power of two.
+// head is only written by the producer, tail only by the consumer; each sits on its own cache line
+// so the two threads do not bounce one line between them. push() fails when full, pop() when empty.
+template <typename T, unsigned int Capacity>
+class SpscQueue
+{
+    static_assert((Capacity & (Capacity - 1)) == 0, "SpscQueue capacity must be a power of two");
+
+public:
+    // producer side
+    // ------------------------------------------------------------------------
+    bool push(const T &item)
+    {
+        unsigned int h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) == Capacity)
+            return false;
+        items[h & (Capacity - 1)] = item;
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+    // consumer side
+    // ------------------------------------------------------------------------
+    bool pop(T &item)
+    {
+        unsigned int t = tail.load(std::memory_order_relaxed);
+        if (t == head.load(std::memory_order_acquire))
+            return false;
+        item = items[t & (Capacity - 1)];
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    alignas(64) std::atomic<unsigned int> head{0};
+    alignas(64) std::atomic<unsigned int> tail{0};
+    alignas(64) T items[Capacity];
+};
+#endif
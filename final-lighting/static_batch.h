@@ -0,0 +1,236 @@
+#ifndef STATIC_BATCH_H
+#define STATIC_BATCH_H
+
+#include <glad/glad.h>
+#include <glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <vector>
+
+#include "frustum.h"
+#include "gl_state.h"
+
+// one spatial chunk of a batch, a contiguous index range with its world-space bounds
+struct StaticChunk
+{
+    glm::vec3 boundsMin;
+    glm::vec3 boundsMax;
+    unsigned int firstIndex;
+    unsigned int indexCount;
+};
+
+// all static geometry of one material, already in world space
+struct StaticBatch
+{
+    unsigned int material;
+    unsigned int VAO, VBO, EBO;
+    std::vector<StaticChunk> chunks;
+};
+
+// a run of neighbouring visible chunks of one batch, one glDrawElements
+struct StaticRun
+{
+    unsigned int VAO;
+    unsigned int firstIndex;
+    unsigned int indexCount;
+    glm::vec3 boundsMin;
+    glm::vec3 boundsMax;
+};
+
+// Static batching: meshes that never move are pre-transformed into world space at load time and
+// merged per material into one vertex/index buffer. Inside a batch the geometry is sorted by grid
+// cell so every chunk is a contiguous index range that can be culled on its own, and runs of
+// visible chunks are drawn with a single glDrawElements. Draw with model = identity.
+// Vertex layout is the usual position(3) normal(3) texcoord(2).
+class StaticBatcher
+{
+public:
+    static const int VERTEX_FLOATS = 8;
+
+    std::vector<StaticBatch> batches;
+    unsigned int objectCount = 0;
+    unsigned int drawCalls = 0; // issued by the last draw() / collect()
+
+    // queue one object, vertices in the 8-float layout above, without indices it is a triangle list
+    // ------------------------------------------------------------------------
+    void add(const float *vertices, unsigned int vertexCount, const glm::mat4 &model, unsigned int material,
+             const unsigned int *indices = nullptr, unsigned int indexCount = 0)
+    {
+        PendingObject object;
+        object.material = material;
+        glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(model)));
+        object.boundsMin = glm::vec3(INFINITY);
+        object.boundsMax = glm::vec3(-INFINITY);
+        for (unsigned int i = 0; i < vertexCount; i++)
+        {
+            const float *v = vertices + i * VERTEX_FLOATS;
+            glm::vec3 position = glm::vec3(model * glm::vec4(v[0], v[1], v[2], 1.0f));
+            glm::vec3 normal = glm::normalize(normalMatrix * glm::vec3(v[3], v[4], v[5]));
+            object.boundsMin = glm::min(object.boundsMin, position);
+            object.boundsMax = glm::max(object.boundsMax, position);
+            float out[VERTEX_FLOATS] = {position.x, position.y, position.z, normal.x, normal.y, normal.z, v[6], v[7]};
+            object.vertices.insert(object.vertices.end(), out, out + VERTEX_FLOATS);
+        }
+        for (unsigned int i = 0; i < (indices ? indexCount : vertexCount); i++)
+            object.indices.push_back(indices ? indices[i] : i);
+        pending.push_back(object);
+        objectCount++;
+    }
+    // merge everything queued so far, chunkSize is the edge length of the grid cells in world units
+    // ------------------------------------------------------------------------
+    void build(float chunkSize)
+    {
+        // group by material, then by the grid cell of the object's center
+        std::map<unsigned int, std::map<CellKey, std::vector<unsigned int>>> groups;
+        for (unsigned int i = 0; i < pending.size(); i++)
+        {
+            glm::vec3 center = (pending[i].boundsMin + pending[i].boundsMax) * 0.5f;
+            CellKey cell = {(int)std::floor(center.x / chunkSize), (int)std::floor(center.y / chunkSize), (int)std::floor(center.z / chunkSize)};
+            groups[pending[i].material][cell].push_back(i);
+        }
+
+        for (auto &materialGroup : groups)
+        {
+            StaticBatch batch;
+            batch.material = materialGroup.first;
+            std::vector<float> vertices;
+            std::vector<unsigned int> indices;
+            for (auto &cell : materialGroup.second)
+            {
+                StaticChunk chunk;
+                chunk.boundsMin = glm::vec3(INFINITY);
+                chunk.boundsMax = glm::vec3(-INFINITY);
+                chunk.firstIndex = (unsigned int)indices.size();
+                for (unsigned int objectIndex : cell.second)
+                {
+                    const PendingObject &object = pending[objectIndex];
+                    unsigned int baseVertex = (unsigned int)(vertices.size() / VERTEX_FLOATS);
+                    vertices.insert(vertices.end(), object.vertices.begin(), object.vertices.end());
+                    for (unsigned int index : object.indices)
+                        indices.push_back(baseVertex + index);
+                    chunk.boundsMin = glm::min(chunk.boundsMin, object.boundsMin);
+                    chunk.boundsMax = glm::max(chunk.boundsMax, object.boundsMax);
+                }
+                chunk.indexCount = (unsigned int)indices.size() - chunk.firstIndex;
+                batch.chunks.push_back(chunk);
+            }
+
+            glGenVertexArrays(1, &batch.VAO);
+            glGenBuffers(1, &batch.VBO);
+            glGenBuffers(1, &batch.EBO);
+            glState().bindVertexArray(batch.VAO);
+            glState().bindBuffer(GL_ARRAY_BUFFER, batch.VBO);
+            glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+            glState().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, batch.EBO);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, VERTEX_FLOATS * sizeof(float), (void *)0);
+            glEnableVertexAttribArray(0);
+            glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, VERTEX_FLOATS * sizeof(float), (void *)(3 * sizeof(float)));
+            glEnableVertexAttribArray(1);
+            glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, VERTEX_FLOATS * sizeof(float), (void *)(6 * sizeof(float)));
+            glEnableVertexAttribArray(2);
+            glState().bindVertexArray(0);
+            batches.push_back(batch);
+        }
+        // the cpu copies are not needed anymore
+        pending.clear();
+        pending.shrink_to_fit();
+    }
+    // draw the chunks of one material that touch the frustum, neighbouring visible chunks share a draw call
+    // ------------------------------------------------------------------------
+    void draw(unsigned int material, const Frustum &frustum)
+    {
+        drawRuns.clear();
+        collect(material, frustum, drawRuns);
+        for (const StaticRun &run : drawRuns)
+        {
+            glState().bindVertexArray(run.VAO);
+            glDrawElements(GL_TRIANGLES, run.indexCount, GL_UNSIGNED_INT, (void *)(run.firstIndex * sizeof(unsigned int)));
+        }
+    }
+    // appends the runs draw() would issue, for callers that sort their draws themselves (render_queue.h)
+    // ------------------------------------------------------------------------
+    void collect(unsigned int material, const Frustum &frustum, std::vector<StaticRun> &runs)
+    {
+        drawCalls = 0;
+        for (const StaticBatch &batch : batches)
+        {
+            if (batch.material != material)
+                continue;
+            StaticRun run = {batch.VAO, 0, 0, glm::vec3(0.0f), glm::vec3(0.0f)};
+            for (const StaticChunk &chunk : batch.chunks)
+            {
+                if (frustum.intersects(chunk.boundsMin, chunk.boundsMax))
+                {
+                    if (run.indexCount == 0)
+                    {
+                        run.firstIndex = chunk.firstIndex;
+                        run.boundsMin = chunk.boundsMin;
+                        run.boundsMax = chunk.boundsMax;
+                    }
+                    run.indexCount += chunk.indexCount;
+                    run.boundsMin = glm::min(run.boundsMin, chunk.boundsMin);
+                    run.boundsMax = glm::max(run.boundsMax, chunk.boundsMax);
+                    continue;
+                }
+                flush(run, runs);
+            }
+            flush(run, runs);
+        }
+    }
+    // ------------------------------------------------------------------------
+    unsigned int chunkCount() const
+    {
+        unsigned int count = 0;
+        for (const StaticBatch &batch : batches)
+            count += (unsigned int)batch.chunks.size();
+        return count;
+    }
+    // ------------------------------------------------------------------------
+    void release()
+    {
+        for (StaticBatch &batch : batches)
+        {
+            glState().deleteVertexArrays(1, &batch.VAO);
+            glState().deleteBuffers(1, &batch.VBO);
+            glState().deleteBuffers(1, &batch.EBO);
+        }
+        batches.clear();
+    }
+
+private:
+    struct PendingObject
+    {
+        unsigned int material;
+        glm::vec3 boundsMin, boundsMax;
+        std::vector<float> vertices;
+        std::vector<unsigned int> indices;
+    };
+    struct CellKey
+    {
+        int x, y, z;
+        bool operator<(const CellKey &other) const
+        {
+            if (x != other.x)
+                return x < other.x;
+            if (y != other.y)
+                return y < other.y;
+            return z < other.z;
+        }
+    };
+    std::vector<PendingObject> pending;
+    std::vector<StaticRun> drawRuns;
+
+    // ------------------------------------------------------------------------
+    void flush(StaticRun &run, std::vector<StaticRun> &runs)
+    {
+        if (run.indexCount == 0)
+            return;
+        runs.push_back(run);
+        drawCalls++;
+        run.indexCount = 0;
+    }
+};
+#endif
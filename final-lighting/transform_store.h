@@ -0,0 +1,144 @@
+#ifndef TRANSFORM_STORE_H
+#define TRANSFORM_STORE_H
+
+#include <glm.hpp>
+#include <gtc/quaternion.hpp>
+
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// Position, rotation and scale of many objects stored SoA (one array per component), so compose() reads
+// the same component of 8 objects with one load. compose() builds world = T * R(q) * S and writes the
+// matrices straight into an instance array (glm::mat4, column major), 8 at a time with AVX2 when compiled
+// with -mavx2, one at a time otherwise and for the tail. Rotations must be unit quaternions.
+class TransformStore
+{
+public:
+    std::vector<float> px, py, pz;
+    std::vector<float> qx, qy, qz, qw;
+    std::vector<float> sx, sy, sz;
+
+    // ------------------------------------------------------------------------
+    unsigned int add(const glm::vec3 &position, const glm::quat &rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f), const glm::vec3 &scale = glm::vec3(1.0f))
+    {
+        px.push_back(position.x);
+        py.push_back(position.y);
+        pz.push_back(position.z);
+        qx.push_back(rotation.x);
+        qy.push_back(rotation.y);
+        qz.push_back(rotation.z);
+        qw.push_back(rotation.w);
+        sx.push_back(scale.x);
+        sy.push_back(scale.y);
+        sz.push_back(scale.z);
+        return (unsigned int)px.size() - 1;
+    }
+    // ------------------------------------------------------------------------
+    unsigned int size() const
+    {
+        return (unsigned int)px.size();
+    }
+    // ------------------------------------------------------------------------
+    glm::vec3 position(unsigned int i) const
+    {
+        return glm::vec3(px[i], py[i], pz[i]);
+    }
+    // ------------------------------------------------------------------------
+    void setPosition(unsigned int i, const glm::vec3 &position)
+    {
+        px[i] = position.x;
+        py[i] = position.y;
+        pz[i] = position.z;
+    }
+    // ------------------------------------------------------------------------
+    void setRotation(unsigned int i, const glm::quat &rotation)
+    {
+        qx[i] = rotation.x;
+        qy[i] = rotation.y;
+        qz[i] = rotation.z;
+        qw[i] = rotation.w;
+    }
+    // ------------------------------------------------------------------------
+    void setScale(unsigned int i, const glm::vec3 &scale)
+    {
+        sx[i] = scale.x;
+        sy[i] = scale.y;
+        sz[i] = scale.z;
+    }
+    // world matrices of the objects [first, last) into out[0, last - first)
+    // ------------------------------------------------------------------------
+    void compose(unsigned int first, unsigned int last, glm::mat4 *out) const
+    {
+        unsigned int i = first;
+#if defined(__AVX2__)
+        const __m256 one = _mm256_set1_ps(1.0f), two = _mm256_set1_ps(2.0f), zero = _mm256_setzero_ps();
+        for (; i + 8 <= last; i += 8)
+        {
+            __m256 x = _mm256_loadu_ps(&qx[i]), y = _mm256_loadu_ps(&qy[i]), z = _mm256_loadu_ps(&qz[i]), w = _mm256_loadu_ps(&qw[i]);
+            __m256 x2 = _mm256_mul_ps(x, two), y2 = _mm256_mul_ps(y, two), z2 = _mm256_mul_ps(z, two);
+            __m256 xx = _mm256_mul_ps(x, x2), yy = _mm256_mul_ps(y, y2), zz = _mm256_mul_ps(z, z2);
+            __m256 xy = _mm256_mul_ps(x, y2), xz = _mm256_mul_ps(x, z2), yz = _mm256_mul_ps(y, z2);
+            __m256 wx = _mm256_mul_ps(w, x2), wy = _mm256_mul_ps(w, y2), wz = _mm256_mul_ps(w, z2);
+            __m256 scaleX = _mm256_loadu_ps(&sx[i]), scaleY = _mm256_loadu_ps(&sy[i]), scaleZ = _mm256_loadu_ps(&sz[i]);
+
+            __m256 columns[4][4];
+            columns[0][0] = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(yy, zz)), scaleX);
+            columns[0][1] = _mm256_mul_ps(_mm256_add_ps(xy, wz), scaleX);
+            columns[0][2] = _mm256_mul_ps(_mm256_sub_ps(xz, wy), scaleX);
+            columns[0][3] = zero;
+            columns[1][0] = _mm256_mul_ps(_mm256_sub_ps(xy, wz), scaleY);
+            columns[1][1] = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(xx, zz)), scaleY);
+            columns[1][2] = _mm256_mul_ps(_mm256_add_ps(yz, wx), scaleY);
+            columns[1][3] = zero;
+            columns[2][0] = _mm256_mul_ps(_mm256_add_ps(xz, wy), scaleZ);
+            columns[2][1] = _mm256_mul_ps(_mm256_sub_ps(yz, wx), scaleZ);
+            columns[2][2] = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(xx, yy)), scaleZ);
+            columns[2][3] = zero;
+            columns[3][0] = _mm256_loadu_ps(&px[i]);
+            columns[3][1] = _mm256_loadu_ps(&py[i]);
+            columns[3][2] = _mm256_loadu_ps(&pz[i]);
+            columns[3][3] = one;
+
+            // 4x8 transpose per column: rows[k] holds that column of object k (low half) and k + 4 (high half)
+            __m256 rows[4][4];
+            for (int c = 0; c < 4; c++)
+            {
+                __m256 t0 = _mm256_unpacklo_ps(columns[c][0], columns[c][1]);
+                __m256 t1 = _mm256_unpackhi_ps(columns[c][0], columns[c][1]);
+                __m256 t2 = _mm256_unpacklo_ps(columns[c][2], columns[c][3]);
+                __m256 t3 = _mm256_unpackhi_ps(columns[c][2], columns[c][3]);
+                rows[c][0] = _mm256_shuffle_ps(t0, t2, 0x44);
+                rows[c][1] = _mm256_shuffle_ps(t0, t2, 0xEE);
+                rows[c][2] = _mm256_shuffle_ps(t1, t3, 0x44);
+                rows[c][3] = _mm256_shuffle_ps(t1, t3, 0xEE);
+            }
+            // two columns of one matrix per 256 bit store
+            float *target = &out[i - first][0][0];
+            for (int k = 0; k < 4; k++)
+            {
+                float *low = target + k * 16, *high = target + (k + 4) * 16;
+                _mm256_storeu_ps(low, _mm256_permute2f128_ps(rows[0][k], rows[1][k], 0x20));
+                _mm256_storeu_ps(low + 8, _mm256_permute2f128_ps(rows[2][k], rows[3][k], 0x20));
+                _mm256_storeu_ps(high, _mm256_permute2f128_ps(rows[0][k], rows[1][k], 0x31));
+                _mm256_storeu_ps(high + 8, _mm256_permute2f128_ps(rows[2][k], rows[3][k], 0x31));
+            }
+        }
+#endif
+        for (; i < last; i++)
+        {
+            float x = qx[i], y = qy[i], z = qz[i], w = qw[i];
+            float xx = 2.0f * x * x, yy = 2.0f * y * y, zz = 2.0f * z * z;
+            float xy = 2.0f * x * y, xz = 2.0f * x * z, yz = 2.0f * y * z;
+            float wx = 2.0f * w * x, wy = 2.0f * w * y, wz = 2.0f * w * z;
+            glm::mat4 &model = out[i - first];
+            model[0] = glm::vec4(1.0f - yy - zz, xy + wz, xz - wy, 0.0f) * sx[i];
+            model[1] = glm::vec4(xy - wz, 1.0f - xx - zz, yz + wx, 0.0f) * sy[i];
+            model[2] = glm::vec4(xz + wy, yz - wx, 1.0f - xx - yy, 0.0f) * sz[i];
+            model[3] = glm::vec4(px[i], py[i], pz[i], 1.0f);
+        }
+    }
+};
+#endif
@@ -0,0 +1,33 @@
+#ifndef UNIFORM_ID_H
+#define UNIFORM_ID_H
+
+#include <cstddef>
+
+// Uniform name hashed at compile time: "spotLight.cutOff"_u is a constant FNV-1a hash (plus the literal for
+// error messages), which Shader looks up in the table of its active uniforms it built after linking. Names
+// are the ones glGetActiveUniform reports: "pointLights[2].position", "planes[3]" (or "planes" for element 0).
+struct UniformId
+{
+    unsigned int hash;
+    const char *name;
+};
+
+// 32 bit FNV-1a
+// ------------------------------------------------------------------------
+constexpr unsigned int uniformHash(const char *name, std::size_t length)
+{
+    unsigned int hash = 2166136261u;
+    for (std::size_t i = 0; i < length; i++)
+    {
+        hash ^= (unsigned char)name[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// ------------------------------------------------------------------------
+constexpr UniformId operator""_u(const char *name, std::size_t length)
+{
+    return UniformId{uniformHash(name, length), name};
+}
+#endif